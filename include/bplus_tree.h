@@ -1,27 +1,184 @@
 #ifndef __BPLUS_TREE_H__
 #define __BPLUS_TREE_H__
 
+#include "key_traits.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace bplus_sql {
 
-class BPlusTree {
+/// @brief When written pages are forced to stable storage.
+enum class Durability {
+    // Never sync to the device, sync() only hands pages and metadata to the OS
+    NONE,
+    // sync() and closing the table make every change durable
+    ON_SYNC,
+    // Like ON_SYNC, and additionally sync after every `syncInterval` modifications
+    EVERY_N_OPS,
+    // Every modification is durable when it returns; cheap only with TreeOptions::writeAheadLog,
+    // where it costs a log sync that concurrent commits share
+    EVERY_OP
+};
+
+/// @brief How a table picks which of its cached pages to evict.
+enum class ReplacementPolicy {
+    // Least recently used
+    LRU,
+    // Second chance: hits set a reference bit instead of reordering a list
+    CLOCK,
+    // Pages must be referenced again after a probation FIFO before they count as hot (scan resistant)
+    TWO_QUEUE,
+    // Evict the page whose second to last access is oldest (scan resistant)
+    LRU_2
+};
+
+/// @brief What inserting into a full node does.
+enum class SplitPolicy {
+    // Split the node into two half-full nodes
+    HALVES,
+    // First move keys into an adjacent sibling with room; when the siblings are full too, turn the
+    // node and one of them into three nodes two thirds full. Pages end up fuller at a small cost
+    // in extra page writes per split.
+    B_STAR
+};
+
+/// @brief Buffer pool counters of one table.
+struct CacheStats {
+    // Page requests served from the cache
+    uint64_t hits = 0;
+    // Page requests that had to read the page, or set up a newly allocated one
+    uint64_t misses = 0;
+    // Pages of this table dropped to make room
+    uint64_t evictions = 0;
+    // Evicted pages that were dirty and had to be written first
+    uint64_t writebacks = 0;
+};
+
+class BufferPool;
+
+/// @brief Create a page cache of `budgetBytes` that several tables can share through TreeOptions::bufferPool.
+/// It holds pages of `pageSize` bytes (0 for the default 4K); tables with another page size get a private cache.
+/// Large caches are split into shards with a lock each, see BufferPool.
+std::shared_ptr<BufferPool> makeSharedBufferPool(size_t budgetBytes, size_t pageSize = 0);
+
+/// @brief Per-table settings chosen when the table file is opened.
+struct TreeOptions {
+    // Map the table file into memory instead of going through std::fstream (POSIX only)
+    bool useMmap = false;
+    // Read and write pages through io_uring (Linux only): the children searchMany descends into are read
+    // in one batch, and flushes and checkpoints hand every dirty page to the kernel at once. Single misses
+    // of different threads no longer wait for each other. Falls back to std::fstream elsewhere or where the
+    // kernel refuses; useMmap takes precedence.
+    bool asyncIo = false;
+    // Page size of a new table file: a power of two from 4K to 64K, 0 for 4K.
+    // An existing file keeps the page size recorded in its metadata.
+    size_t pageSize = 0;
+    Durability durability = Durability::ON_SYNC;
+    // Only used by Durability::EVERY_N_OPS
+    size_t syncInterval = 1000;
+    // Cache pages in this pool together with other tables; null gives the table a private pool
+    std::shared_ptr<BufferPool> bufferPool;
+    // Bytes of a shared pool kept for this table under pressure from others (0 for none)
+    size_t minCacheBytes = 0;
+    // Bytes of a shared pool this table may use at most (0 for no cap)
+    size_t maxCacheBytes = 0;
+    ReplacementPolicy replacement = ReplacementPolicy::LRU;
+    // Applies to insert; insertMany and bulkLoad fill nodes themselves
+    SplitPolicy split = SplitPolicy::HALVES;
+    // Record modifications in a redo log next to the table file (`<file>.wal`) and keep dirty pages out
+    // of the table file until a checkpoint, so making modifications durable takes one sequential log
+    // sync instead of writing back every dirty page. The durability level decides when the log is
+    // synced; with Durability::EVERY_OP each modification is durable, even against kill -9 or power
+    // loss, when it returns. Reopening a table replays its log. Requires the STREAM backend.
+    // The table keeps the log, and with it durability, syncInterval and the checkpoint settings, which
+    // are recorded in the table file: opened later without writeAheadLog, it runs as it was last set up.
+    bool writeAheadLog = false;
+    // Apply the table's write-ahead log to the table file and remove it, so the table runs without one
+    bool dropWriteAheadLog = false;
+    // With writeAheadLog, checkpoint the tree so a restart only replays what was logged after it: once this
+    // many seconds have passed since the last checkpoint (0 for never), or once this many pages have been
+    // modified since (0 for never). Both are checked when the table is modified, and the time also by a
+    // background thread, so a table that goes idle is checkpointed too. A checkpoint writes the dirty pages
+    // back while operations go on, then stops the tree briefly for the pages modified meanwhile: it is not
+    // fuzzy, as the log is replayed key by key onto the pages a checkpoint lists.
+    size_t checkpointSeconds = 60;
+    size_t checkpointPages = 4096;
+};
+
+/// @brief Disk-based B+ tree of unique fixed-width keys described by KeyTraits (see key_traits.h).
+/// The library is built for Int32Key, Int64Key, UInt64Key and FixedBytesKey<8|16|32>.
+/// A table may be used from several threads at once. Inserts and erases latch the pages they visit, and
+/// lookups and scans read pages without latching them, checking afterwards that no writer got in; all of
+/// these run side by side. Batch operations, bulkLoad, shrink, dfs and sync without a log wait for them
+/// and then have the table to themselves.
+template<typename KeyTraits>
+class BasicBPlusTree {
 public:
-    static constexpr int MIN_KEYS = 64;
-    static constexpr int MAX_KEYS = 128;
+    using Key = typename KeyTraits::type;
+
+    explicit BasicBPlusTree(const std::string &fileName, const TreeOptions &options = {});
+    ~BasicBPlusTree();
 
-    explicit BPlusTree(const std::string &fileName);
-    ~BPlusTree();
+    BasicBPlusTree(const BasicBPlusTree &) = delete;
+    BasicBPlusTree &operator=(const BasicBPlusTree &) = delete;
+    BasicBPlusTree(BasicBPlusTree &&) noexcept;
+    BasicBPlusTree &operator=(BasicBPlusTree &&) noexcept;
 
-    BPlusTree(const BPlusTree &) = delete;
-    BPlusTree &operator=(const BPlusTree &) = delete;
-    BPlusTree(BPlusTree &&) noexcept;
-    BPlusTree &operator=(BPlusTree &&) noexcept;
+    // Replay the write-ahead logs a crash left next to any of these table files, which must hold this key
+    // type, recovering up to `threads` tables at a time (0 for one per hardware thread). Each table gets a
+    // private cache and is closed again with its log applied, which leaves the log empty. Returns the
+    // number recovered.
+    static size_t recover(std::span<const std::string> fileNames, size_t threads = 0);
 
-    bool insert(int key);
-    bool search(int key);
-    bool erase(int key);
+    bool insert(const Key &key);
+    bool search(const Key &key);
+    bool erase(const Key &key);
+    // Look up a batch of keys, sharing the descent among keys that fall into the same subtree;
+    // found[i] tells whether keys[i] is present (found must hold at least keys.size() entries).
+    // Returns the number of keys found.
+    size_t searchMany(std::span<const Key> keys, std::span<bool> found);
+    // Insert or erase a batch of keys in any order, descending once per affected node instead of once
+    // per key; returns how many keys were new, or how many were found and erased
+    size_t insertMany(std::span<const Key> keys);
+    size_t eraseMany(std::span<const Key> keys);
+    // Visit the keys in [low, high] in ascending order, descending the tree once and then following
+    // the leaf chain; stops early when `visit` returns false. Returns the number of keys visited.
+    // The tree must not be modified from inside `visit`.
+    size_t scan(const Key &low, const Key &high, const std::function<bool(const Key &)> &visit);
+    // Build the tree of an empty table bottom-up from strictly increasing keys; `next` stores the
+    // following key and returns false at the end. Leaves and internal nodes are filled to `fillFactor`
+    // (0.5 to 1), except that the last node of each level may hold fewer, though never fewer than the
+    // minimum. Pages go through the cache like any other modification. With writeAheadLog the load is
+    // checkpointed as a whole, which parks every page in the log until the log is emptied into the
+    // table file. Returns the number of keys loaded.
+    // Unordered input throws std::invalid_argument, keeping the keys before it.
+    size_t bulkLoad(const std::function<bool(Key &)> &next, double fillFactor = 1.0);
+    template<typename Iterator>
+    size_t bulkLoad(Iterator first, Iterator last, double fillFactor = 1.0) {
+        return bulkLoad([&](Key &key) {
+            if (first == last) {
+                return false;
+            }
+            key = *first++;
+            return true;
+        }, fillFactor);
+    }
+    // Write back all modified pages, then the metadata page, and sync them per the durability level.
+    // With a write-ahead log only the log is synced; pages reach the table file at checkpoints.
+    void sync();
+    // Move pages off the end of the file into pages freed by erases and truncate the file;
+    // returns the number of pages given back. Reads every internal node.
+    size_t shrink();
+    // Buffer pool counters since the table was opened; all zero for memory-mapped tables
+    CacheStats cacheStats() const;
+    // cacheStats() split by the buffer pool shard that counted them; empty for memory-mapped tables
+    std::vector<CacheStats> cacheShardStats() const;
     void dfs();
 
 private:
@@ -29,6 +186,15 @@ private:
     std::unique_ptr<Impl> m_impl;
 };
 
+extern template class BasicBPlusTree<Int32Key>;
+extern template class BasicBPlusTree<Int64Key>;
+extern template class BasicBPlusTree<UInt64Key>;
+extern template class BasicBPlusTree<FixedBytesKey<8>>;
+extern template class BasicBPlusTree<FixedBytesKey<16>>;
+extern template class BasicBPlusTree<FixedBytesKey<32>>;
+
+using BPlusTree = BasicBPlusTree<Int32Key>;
+
 }
 
 #endif
@@ -0,0 +1,64 @@
+#ifndef __KEY_TRAITS_H__
+#define __KEY_TRAITS_H__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace bplus_sql {
+
+// Key traits describe a fixed-width key stored inline in tree pages:
+//   type       trivially copyable key type, WIDTH bytes
+//   less(a, b) strict weak order of the keys
+//   normalize  writes the key as WIDTH bytes whose memcmp order is the key order,
+//              so keys can be combined into FixedBytesKey composite keys
+
+/// @brief Integer keys in their native representation, searched with SIMD kernels.
+template<typename Int>
+struct IntegerKey {
+    static_assert(std::is_integral_v<Int> && (sizeof(Int) == 4 || sizeof(Int) == 8), "32 or 64-bit integers only");
+
+    using type = Int;
+    static constexpr size_t WIDTH = sizeof(Int);
+
+    static bool less(Int a, Int b) {
+        return a < b;
+    }
+
+    // Big-endian with the sign bit flipped
+    static void normalize(Int key, unsigned char *out) {
+        using Bits = std::make_unsigned_t<Int>;
+        Bits bits = static_cast<Bits>(key);
+        if constexpr (std::is_signed_v<Int>) {
+            bits ^= Bits(1) << (WIDTH * 8 - 1);
+        }
+        for (size_t i = 0; i < WIDTH; ++i) {
+            out[i] = static_cast<unsigned char>(bits >> (8 * (WIDTH - 1 - i)));
+        }
+    }
+};
+
+using Int32Key = IntegerKey<int32_t>;
+using Int64Key = IntegerKey<int64_t>;
+using UInt64Key = IntegerKey<uint64_t>;
+
+/// @brief N raw bytes ordered by memcmp, e.g. hashes or normalized composite keys.
+template<size_t N>
+struct FixedBytesKey {
+    using type = std::array<unsigned char, N>;
+    static constexpr size_t WIDTH = N;
+
+    static bool less(const type &a, const type &b) {
+        return std::memcmp(a.data(), b.data(), N) < 0;
+    }
+
+    static void normalize(const type &key, unsigned char *out) {
+        std::memcpy(out, key.data(), N);
+    }
+};
+
+}
+
+#endif
@@ -2,20 +2,74 @@
 #define __BPLUS_NODE_H__
 
 #include <cstddef>
+#include <cstdint>
 
 namespace bplus_sql {
 
-/// @brief B+ Tree Node
+/// @brief Header at the start of every node page; what follows depends on the node kind.
+/// A leaf page holds only keys after the header. An internal page holds keys and then the child
+/// page ids, both sized by NodeLayout so that the page is filled.
 struct BPlusNode {
     bool isLeaf;
-    int keyCount;
-    int keys[128];
-    size_t children[129];
+    uint8_t reserved[3];
+    int32_t keyCount;
+    // Right sibling of a leaf, 0 for the last leaf
     size_t next;
+
+    template<typename Key>
+    Key *keys() {
+        return reinterpret_cast<Key *>(this + 1);
+    }
+    template<typename Key>
+    const Key *keys() const {
+        return reinterpret_cast<const Key *>(this + 1);
+    }
 };
 
-static_assert(sizeof(BPlusNode) <= (1ull << 12));
+static_assert(sizeof(BPlusNode) % alignof(size_t) == 0);
+
+/// @brief Fan-out of both node kinds for a given page size and key type.
+template<typename Key>
+struct NodeLayout {
+    static_assert(alignof(Key) <= alignof(BPlusNode), "Keys are stored right after the node header");
+
+    explicit NodeLayout(size_t pageSize)
+        : maxLeafKeys(static_cast<int>((pageSize - sizeof(BPlusNode)) / sizeof(Key))),
+          // Internal pages keep one more child than keys
+          maxInternalKeys(static_cast<int>((pageSize - sizeof(BPlusNode) - sizeof(size_t) - alignof(size_t)) / (sizeof(Key) + sizeof(size_t)))),
+          childrenOffset(alignUp(sizeof(BPlusNode) + maxInternalKeys * sizeof(Key), alignof(size_t))) {
+        minLeafKeys = maxLeafKeys / 2;
+        minInternalKeys = maxInternalKeys / 2;
+    }
+
+    int maxKeys(const BPlusNode *node) const {
+        return node->isLeaf ? maxLeafKeys : maxInternalKeys;
+    }
+
+    int minKeys(const BPlusNode *node) const {
+        return node->isLeaf ? minLeafKeys : minInternalKeys;
+    }
+
+    size_t *children(BPlusNode *node) const {
+        return reinterpret_cast<size_t *>(reinterpret_cast<char *>(node) + childrenOffset);
+    }
+    const size_t *children(const BPlusNode *node) const {
+        return reinterpret_cast<const size_t *>(reinterpret_cast<const char *>(node) + childrenOffset);
+    }
+
+    int maxLeafKeys;
+    int maxInternalKeys;
+    int minLeafKeys;
+    int minInternalKeys;
+    // Byte offset of the child page ids inside an internal page
+    size_t childrenOffset;
+
+private:
+    static size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+};
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -1,143 +1,978 @@
 #include "bplus_tree.h"
 
 #include "bplus_node.h"
+#include "buffer_pool.h"
 #include "node_manager.h"
 #include "pager.h"
-
+#include "search_kernels.h"
+#include "wal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
 #include <format>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
 namespace bplus_sql {
 
-class BPlusTree::Impl {
+template<typename KeyTraits>
+class BasicBPlusTree<KeyTraits>::Impl {
 public:
+    using Key = typename KeyTraits::type;
+
+    // Files written before leaf and internal pages had separate layouts carry version 0,
+    // version 2 files predate per-table page sizes and always use Pager::PAGE_SIZE,
+    // version 2 and 3 files predate key types and always hold int keys,
+    // files before version 5 have no free list,
+    // files before version 6 have no write-ahead log generation,
+    // files before version 7 do not record whether the table has a write-ahead log
+    static constexpr uint32_t FORMAT_VERSION = 7;
+    // Children searchMany pins and prefetches together
+    static constexpr size_t SEARCH_GROUP = 16;
+    // Size the write-ahead log may reach before its pages are copied into the table file and it is emptied
+    static constexpr uint64_t TRUNCATE_LOG_BYTES = 1ull << 26;
+    // Modifications between two counts of modified pages, which visit every shard of the buffer pool
+    static constexpr size_t CHECKPOINT_COUNT_INTERVAL = 32;
+
+    // Whether the table has a write-ahead log, and the options it runs with; kept in the metadata so that
+    // the table keeps both when it is opened without them
+    struct LogSettings {
+        uint32_t enabled;
+        uint32_t durability;
+        uint64_t syncInterval;
+        uint64_t checkpointSeconds;
+        uint64_t checkpointPages;
+
+        bool operator==(const LogSettings &) const = default;
+    };
+
     struct TreeMetadata {
         size_t rootPageId;
         size_t nextPageId;
-        char padding[Pager::PAGE_SIZE - 2 * sizeof(size_t)];
+        uint32_t formatVersion;
+        uint32_t pageSize;
+        uint32_t keyWidth;
+        // Generation of the log records that apply on top of this file, see WriteAheadLog
+        uint32_t logGeneration;
+        // Released pages are chained through their `next` field; 0 ends the list, as page 0 is the
+        // leftmost leaf and never released
+        size_t freeListHead;
+        size_t freePageCount;
+        // Log position of the latest checkpoint record, 0 for none; see recoverLog()
+        uint64_t checkpointPosition;
+        LogSettings logSettings;
+        char padding[Pager::PAGE_SIZE - 4 * sizeof(size_t) - 4 * sizeof(uint32_t) - sizeof(uint64_t) - sizeof(LogSettings)];
     };
 
-    explicit Impl(const std::string &fileName)
-        : m_nodeManager(std::make_unique<NodeManager>(fileName)) {
+    // Payload of a WriteAheadLog::RecordType::CHECKPOINT record, followed by `pageCount`
+    // (page id, log position) pairs locating the latest image of every page parked in the log
+    struct CheckpointRecord {
+        uint64_t rootPageId;
+        uint64_t nextPageId;
+        uint64_t freeListHead;
+        uint64_t freePageCount;
+        uint64_t pageCount;
+    };
+
+    Impl(const std::string &fileName, const TreeOptions &options)
+        : m_durability(options.durability),
+          m_splitPolicy(options.split),
+          m_syncInterval(options.syncInterval),
+          m_checkpointInterval(std::chrono::seconds(options.checkpointSeconds)),
+          m_checkpointPages(options.checkpointPages),
+          m_pageSize(tablePageSize(fileName, options.pageSize)),
+          m_nodeManager(std::make_unique<NodeManager>(
+              fileName, pagerBackend(options), m_pageSize, options.bufferPool,
+              (options.minCacheBytes + m_pageSize - 1) / m_pageSize,
+              options.maxCacheBytes == 0 ? BufferPool::UNLIMITED : std::max<size_t>(1, options.maxCacheBytes / m_pageSize),
+              options.replacement)),
+          m_layout(m_pageSize) {
+        LogSettings stored{};
         if (m_nodeManager->fileExists() && m_nodeManager->getFileSize() >= sizeof(TreeMetadata)) {
-            loadMetadata();
+            stored = loadMetadata();
         } else {
             m_rootPageId = 0;
             m_nextPageId = 1;
 
-            BPlusNode root = createNode(true);
-            putNode(m_rootPageId, root);
-            saveMetadata();
+            newNode(m_rootPageId, true);
+            m_metadataDirty = true;
+        }
+
+        // A table keeps its log, with the settings it was last given, until it is dropped explicitly.
+        // A log left behind is recovered in any case, and kept too, as older files do not record the settings;
+        // a dropped log is applied, and the metadata page rewritten, before it is removed.
+        std::string logName = fileName + ".wal";
+        std::error_code error;
+        uintmax_t logSize = std::filesystem::file_size(logName, error);
+        bool leftBehind = !error && logSize > 0;
+        m_writeAheadLog = options.writeAheadLog || (!options.dropWriteAheadLog && (stored.enabled != 0 || leftBehind));
+        if (!options.writeAheadLog && m_writeAheadLog && stored.enabled != 0) {
+            applyLogSettings(stored);
+        }
+        if (m_writeAheadLog || leftBehind || stored.enabled != 0) {
+            if (m_nodeManager->isMapped()) {
+                throw std::invalid_argument("A write-ahead log cannot be used with a memory-mapped table");
+            }
+            m_log = std::make_unique<WriteAheadLog>(logName);
+            m_nodeManager->attachLog(m_log.get());
+        }
+
+        if (m_log != nullptr) {
+            bool recovered = recoverLog();
+            // A new table file gets its first pages from the log, and new settings go into the metadata page
+            // along with the log's pages; a dropped log goes away
+            if (m_metadataDirty || !m_writeAheadLog || logSettings() != stored) {
+                truncateLog();
+            } else if (recovered) {
+                checkpoint();
+            }
+            if (!m_writeAheadLog) {
+                m_nodeManager->attachLog(nullptr);
+                m_log.reset();
+                std::filesystem::remove(logName);
+            }
+        }
+        if (m_log != nullptr && m_checkpointInterval.count() > 0) {
+            m_checkpointer = std::thread([this] { runCheckpointer(); });
         }
     }
 
     ~Impl() {
-        saveMetadata();
+        if (m_checkpointer.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(m_checkpointerMutex);
+                m_stopCheckpointer = true;
+            }
+            m_checkpointerWakeup.notify_one();
+            m_checkpointer.join();
+        }
+        if (m_log != nullptr) {
+            truncateLog();
+        } else {
+            sync();
+        }
+    }
+
+    void sync() {
+        if (m_log != nullptr) {
+            // The log already holds every modification, the pages wait for the next checkpoint
+            commitLog();
+            return;
+        }
+        ExclusiveTree exclusive(*this);
+        bool toDevice = m_durability != Durability::NONE;
+        m_nodeManager->flushDirtyPages();
+        if (toDevice) {
+            m_nodeManager->syncData();
+        }
+        // The metadata page goes last so it never points at pages that are not durable yet
+        if (m_metadataDirty) {
+            saveMetadata();
+            if (toDevice) {
+                m_nodeManager->syncData();
+            }
+            m_metadataDirty = false;
+        }
+        m_opsSinceSync = 0;
+    }
+
+    CacheStats cacheStats() const {
+        return m_nodeManager->cacheStats();
     }
 
-    bool insert(int key) {
+    std::vector<CacheStats> cacheShardStats() const {
+        return m_nodeManager->cacheShardStats();
+    }
+
+    bool insert(const Key &key) {
+        {
+            std::shared_lock<std::shared_mutex> shared(m_treeLatch);
+            insertKey(key);
+        }
+        countModification();
+        return true;
+    }
+
+    // insert() while the tree is latched shared
+    void insertKey(const Key &key) {
         struct SplitInfo {
             bool didSplit;
-            int splitKey;
+            Key splitKey;
             size_t newPageId;
+            // SplitPolicy::B_STAR: the node is full and its parent has to make room before the insert is retried
+            bool needsRoom = false;
+            // The split kept the old node full and moved only the new maximum out
+            bool appended = false;
         };
 
-        auto insertRecursive = [&](auto &&self, size_t pageId, int key) -> SplitInfo {
-            BPlusNode node = getNode(pageId);
+        // A new maximum goes straight into the rightmost leaf while that has room. The leaf is only
+        // latched exclusively once it qualifies, so that other inserts do not queue up on it.
+        size_t rightmostLeaf = m_rightmostLeaf.load(std::memory_order_relaxed);
+        if (rightmostLeaf < m_nextPageId) {
+            ReadGuard node = readNode(rightmostLeaf);
+            if (appendsTo(&*node, key)) {
+                // Others may get in while the latch is traded, so the leaf is checked again
+                WriteGuard leaf = std::move(node).relatchExclusive();
+                if (appendsTo(&*leaf, key)) {
+                    logKeys(WriteAheadLog::RecordType::INSERT, &key, 1);
+                    leaf->keys<Key>()[leaf->keyCount++] = key;
+                    return;
+                }
+            }
+        }
+
+        WritePath path = latchPath(key, true);
+        // Logged while the leaf is latched, so the log has a leaf's keys in the order they went in
+        logKeys(WriteAheadLog::RecordType::INSERT, &key, 1);
 
-            if (node.isLeaf) {
-                int index = findKeyIndex(&node, key);
-                if (index < node.keyCount && node.keys[index] == key) {
-                    return {false, 0, 0};
+        auto insertRecursive = [&](auto &&self, size_t pageId, const Key &key) -> SplitInfo {
+            ReadGuard node = pathNode(path, pageId);
+
+            if (node->isLeaf) {
+                int index = findKeyIndex(&*node, key);
+                if (index < node->keyCount && equal(node->keys<Key>()[index], key)) {
+                    return {false, Key{}, 0};
                 }
 
-                if (node.keyCount >= BPlusTree::MAX_KEYS) {
-                    size_t newLeafPageId = splitLeaf(pageId, key);
-                    BPlusNode newLeaf = getNode(newLeafPageId);
-                    return {true, newLeaf.keys[0], newLeafPageId};
+                // Ascending keys keep the rightmost leaf full and start a new one
+                bool appending = node->next == 0 && index == node->keyCount;
+                if (node->keyCount >= m_layout.maxLeafKeys && m_splitPolicy == SplitPolicy::B_STAR && !appending) {
+                    return {false, Key{}, 0, true};
+                }
+                WriteGuard leaf = std::move(node).relatchExclusive();
+                if (leaf->keyCount >= m_layout.maxLeafKeys) {
+                    WriteGuard newLeaf = splitLeaf(leaf, key, appending);
+                    if (newLeaf->next == 0) {
+                        m_rightmostLeaf.store(newLeaf.pageId(), std::memory_order_relaxed);
+                    }
+                    return {true, newLeaf->keys<Key>()[0], newLeaf.pageId(), false, appending};
                 }
 
-                insertIntoLeaf(pageId, key);
-                return {false, 0, 0};
+                insertIntoLeaf(leaf, key);
+                if (leaf->next == 0) {
+                    m_rightmostLeaf.store(pageId, std::memory_order_relaxed);
+                }
+                return {false, Key{}, 0};
             }
 
-            int childIndex = findChildIndex(&node, key);
-            size_t childPageId = node.children[childIndex];
+            int childIndex = findChildIndex(&*node, key);
+            size_t childPageId = m_layout.children(&*node)[childIndex];
 
+            // The parent stays pinned while we recurse, so no re-read is needed afterwards
             SplitInfo childSplit = self(self, childPageId, key);
+            if (childSplit.needsRoom) {
+                {
+                    WriteGuard parent = std::move(node).relatchExclusive();
+                    if (!makeRoom(parent, childIndex)) {
+                        return {false, Key{}, 0, true};
+                    }
+                }
+                return self(self, pageId, key);
+            }
             if (!childSplit.didSplit) {
-                return {false, 0, 0};
+                return {false, Key{}, 0};
             }
 
-            node = getNode(pageId);
-            if (node.keyCount < BPlusTree::MAX_KEYS) {
-                int insertPos = findKeyIndex(&node, childSplit.splitKey);
-                for (int i = node.keyCount; i > insertPos; i--) {
-                    node.keys[i] = node.keys[i - 1];
-                    node.children[i + 1] = node.children[i];
+            WriteGuard parent = std::move(node).relatchExclusive();
+            int insertPos = findKeyIndex(&*parent, childSplit.splitKey);
+            if (parent->keyCount < m_layout.maxInternalKeys) {
+                Key *keys = parent->keys<Key>();
+                size_t *children = m_layout.children(&*parent);
+                for (int i = parent->keyCount; i > insertPos; i--) {
+                    keys[i] = keys[i - 1];
+                    children[i + 1] = children[i];
                 }
 
-                node.keys[insertPos] = childSplit.splitKey;
-                node.children[insertPos + 1] = childSplit.newPageId;
-                node.keyCount++;
-                putNode(pageId, node);
-                return {false, 0, 0};
+                keys[insertPos] = childSplit.splitKey;
+                children[insertPos + 1] = childSplit.newPageId;
+                parent->keyCount++;
+                return {false, Key{}, 0};
             }
 
-            size_t newNodePageId = splitNonLeaf(pageId, childSplit.splitKey, childSplit.newPageId);
-            BPlusNode newNode = getNode(newNodePageId);
-            return {true, newNode.keys[0], newNodePageId};
+            Key separator;
+            bool appending = childSplit.appended && insertPos == parent->keyCount;
+            WriteGuard newNode = splitNonLeaf(parent, childSplit.splitKey, childSplit.newPageId, separator, appending);
+            return {true, separator, newNode.pageId(), false, appending};
         };
 
-        SplitInfo rootSplit = insertRecursive(insertRecursive, m_rootPageId, key);
+        SplitInfo rootSplit = insertRecursive(insertRecursive, path.nodes.front().pageId(), key);
+        // Only a path from the root gets here. New roots stay latched until the insert is done, as other
+        // threads reaching them would wait on the old root below
+        std::vector<WriteGuard> newRoots;
+        while (rootSplit.needsRoom) {
+            // The root has no siblings, so it is split in two below a new root
+            WriteGuard newRoot = newNode(allocatePage(), false);
+            m_layout.children(&*newRoot)[0] = m_rootPageId;
+            redistribute(newRoot, 0, 1, 2);
+
+            m_rootPageId = newRoot.pageId();
+            m_metadataDirty = true;
+            newRoots.push_back(std::move(newRoot));
+            rootSplit = insertRecursive(insertRecursive, m_rootPageId, key);
+        }
         if (rootSplit.didSplit) {
-            size_t newRootPageId = allocatePage();
-            BPlusNode newRoot = createNode(false);
+            WriteGuard newRoot = newNode(allocatePage(), false);
 
-            newRoot.keys[0] = rootSplit.splitKey;
-            newRoot.children[0] = m_rootPageId;
-            newRoot.children[1] = rootSplit.newPageId;
-            newRoot.keyCount = 1;
+            newRoot->keys<Key>()[0] = rootSplit.splitKey;
+            m_layout.children(&*newRoot)[0] = m_rootPageId;
+            m_layout.children(&*newRoot)[1] = rootSplit.newPageId;
+            newRoot->keyCount = 1;
 
-            putNode(newRootPageId, newRoot);
-            m_rootPageId = newRootPageId;
+            m_rootPageId = newRoot.pageId();
+            m_metadataDirty = true;
         }
+    }
 
-        return true;
+    bool search(const Key &key) {
+        std::shared_lock<std::shared_mutex> shared(m_treeLatch);
+        return lookup(key);
+    }
+
+    // search() while the tree is latched shared
+    bool lookup(const Key &key) {
+        return visitLeaf(key, [&](const BPlusNode *leaf) {
+            int count = boundedKeyCount(leaf);
+            size_t index = m_search.lowerBound(leaf->keys<Key>(), count, key);
+            return index < static_cast<size_t>(count) && equal(leaf->keys<Key>()[index], key);
+        });
+    }
+
+    size_t searchMany(std::span<const Key> keys, std::span<bool> found) {
+        if (found.size() < keys.size()) {
+            throw std::invalid_argument("searchMany needs one result slot per key");
+        }
+        // The keys in ascending order, and where each came from
+        std::vector<std::pair<Key, size_t>> pairs(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            pairs[i] = {keys[i], i};
+        }
+        std::sort(pairs.begin(), pairs.end(), [](const auto &a, const auto &b) { return KeyTraits::less(a.first, b.first); });
+        std::shared_lock<std::shared_mutex> shared(m_treeLatch);
+        std::vector<Key> sorted(keys.size());
+        std::vector<size_t> order(keys.size());
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            sorted[i] = pairs[i].first;
+            order[i] = pairs[i].second;
+        }
+        size_t hits = 0;
+
+        // Keys of a node that changed while it was read are looked up one at a time instead
+        auto lookupEach = [&](size_t begin, size_t end) {
+            for (size_t next = begin; next < end; ++next) {
+                bool hit = lookup(sorted[next]);
+                found[order[next]] = hit;
+                hits += hit;
+            }
+        };
+
+        // Looks up sorted[begin, end), which all fall into the subtree of node, read optimistically
+        auto searchRecursive = [&](auto &&self, ReadGuard node, size_t begin, size_t end) -> void {
+            if (node->isLeaf) {
+                // Later keys are never smaller, so each search starts where the previous one stopped
+                const Key *leafKeys = node->keys<Key>();
+                size_t count = boundedKeyCount(&*node);
+                size_t index = 0;
+                size_t leafHits = 0;
+                for (size_t next = begin; next < end; ++next) {
+                    index += m_search.lowerBound(leafKeys + index, count - index, sorted[next]);
+                    bool hit = index < count && equal(leafKeys[index], sorted[next]);
+                    found[order[next]] = hit;
+                    leafHits += hit;
+                }
+                if (node.validate()) {
+                    hits += leafHits;
+                } else {
+                    lookupEach(begin, end);
+                }
+                return;
+            }
+
+            // Children are pinned a group at a time and prefetched before any of them is searched,
+            // so their cache misses overlap instead of following one another
+            std::vector<std::tuple<size_t, size_t, size_t>> pages;
+            std::vector<size_t> childIds;
+            std::vector<std::tuple<ReadGuard, size_t, size_t>> group;
+            for (size_t first = begin; first < end;) {
+                pages.clear();
+                group.clear();
+                size_t groupBegin = first;
+                const Key *nodeKeys = node->keys<Key>();
+                int count = boundedKeyCount(&*node);
+                for (; first < end && pages.size() < SEARCH_GROUP; ) {
+                    int childIndex = static_cast<int>(m_search.upperBound(nodeKeys, count, sorted[first]));
+                    size_t last = childIndex < count ? lowerBound(sorted, first, end, nodeKeys[childIndex]) : end;
+                    // Only a node changing under the search can have a child below sorted[first]
+                    last = std::max(last, first + 1);
+                    pages.emplace_back(m_layout.children(&*node)[childIndex], first, last);
+                    first = last;
+                }
+                // The children are only pinned once they are known to be real, and only searched once
+                // they are known to still be the node's children
+                if (!node.validate()) {
+                    lookupEach(groupBegin, end);
+                    return;
+                }
+                // Children that are not cached are read in one batch rather than one miss after the other
+                childIds.clear();
+                for (auto [pageId, childBegin, childEnd] : pages) {
+                    childIds.push_back(pageId);
+                }
+                m_nodeManager->loadPages(childIds);
+                for (auto [pageId, childBegin, childEnd] : pages) {
+                    group.emplace_back(readNode(pageId, Latch::OPTIMISTIC), childBegin, childEnd);
+                    prefetch(&*std::get<0>(group.back()));
+                }
+                if (!node.validate()) {
+                    group.clear();
+                    lookupEach(groupBegin, end);
+                    return;
+                }
+                for (auto &[child, childBegin, childEnd] : group) {
+                    prefetchSearch(&*child);
+                }
+                for (auto &[child, childBegin, childEnd] : group) {
+                    self(self, std::move(child), childBegin, childEnd);
+                }
+            }
+        };
+
+        if (!sorted.empty()) {
+            if (std::optional<ReadGuard> root = optimisticRoot()) {
+                searchRecursive(searchRecursive, std::move(*root), 0, sorted.size());
+            } else {
+                lookupEach(0, sorted.size());
+            }
+        }
+        return hits;
+    }
+
+    size_t insertMany(std::span<const Key> batch) {
+        ExclusiveTree exclusive(*this);
+        logKeys(WriteAheadLog::RecordType::INSERT, batch.data(), batch.size());
+        std::vector<Key> keys = sortedBatch(batch);
+        size_t inserted = 0;
+
+        // Applies keys[begin, end) to the subtree and returns the (separator, page) of every node
+        // that had to be split off to its right
+        auto insertRecursive = [&](auto &&self, size_t pageId, size_t begin, size_t end) -> std::vector<std::pair<Key, size_t>> {
+            ReadGuard node = readNode(pageId);
+
+            if (node->isLeaf) {
+                // Keys of the batch that are not in the leaf yet
+                m_batchKeys.clear();
+                for (size_t next = begin; next < end; ++next) {
+                    int index = findKeyIndex(&*node, keys[next]);
+                    if (index == node->keyCount || !equal(node->keys<Key>()[index], keys[next])) {
+                        m_batchKeys.push_back(keys[next]);
+                    }
+                }
+                if (m_batchKeys.empty()) {
+                    return {};
+                }
+                inserted += m_batchKeys.size();
+
+                WriteGuard leaf = std::move(node).relatchExclusive();
+                Key *leafKeys = leaf->keys<Key>();
+                int added = static_cast<int>(m_batchKeys.size());
+                int count = leaf->keyCount + added;
+                Key *merged = leafKeys;
+                if (count > m_layout.maxLeafKeys) {
+                    // Merge behind the new keys instead, then spread the result over several leaves
+                    m_batchKeys.resize(added + count);
+                    merged = m_batchKeys.data() + added;
+                }
+                // Merge from the back, so in place only the keys after the first new one move
+                for (int oldIndex = leaf->keyCount - 1, newIndex = added - 1, target = count - 1; target >= 0; --target) {
+                    if (newIndex < 0 || (oldIndex >= 0 && KeyTraits::less(m_batchKeys[newIndex], leafKeys[oldIndex]))) {
+                        merged[target] = leafKeys[oldIndex--];
+                    } else {
+                        merged[target] = m_batchKeys[newIndex--];
+                    }
+                }
+                if (merged == leafKeys) {
+                    leaf->keyCount = count;
+                    return {};
+                }
+                return fillLeaves(leaf, merged, count);
+            }
+
+            // The node is left alone until every child is done, so the batch splits by its keys as they are
+            std::vector<std::pair<int, std::pair<Key, size_t>>> childSplits;
+            for (size_t first = begin; first < end;) {
+                int childIndex = findChildIndex(&*node, keys[first]);
+                size_t last = childIndex < node->keyCount ? lowerBound(keys, first, end, node->keys<Key>()[childIndex]) : end;
+                for (auto &split : self(self, m_layout.children(&*node)[childIndex], first, last)) {
+                    childSplits.push_back({childIndex, split});
+                }
+                first = last;
+            }
+            if (childSplits.empty()) {
+                return {};
+            }
+
+            // Each new node goes right after the child it was split from
+            const Key *nodeKeys = node->keys<Key>();
+            const size_t *nodeChildren = m_layout.children(&*node);
+            std::vector<Key> allKeys;
+            std::vector<size_t> allChildren;
+            auto split = childSplits.begin();
+            for (int i = 0; i <= node->keyCount; ++i) {
+                allChildren.push_back(nodeChildren[i]);
+                for (; split != childSplits.end() && split->first == i; ++split) {
+                    allKeys.push_back(split->second.first);
+                    allChildren.push_back(split->second.second);
+                }
+                if (i < node->keyCount) {
+                    allKeys.push_back(nodeKeys[i]);
+                }
+            }
+            WriteGuard parent = std::move(node).relatchExclusive();
+            return fillInternals(parent, allKeys.data(), allChildren.data(), static_cast<int>(allKeys.size()));
+        };
+
+        if (keys.empty()) {
+            return 0;
+        }
+        std::vector<std::pair<Key, size_t>> rootSplits = insertRecursive(insertRecursive, m_rootPageId, 0, keys.size());
+        // A batch can split the root into more nodes than a new root holds, so this may take several levels
+        while (!rootSplits.empty()) {
+            std::vector<Key> rootKeys;
+            std::vector<size_t> rootChildren{m_rootPageId};
+            for (auto &[separator, pageId] : rootSplits) {
+                rootKeys.push_back(separator);
+                rootChildren.push_back(pageId);
+            }
+            WriteGuard newRoot = newNode(allocatePage(), false);
+            rootSplits = fillInternals(newRoot, rootKeys.data(), rootChildren.data(), static_cast<int>(rootKeys.size()));
+            m_rootPageId = newRoot.pageId();
+            m_metadataDirty = true;
+        }
+
+        countModification();
+        return inserted;
+    }
+
+    size_t eraseMany(std::span<const Key> batch) {
+        ExclusiveTree exclusive(*this);
+        logKeys(WriteAheadLog::RecordType::ERASE, batch.data(), batch.size());
+        std::vector<Key> keys = sortedBatch(batch);
+        size_t erased = 0;
+
+        // Removes keys[begin, end) from the subtree; true if its root fell below the minimum
+        auto eraseRecursive = [&](auto &&self, size_t pageId, size_t begin, size_t end) -> bool {
+            ReadGuard node = readNode(pageId);
+
+            if (node->isLeaf) {
+                const Key *leafKeys = node->keys<Key>();
+                int count = node->keyCount;
+                if (count == 0) {
+                    return false;
+                }
+                size_t next = lowerBound(keys, begin, end, leafKeys[0]);
+                int index = 0;
+                int kept = 0;
+                std::optional<WriteGuard> leaf;
+                for (; index < count; ++index) {
+                    while (next < end && KeyTraits::less(keys[next], leafKeys[index])) {
+                        next++;
+                    }
+                    if (next < end && !KeyTraits::less(leafKeys[index], keys[next])) {
+                        if (!leaf) {
+                            leaf = std::move(node).relatchExclusive();
+                        }
+                        next++;
+                        continue;
+                    }
+                    if (leaf) {
+                        (*leaf)->keys<Key>()[kept] = leafKeys[index];
+                    }
+                    kept++;
+                }
+                if (!leaf) {
+                    return false;
+                }
+                erased += count - kept;
+                (*leaf)->keyCount = kept;
+                return kept < m_layout.minLeafKeys;
+            }
+
+            // Rebalancing a child reshapes the node, so the child for the rest of the batch is looked up again
+            std::optional<WriteGuard> parent;
+            const BPlusNode *current = &*node;
+            for (size_t first = begin; first < end;) {
+                int childIndex = findChildIndex(current, keys[first]);
+                size_t last = childIndex < current->keyCount ? lowerBound(keys, first, end, current->keys<Key>()[childIndex]) : end;
+                bool underflow = self(self, m_layout.children(current)[childIndex], first, last);
+                first = last;
+                // A node already down to a single child has no sibling to pair it with; the node
+                // underflows itself and is merged one level up, leaving that child short
+                if (underflow && current->keyCount > 0) {
+                    if (!parent) {
+                        parent = std::move(node).relatchExclusive();
+                        current = &**parent;
+                    }
+                    mergeOrRedistribute(*parent, childIndex);
+                }
+            }
+            return current->keyCount < m_layout.minInternalKeys;
+        };
+
+        if (keys.empty()) {
+            return 0;
+        }
+        eraseRecursive(eraseRecursive, m_rootPageId, 0, keys.size());
+        while (true) {
+            ReadGuard root = readNode(m_rootPageId);
+            if (root->isLeaf || root->keyCount > 0) {
+                break;
+            }
+            m_rootPageId = m_layout.children(&*root)[0];
+            m_metadataDirty = true;
+            WriteGuard oldRoot = std::move(root).relatchExclusive();
+            freePage(oldRoot);
+        }
+
+        if (erased > 0) {
+            countModification();
+        }
+        return erased;
+    }
+
+    size_t scan(const Key &low, const Key &high, const std::function<bool(const Key &)> &visit) {
+        if (KeyTraits::less(high, low)) {
+            return 0;
+        }
+
+        std::shared_lock<std::shared_mutex> shared(m_treeLatch);
+        // Keys of the current leaf, visited once the leaf validated
+        std::vector<Key> batch;
+        size_t visited = 0;
+        Key last{};
+        while (true) {
+            // Whenever a leaf changed under the scan, it finds its way back from the root, after the last key visited
+            std::optional<ReadGuard> leaf = optimisticLeaf(visited > 0 ? last : low);
+            while (leaf) {
+                const BPlusNode *node = &**leaf;
+                const Key *keys = node->keys<Key>();
+                int count = boundedKeyCount(node);
+                size_t index = visited > 0 ? m_search.upperBound(keys, count, last) : m_search.lowerBound(keys, count, low);
+                batch.clear();
+                // Leaves may be left empty by erase, so keep walking until a key is past `high`
+                bool done = node->next == 0;
+                for (; index < static_cast<size_t>(count); ++index) {
+                    if (KeyTraits::less(high, keys[index])) {
+                        done = true;
+                        break;
+                    }
+                    batch.push_back(keys[index]);
+                }
+                size_t next = node->next;
+                if (!leaf->validate()) {
+                    break;
+                }
+                for (const Key &key : batch) {
+                    visited++;
+                    last = key;
+                    if (!visit(key)) {
+                        return visited;
+                    }
+                }
+                if (done) {
+                    return visited;
+                }
+                // The next leaf is only taken while this one is unchanged, so no keys moved between the two meanwhile
+                ReadGuard nextLeaf = readNode(next, Latch::OPTIMISTIC);
+                if (!leaf->validate()) {
+                    break;
+                }
+                leaf = std::move(nextLeaf);
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    bool erase(const Key &key) {
+        bool erased;
+        {
+            std::shared_lock<std::shared_mutex> shared(m_treeLatch);
+            erased = eraseKey(key);
+        }
+        if (erased) {
+            countModification();
+        }
+        return erased;
     }
 
-    bool search(int key) {
-        size_t leafPageId = searchLeaf(key);
-        BPlusNode leaf = getNode(leafPageId);
+    // erase() while the tree is latched shared
+    bool eraseKey(const Key &key) {
+        struct EraseInfo {
+            bool erased;
+            // The node fell below its minimum and its parent has to rebalance it
+            bool underflow;
+        };
+
+        WritePath path = latchPath(key, false);
+        logKeys(WriteAheadLog::RecordType::ERASE, &key, 1);
+
+        auto eraseRecursive = [&](auto &&self, size_t pageId) -> EraseInfo {
+            ReadGuard node = pathNode(path, pageId);
+
+            if (node->isLeaf) {
+                int index = findKeyIndex(&*node, key);
+                if (index >= node->keyCount || !equal(node->keys<Key>()[index], key)) {
+                    return {false, false};
+                }
+
+                WriteGuard leaf = std::move(node).relatchExclusive();
+                deleteFromLeaf(leaf, index);
+                return {true, leaf->keyCount < m_layout.minLeafKeys};
+            }
+
+            int childIndex = findChildIndex(&*node, key);
+            EraseInfo childErase = self(self, m_layout.children(&*node)[childIndex]);
+            if (!childErase.underflow) {
+                return {childErase.erased, false};
+            }
+
+            WriteGuard parent = std::move(node).relatchExclusive();
+            mergeOrRedistribute(parent, childIndex);
+            return {true, parent->keyCount < m_layout.minInternalKeys};
+        };
 
-        int index = findKeyIndex(&leaf, key);
-        return index < leaf.keyCount && leaf.keys[index] == key;
+        EraseInfo rootErase = eraseRecursive(eraseRecursive, path.nodes.front().pageId());
+        if (!rootErase.erased) {
+            return false;
+        }
+
+        // The root is exempt from the minimum; an internal root left with a single child is dropped.
+        // Only a path from the root can underflow at its top.
+        if (rootErase.underflow) {
+            ReadGuard root = pathNode(path, m_rootPageId);
+            if (!root->isLeaf && root->keyCount == 0) {
+                m_rootPageId = m_layout.children(&*root)[0];
+                m_metadataDirty = true;
+                WriteGuard oldRoot = std::move(root).relatchExclusive();
+                freePage(oldRoot);
+            }
+        }
+        return true;
+    }
+
+    size_t bulkLoad(const std::function<bool(Key &)> &next, double fillFactor) {
+        if (!(fillFactor >= 0.5 && fillFactor <= 1.0)) {
+            throw std::invalid_argument("Fill factor must be between 0.5 and 1");
+        }
+        ExclusiveTree exclusive(*this);
+        {
+            ReadGuard root = readNode(m_rootPageId);
+            if (!root->isLeaf || root->keyCount != 0) {
+                throw std::logic_error("Bulk loading needs an empty table");
+            }
+        }
+        int leafKeys = std::max(m_layout.minLeafKeys, static_cast<int>(fillFactor * m_layout.maxLeafKeys));
+        size_t internalChildren = std::max(m_layout.minInternalKeys, static_cast<int>(fillFactor * m_layout.maxInternalKeys)) + 1;
+
+        // Children of the level being built, and the smallest key under each child but the first
+        std::vector<size_t> pages;
+        std::vector<Key> separators;
+
+        // Fill leaves left to right, starting with the empty root leaf, which has to stay the leftmost
+        WriteGuard leaf = writeNode(m_rootPageId);
+        std::optional<WriteGuard> previous;
+        pages.push_back(leaf.pageId());
+        size_t loaded = 0;
+        bool unordered = false;
+        Key key;
+        while (next(key)) {
+            if (loaded > 0 && !KeyTraits::less(leaf->keys<Key>()[leaf->keyCount - 1], key)) {
+                // Keep what was loaded so far as a valid tree, then report
+                unordered = true;
+                break;
+            }
+            if (leaf->keyCount == leafKeys) {
+                size_t pageId = allocatePage();
+                leaf->next = pageId;
+                previous = std::move(leaf);
+                leaf = newNode(pageId, true);
+                pages.push_back(pageId);
+                separators.push_back(key);
+            }
+            leaf->keys<Key>()[leaf->keyCount++] = key;
+            loaded++;
+        }
+        // Only the last leaf can be short; it borrows from or merges into the one before it
+        if (previous && leaf->keyCount < m_layout.minLeafKeys && rebalanceLeaves(*previous, leaf, separators.back())) {
+            freePage(leaf);
+            pages.pop_back();
+            separators.pop_back();
+        }
+        previous.reset();
+
+        // Each internal level fills its nodes to internalChildren children. Only the last one can be
+        // short; it takes children from the one before it, or the two become one.
+        while (pages.size() > 1) {
+            std::vector<size_t> ends;
+            for (size_t end = internalChildren; end < pages.size(); end += internalChildren) {
+                ends.push_back(end);
+            }
+            ends.push_back(pages.size());
+            if (ends.size() > 1 && pages.size() - ends[ends.size() - 2] < static_cast<size_t>(m_layout.minInternalKeys) + 1) {
+                size_t first = ends.size() > 2 ? ends[ends.size() - 3] : 0;
+                size_t children = pages.size() - first;
+                if (children <= static_cast<size_t>(m_layout.maxInternalKeys) + 1) {
+                    ends.erase(ends.end() - 2);
+                } else {
+                    ends[ends.size() - 2] = first + children / 2;
+                }
+            }
+            std::vector<size_t> parentPages;
+            std::vector<Key> parentSeparators;
+            size_t begin = 0;
+            for (size_t n = 0; n < ends.size(); ++n) {
+                size_t end = ends[n];
+                WriteGuard node = newNode(allocatePage(), false);
+                node->keyCount = static_cast<int>(end - begin - 1);
+                std::copy(separators.begin() + begin, separators.begin() + end - 1, node->keys<Key>());
+                std::copy(pages.begin() + begin, pages.begin() + end, m_layout.children(&*node));
+                parentPages.push_back(node.pageId());
+                if (n > 0) {
+                    parentSeparators.push_back(separators[begin - 1]);
+                }
+                begin = end;
+            }
+            pages = std::move(parentPages);
+            separators = std::move(parentSeparators);
+        }
+        m_rootPageId = pages[0];
+        m_metadataDirty = true;
+
+        if (m_log != nullptr) {
+            // Made durable as a whole by a checkpoint rather than by logging every key, which recovery
+            // would have to insert again one by one. The checkpoint parks every page in the log, and
+            // emptying the log copies them into the table file, so each page is written twice.
+            checkpoint();
+        } else {
+            countModification();
+        }
+        if (unordered) {
+            throw std::invalid_argument(std::format("Bulk loaded keys must be strictly increasing, stopped after {} keys", loaded));
+        }
+        return loaded;
     }
 
-    bool erase(int key) {
-        size_t leafPageId = searchLeaf(key);
-        return deleteFromLeaf(leafPageId, key);
+    size_t shrink() {
+        ExclusiveTree exclusive(*this);
+        if (m_freePageCount == 0) {
+            return 0;
+        }
+
+        // Pages [0, liveCount) will hold the whole tree: live pages past it move into free pages before it
+        size_t liveCount = m_nextPageId - m_freePageCount;
+        std::vector<bool> isFree(m_nextPageId, false);
+        std::vector<size_t> holes;
+        for (size_t pageId = m_freeListHead; pageId != 0; pageId = readNode(pageId)->next) {
+            isFree[pageId] = true;
+            if (pageId < liveCount) {
+                holes.push_back(pageId);
+            }
+        }
+
+        // New home of every page at or past liveCount, indexed by pageId - liveCount
+        std::vector<size_t> relocated(m_nextPageId - liveCount, 0);
+        auto hole = holes.begin();
+        for (size_t pageId = liveCount; pageId < m_nextPageId; ++pageId) {
+            if (!isFree[pageId]) {
+                relocated[pageId - liveCount] = *hole++;
+                ReadGuard source = readNode(pageId);
+                WriteGuard target = createNode(relocated[pageId - liveCount]);
+                std::memcpy(&*target, &*source, m_pageSize);
+            }
+        }
+        auto newPageId = [&](size_t pageId) {
+            return pageId < liveCount ? pageId : relocated[pageId - liveCount];
+        };
+
+        // Point every child link at the new locations. Only internal nodes are read: a leaf that moved
+        // is found through its parent, and the leaf before it in key order gets its sibling link fixed.
+        int leafLevel = 0;
+        for (ReadGuard node = readNode(newPageId(m_rootPageId)); !node->isLeaf; leafLevel++) {
+            node = readNode(newPageId(m_layout.children(&*node)[0]));
+        }
+        size_t previousLeaf = 0;
+        bool seenLeaf = false;
+        auto relink = [&](auto &&self, size_t pageId, int level) -> void {
+            WriteGuard node = writeNode(pageId);
+            size_t *children = m_layout.children(&*node);
+            for (int i = 0; i <= node->keyCount; ++i) {
+                bool moved = children[i] >= liveCount;
+                children[i] = newPageId(children[i]);
+                if (level + 1 < leafLevel) {
+                    self(self, children[i], level + 1);
+                    continue;
+                }
+                if (moved && seenLeaf) {
+                    writeNode(previousLeaf)->next = children[i];
+                }
+                previousLeaf = children[i];
+                seenLeaf = true;
+            }
+        };
+        m_rootPageId = newPageId(m_rootPageId);
+        if (leafLevel > 0) {
+            relink(relink, m_rootPageId, 0);
+        }
+
+        size_t released = m_nextPageId - liveCount;
+        m_nextPageId = liveCount;
+        m_freeListHead = 0;
+        m_freePageCount = 0;
+        m_metadataDirty = true;
+        // The metadata stops referring to the tail before the file loses it
+        if (m_log != nullptr) {
+            truncateLog();
+        } else {
+            sync();
+        }
+        m_nodeManager->truncate(liveCount);
+        return released;
     }
 
     void dfs() {
+        ExclusiveTree exclusive(*this);
         auto dfsImpl = [&](auto &&self, size_t pageId) -> void {
-            BPlusNode node = getNode(pageId);
-            std::cout << std::format("Node PageID: {}, isLeaf: {}, keyCount: {}\n", pageId, node.isLeaf, node.keyCount);
+            ReadGuard node = readNode(pageId);
+            std::cout << std::format("Node PageID: {}, isLeaf: {}, keyCount: {}\n", pageId, node->isLeaf, node->keyCount);
             std::cout << "Keys: ";
-            for (int i = 0; i < node.keyCount; ++i) {
-                std::cout << node.keys[i] << " ";
+            for (int i = 0; i < node->keyCount; ++i) {
+                printKey(node->keys<Key>()[i]);
+                std::cout << " ";
             }
 
-            if (!node.isLeaf) {
-                for (int i = 0; i <= node.keyCount; ++i) {
-                    std::cout << "\nChild " << i << " PageID: " << node.children[i] << "\n";
+            if (!node->isLeaf) {
+                const size_t *children = m_layout.children(&*node);
+                for (int i = 0; i <= node->keyCount; ++i) {
+                    std::cout << "\nChild " << i << " PageID: " << children[i] << "\n";
                 }
-                for (int i = 0; i <= node.keyCount; ++i) {
-                    self(self, node.children[i]);
+                for (int i = 0; i <= node->keyCount; ++i) {
+                    self(self, children[i]);
                 }
             }
         };
@@ -146,233 +981,1161 @@ public:
     }
 
 private:
-    BPlusNode getNode(size_t pageId) {
-        return m_nodeManager->getNode(pageId);
-    }
+    using ReadGuard = NodeManager::ReadGuard;
+    using WriteGuard = NodeManager::WriteGuard;
+    using Latch = NodeManager::Latch;
+
+    /// @brief Keeps every other operation out of the tree while it lives, so pages are accessed unlatched.
+    /// Inside another one on the same thread it leaves the tree to the outer one.
+    class ExclusiveTree {
+    public:
+        explicit ExclusiveTree(Impl &impl)
+            : m_impl(impl), m_outer(impl.m_exclusiveOwner.load(std::memory_order_relaxed) != std::this_thread::get_id()) {
+            if (m_outer) {
+                m_impl.m_treeLatch.lock();
+                m_impl.m_exclusiveOwner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+                m_impl.m_unlatched = true;
+            }
+        }
+        ~ExclusiveTree() {
+            if (m_outer) {
+                m_impl.m_unlatched = false;
+                m_impl.m_exclusiveOwner.store(std::thread::id(), std::memory_order_relaxed);
+                m_impl.m_treeLatch.unlock();
+            }
+        }
+
+        ExclusiveTree(const ExclusiveTree &) = delete;
+        ExclusiveTree &operator=(const ExclusiveTree &) = delete;
+
+    private:
+        Impl &m_impl;
+        bool m_outer;
+    };
 
-    void putNode(size_t pageId, const BPlusNode &node) {
-        m_nodeManager->putNode(pageId, node);
+    // Nodes an insert or erase modifies, latched exclusively from the top down
+    struct WritePath {
+        std::vector<ReadGuard> nodes;
+        // nodes[0] is the root, which the operation may replace
+        bool fromRoot = false;
+    };
+
+    ReadGuard readNode(size_t pageId, Latch latch = Latch::SHARED) {
+        return m_nodeManager->readNode(pageId, m_unlatched ? Latch::NONE : latch);
     }
 
-    size_t allocatePage() {
-        return m_nextPageId++;
+    WriteGuard writeNode(size_t pageId) {
+        return m_nodeManager->writeNode(pageId, m_unlatched ? Latch::NONE : Latch::EXCLUSIVE);
     }
 
-    BPlusNode createNode(bool isLeaf) {
-        BPlusNode node;
-        std::memset(&node, 0, sizeof(BPlusNode));
-        node.isLeaf = isLeaf;
-        node.keyCount = 0;
-        node.next = 0;
-        return node;
+    WriteGuard createNode(size_t pageId) {
+        return m_nodeManager->createNode(pageId, m_unlatched ? Latch::NONE : Latch::EXCLUSIVE);
     }
 
-    size_t searchLeaf(int key) {
-        size_t currentPageId = m_rootPageId;
+    // The root, latched as asked; a root replaced before the latch was granted is traded for the new one
+    ReadGuard readRoot(Latch latch) {
         while (true) {
-            BPlusNode current = getNode(currentPageId);
-            if (current.isLeaf) {
-                return currentPageId;
+            size_t rootPageId = m_rootPageId;
+            ReadGuard root = readNode(rootPageId, latch);
+            // Replacing the root latches the old one exclusively, so a match cannot go stale
+            if (m_rootPageId == rootPageId) {
+                return root;
+            }
+        }
+    }
+
+    // A node an insert or erase works on, borrowed from the path when latched there
+    ReadGuard pathNode(const WritePath &path, size_t pageId) {
+        for (const ReadGuard &node : path.nodes) {
+            if (node.pageId() == pageId) {
+                return node.borrow();
             }
+        }
+        return readNode(pageId, Latch::EXCLUSIVE);
+    }
 
-            int childIndex = findChildIndex(&current, key);
-            currentPageId = current.children[childIndex];
+    // Whether inserting (or erasing) a key below node leaves node's parent alone
+    bool isSafe(const BPlusNode *node, bool inserting) const {
+        if (node->isLeaf) {
+            return inserting ? node->keyCount < m_layout.maxLeafKeys : node->keyCount > m_layout.minLeafKeys;
         }
+        return inserting ? node->keyCount < m_layout.maxInternalKeys : node->keyCount > m_layout.minInternalKeys;
     }
 
-    bool insertIntoLeaf(size_t leafPageId, int key) {
-        BPlusNode leaf = getNode(leafPageId);
-        int index = findKeyIndex(&leaf, key);
+    // A new maximum that fits into node, the rightmost leaf; released pages are no leaves
+    bool appendsTo(const BPlusNode *node, const Key &key) const {
+        return node->isLeaf && node->next == 0 && node->keyCount > 0 && node->keyCount < m_layout.maxLeafKeys &&
+               KeyTraits::less(node->keys<Key>()[node->keyCount - 1], key);
+    }
 
-        for (int i = leaf.keyCount; i > index; i--) {
-            leaf.keys[i] = leaf.keys[i - 1];
+    /// @brief Latch what an insert (or erase) of key may modify.
+    /// Mostly that is the leaf alone, reached by crabbing down with shared latches. When the leaf may
+    /// split (or underflow) the descent starts over with exclusive latches, letting go of the ancestors
+    /// of every node that is safe, so the path ends up starting at the lowest node that stays put.
+    WritePath latchPath(const Key &key, bool inserting) {
+        WritePath path;
+        if (std::optional<ReadGuard> leaf = latchSafeLeaf(key, inserting)) {
+            path.nodes.push_back(std::move(*leaf));
+            return path;
         }
+        path.nodes.push_back(readRoot(Latch::EXCLUSIVE));
+        path.fromRoot = true;
+        int level = 0;
+        while (!path.nodes.back()->isLeaf) {
+            const BPlusNode *node = &*path.nodes.back();
+            ReadGuard child = readNode(m_layout.children(node)[findChildIndex(node, key)], Latch::EXCLUSIVE);
+            if (isSafe(&*child, inserting)) {
+                path.nodes.clear();
+                path.fromRoot = false;
+            }
+            path.nodes.push_back(std::move(child));
+            level++;
+        }
+        if (level != m_leafLevel.load(std::memory_order_relaxed)) {
+            m_leafLevel.store(level, std::memory_order_relaxed);
+        }
+        return path;
+    }
 
-        leaf.keys[index] = key;
-        leaf.keyCount++;
-        putNode(leafPageId, leaf);
-        return true;
+    // The leaf of key latched exclusively, if it is safe and not the root. Latches turn exclusive at
+    // the level the leaves were last seen on; a tree that grew or shrank since just costs a retry.
+    std::optional<ReadGuard> latchSafeLeaf(const Key &key, bool inserting) {
+        int leafLevel = m_leafLevel.load(std::memory_order_relaxed);
+        if (leafLevel == 0) {
+            return std::nullopt;
+        }
+        ReadGuard node = readRoot(Latch::SHARED);
+        int level = 0;
+        bool exclusive = false;
+        while (!node->isLeaf) {
+            level++;
+            exclusive = level >= leafLevel;
+            node = readNode(m_layout.children(&*node)[findChildIndex(&*node, key)], exclusive ? Latch::EXCLUSIVE : Latch::SHARED);
+        }
+        if (level != leafLevel) {
+            m_leafLevel.store(level, std::memory_order_relaxed);
+        }
+        if (!exclusive || !isSafe(&*node, inserting)) {
+            return std::nullopt;
+        }
+        return node;
     }
 
-    size_t splitLeaf(size_t leafPageId, int key) {
-        BPlusNode oldLeaf = getNode(leafPageId);
-        size_t newLeafPageId = allocatePage();
-        BPlusNode newLeaf = createNode(true);
+    // Free pages are handed out first. One released by an operation that is still running is latched
+    // by it, and waiting for it might wait on the caller, so then the file grows instead.
+    size_t allocatePage() {
+        std::lock_guard<std::mutex> lock(m_allocationMutex);
+        m_metadataDirty = true;
+        if (m_freeListHead != 0 && !m_nodeManager->isLatched(m_freeListHead)) {
+            size_t pageId = m_freeListHead;
+            m_freeListHead = readNode(pageId, Latch::NONE)->next;
+            m_freePageCount--;
+            return pageId;
+        }
+        return m_nextPageId++;
+    }
 
-        std::vector<int> allKeys(BPlusTree::MAX_KEYS + 1);
-        int insertPos = findKeyIndex(&oldLeaf, key);
+    // Put a page that is no longer part of the tree on the free list, for allocatePage() to reuse first
+    void freePage(WriteGuard &page) {
+        std::lock_guard<std::mutex> lock(m_allocationMutex);
+        page->isLeaf = false;
+        page->keyCount = 0;
+        page->next = m_freeListHead;
+        m_freeListHead = page.pageId();
+        m_freePageCount++;
+        m_metadataDirty = true;
+    }
 
-        for (int i = 0; i < insertPos; i++) {
-            allKeys[i] = oldLeaf.keys[i];
+    // Runs after every modification, with the tree no longer latched by the caller
+    void countModification() {
+        bool syncNow = m_durability == Durability::EVERY_OP ||
+                       (m_durability == Durability::EVERY_N_OPS && ++m_opsSinceSync >= m_syncInterval);
+        if (m_log == nullptr) {
+            if (syncNow) {
+                sync();
+            }
+            return;
+        }
+        if (m_replaying) {
+            return;
+        }
+        if (syncNow) {
+            commitLog();
+        }
+        bool countPages = ++m_modificationsSinceCount % CHECKPOINT_COUNT_INTERVAL == 0;
+        if (m_log->end() >= TRUNCATE_LOG_BYTES) {
+            ExclusiveTree exclusive(*this);
+            // Another thread may have taken care of it meanwhile
+            if (m_log->end() >= TRUNCATE_LOG_BYTES) {
+                truncateLog();
+            }
+        } else if (checkpointDue(countPages)) {
+            checkpointRunning();
         }
+    }
 
-        allKeys[insertPos] = key;
+    /// @brief Checkpoint with the tree stopped as briefly as it can be: the dirty pages are written back
+    /// first while operations go on, latching one page at a time, so the tree only stops for the pages
+    /// modified meanwhile and for the checkpoint record.
+    /// It does stop: the log is replayed key by key on top of the pages a checkpoint lists, so they have
+    /// to be the tree as of one point in the log, not pages written at different times.
+    void checkpointRunning() {
+        auto last = m_lastCheckpoint.load();
+        // A batch operation counts its modification with the tree still to itself
+        if (m_exclusiveOwner.load(std::memory_order_relaxed) != std::this_thread::get_id()) {
+            // Keeps out operations on the whole tree, which write pages without latching them
+            std::shared_lock<std::shared_mutex> shared(m_treeLatch);
+            m_nodeManager->writeBackDirtyPages();
+        }
+        ExclusiveTree exclusive(*this);
+        // Another thread may have taken one meanwhile
+        if (m_lastCheckpoint.load() == last) {
+            checkpoint();
+        }
+    }
 
-        for (int i = insertPos; i < oldLeaf.keyCount; i++) {
-            allKeys[i + 1] = oldLeaf.keys[i];
+    /// @brief Takes the checkpoints checkpointSeconds asks for when no modification comes along to take
+    /// them, so a table that went idle is checkpointed too; one with nothing logged since is left alone.
+    /// A failed checkpoint is tried again after another interval: the log still holds everything, and
+    /// the failure shows in the next checkpoint a modification or closing the table takes.
+    void runCheckpointer() {
+        std::unique_lock<std::mutex> lock(m_checkpointerMutex);
+        auto wake = m_lastCheckpoint.load() + m_checkpointInterval;
+        while (!m_checkpointerWakeup.wait_until(lock, wake, [&] { return m_stopCheckpointer; })) {
+            auto now = std::chrono::steady_clock::now();
+            wake = m_lastCheckpoint.load() + m_checkpointInterval;
+            if (now < wake) {
+                continue;
+            }
+            wake = now + m_checkpointInterval;
+            if (m_log->end() == m_checkpointEnd) {
+                continue;
+            }
+            lock.unlock();
+            try {
+                checkpointRunning();
+                wake = m_lastCheckpoint.load() + m_checkpointInterval;
+            } catch (...) {
+                // Tried again at `wake`
+            }
+            lock.lock();
         }
+    }
 
-        int totalKeys = oldLeaf.keyCount + 1;
-        int midPoint = totalKeys / 2;
+    bool checkpointDue(bool countPages) {
+        if (countPages && m_checkpointPages > 0) {
+            // Pages written back since the last checkpoint were modified since, as are the dirty ones
+            size_t modified = m_nodeManager->dirtyPages() + (m_nodeManager->cacheStats().writebacks - m_checkpointWritebacks);
+            if (modified >= m_checkpointPages) {
+                return true;
+            }
+        }
+        return m_checkpointInterval.count() > 0 && std::chrono::steady_clock::now() - m_lastCheckpoint.load() >= m_checkpointInterval;
+    }
 
-        oldLeaf.keyCount = midPoint;
-        for (int i = 0; i < midPoint; i++) {
-            oldLeaf.keys[i] = allKeys[i];
+    void logKeys(WriteAheadLog::RecordType type, const Key *keys, size_t count) {
+        if (m_log != nullptr && !m_replaying && count > 0) {
+            m_log->append(type, keys, count * sizeof(Key));
         }
+    }
 
-        newLeaf.keyCount = totalKeys - midPoint;
-        for (int i = 0; i < newLeaf.keyCount; i++) {
-            newLeaf.keys[i] = allKeys[midPoint + i];
+    void commitLog() {
+        if (m_durability == Durability::NONE) {
+            m_log->write(m_log->end());
+        } else {
+            m_log->commit(m_log->end());
         }
+        m_opsSinceSync = 0;
+    }
+
+    /// @brief Record the current tree in the log, so recovery starts from here and only replays what follows.
+    /// Dirty cached pages are appended to the log, not written into the table file, and the record lists
+    /// where in the log the latest image of every page changed since the log was last emptied is.
+    /// The metadata page points at the record; a stale pointer only makes recovery read more of the log.
+    void checkpoint() {
+        m_nodeManager->flushDirtyPages();
+        std::vector<std::pair<uint64_t, uint64_t>> pages = m_nodeManager->loggedPages();
+        CheckpointRecord record{m_rootPageId, m_nextPageId, m_freeListHead, m_freePageCount, pages.size()};
+        uint64_t position = m_log->end();
+        m_log->append(WriteAheadLog::RecordType::CHECKPOINT, &record, sizeof(record), pages.data(), pages.size() * sizeof(pages[0]));
+        commitLog();
+        m_checkpointEnd = m_log->end();
+        m_checkpointPosition = position;
+        m_nodeManager->writeMetadataBytes(offsetof(TreeMetadata, checkpointPosition), &position, sizeof(position));
+        m_nodeManager->flushData();
+        m_lastCheckpoint = std::chrono::steady_clock::now();
+        m_checkpointWritebacks = m_nodeManager->cacheStats().writebacks;
+    }
 
-        newLeaf.next = oldLeaf.next;
-        oldLeaf.next = newLeafPageId;
+    /// @brief Bring the table file up to date and empty the log.
+    /// Copying the pages into place starts after a checkpoint, so recovery can take over from that
+    /// checkpoint if the copy is cut short.
+    void truncateLog() {
+        bool toDevice = m_durability != Durability::NONE;
+        auto settle = [&] {
+            if (toDevice) {
+                m_nodeManager->syncData();
+            } else {
+                m_nodeManager->flushData();
+            }
+        };
+        checkpoint();
+        m_nodeManager->writeLoggedPages();
+        settle();
+        // The new generation tells recovery that the records left in the log are applied already
+        TreeMetadata metadata = makeMetadata(m_logGeneration + 1);
+        m_nodeManager->writeMetadata(metadata);
+        settle();
+        m_logGeneration = metadata.logGeneration;
+        m_checkpointPosition = 0;
+        m_log->reset(m_logGeneration, toDevice);
+        m_checkpointEnd = m_log->end();
+        m_metadataDirty = false;
+        m_opsSinceSync = 0;
+    }
+
+    using RedoRecords = std::vector<std::pair<WriteAheadLog::RecordType, std::vector<Key>>>;
+
+    /// @brief Bring the table to where the log a previous run left behind ends.
+    /// The tree starts out as of the latest checkpoint: its metadata, and its pages parked in the log,
+    /// which stay there. Only the insert and erase records after the checkpoint are replayed, and reading
+    /// starts at the checkpoint the metadata page points at. Without a checkpoint the table file is the
+    /// starting point. Returns whether the log held records of this table file.
+    bool recoverLog() {
+        m_log->setGeneration(m_logGeneration);
+        RedoRecords redo;
+        std::vector<char> checkpointed;
+        uint64_t from = m_checkpointPosition;
+        auto visit = [&](const WriteAheadLog::Record &record) {
+            // Records of another generation belong to an older copy of the table file
+            if (record.generation != m_logGeneration || (from > 0 && record.start == from && record.type != WriteAheadLog::RecordType::CHECKPOINT)) {
+                return false;
+            }
+            if (record.type == WriteAheadLog::RecordType::CHECKPOINT) {
+                checkpointed.assign(record.payload.begin(), record.payload.end());
+                redo.clear();
+            } else if (record.type == WriteAheadLog::RecordType::INSERT || record.type == WriteAheadLog::RecordType::ERASE) {
+                std::vector<Key> keys(record.payload.size() / sizeof(Key));
+                std::memcpy(keys.data(), record.payload.data(), keys.size() * sizeof(Key));
+                redo.emplace_back(record.type, std::move(keys));
+            }
+            return true;
+        };
+        uint64_t end = m_log->scan(from, visit);
+        if (from > 0 && end == from) {
+            // The pointer is stale, as the metadata page is not synced when it is updated
+            from = 0;
+            end = m_log->scan(0, visit);
+        }
+        m_log->truncate(end);
+
+        if (checkpointed.size() >= sizeof(CheckpointRecord)) {
+            CheckpointRecord record;
+            std::memcpy(&record, checkpointed.data(), sizeof(record));
+            m_rootPageId = record.rootPageId;
+            m_nextPageId = record.nextPageId;
+            m_freeListHead = record.freeListHead;
+            m_freePageCount = record.freePageCount;
+            for (uint64_t i = 0; i < record.pageCount; ++i) {
+                uint64_t page[2];
+                std::memcpy(page, checkpointed.data() + sizeof(record) + i * sizeof(page), sizeof(page));
+                m_nodeManager->restoreLoggedPage(page[0], page[1]);
+            }
+        }
+        replay(redo);
+        return end > 0;
+    }
 
-        putNode(leafPageId, oldLeaf);
-        putNode(newLeafPageId, newLeaf);
+    void replay(const RedoRecords &redo) {
+        m_replaying = true;
+        for (const auto &[type, keys] : redo) {
+            bool inserts = type == WriteAheadLog::RecordType::INSERT;
+            if (keys.size() == 1 && inserts) {
+                insert(keys[0]);
+            } else if (keys.size() == 1) {
+                erase(keys[0]);
+            } else if (inserts) {
+                insertMany(keys);
+            } else {
+                eraseMany(keys);
+            }
+        }
+        m_replaying = false;
+    }
 
-        return newLeafPageId;
+    WriteGuard newNode(size_t pageId, bool isLeaf) {
+        WriteGuard node = createNode(pageId);
+        node->isLeaf = isLeaf;
+        node->keyCount = 0;
+        node->next = 0;
+        return node;
     }
 
-    size_t splitNonLeaf(size_t nodePageId, int key, size_t newChildPageId) {
-        BPlusNode oldNode = getNode(nodePageId);
-        size_t newNodePageId = allocatePage();
-        BPlusNode newNode = createNode(false);
+    static bool equal(const Key &a, const Key &b) {
+        return !KeyTraits::less(a, b) && !KeyTraits::less(b, a);
+    }
 
-        std::vector<int> allKeys(BPlusTree::MAX_KEYS + 1);
-        std::vector<size_t> allChildren(BPlusTree::MAX_KEYS + 2);
+    static void printKey(const Key &key) {
+        if constexpr (std::is_integral_v<Key>) {
+            std::cout << key;
+        } else {
+            unsigned char bytes[KeyTraits::WIDTH];
+            KeyTraits::normalize(key, bytes);
+            for (unsigned char byte : bytes) {
+                std::cout << std::format("{:02x}", byte);
+            }
+        }
+    }
 
-        int insertPos = findKeyIndex(&oldNode, key);
+    // keyCount of a node read optimistically, kept within the page: a writer may be changing it meanwhile
+    int boundedKeyCount(const BPlusNode *node) const {
+        return std::clamp(node->keyCount, 0, node->isLeaf ? m_layout.maxLeafKeys : m_layout.maxInternalKeys);
+    }
 
-        for (int i = 0; i < insertPos; i++) {
-            allKeys[i] = oldNode.keys[i];
+    // The root read optimistically, or nothing if it was being replaced
+    std::optional<ReadGuard> optimisticRoot() {
+        size_t rootPageId = m_rootPageId;
+        ReadGuard root = readNode(rootPageId, Latch::OPTIMISTIC);
+        // The old root changes along with m_rootPageId, so a root read after the change sees the new id
+        if (m_rootPageId != rootPageId) {
+            return std::nullopt;
         }
+        return root;
+    }
 
-        allKeys[insertPos] = key;
+    /// @brief The leaf for key read optimistically, or nothing if a node on the way changed.
+    /// Lock coupling without the locks: a child is pinned before its parent validates, so the parent
+    /// still pointed at it once the child's version was taken.
+    std::optional<ReadGuard> optimisticLeaf(const Key &key) {
+        std::optional<ReadGuard> node = optimisticRoot();
+        while (node) {
+            bool isLeaf = (*node)->isLeaf;
+            size_t childPageId = 0;
+            if (!isLeaf) {
+                const BPlusNode *parent = &**node;
+                childPageId = m_layout.children(parent)[m_search.upperBound(parent->keys<Key>(), boundedKeyCount(parent), key)];
+            }
+            if (!node->validate()) {
+                return std::nullopt;
+            }
+            if (isLeaf) {
+                return node;
+            }
+            ReadGuard child = readNode(childPageId, Latch::OPTIMISTIC);
+            if (!node->validate()) {
+                return std::nullopt;
+            }
+            node = std::move(child);
+        }
+        return std::nullopt;
+    }
 
-        for (int i = insertPos; i < oldNode.keyCount; i++) {
-            allKeys[i + 1] = oldNode.keys[i];
+    /// @brief visit(leaf) on the leaf that holds key if any does, read without latching anything.
+    /// visit only computes from what it reads, which may be torn, and its result counts once the leaf validates.
+    /// A leaf that changed is read again rather than found again from the root. It is known to still
+    /// cover key from its keys: splits only move keys to the right, so when key lies past the last one,
+    /// the right sibling is taken if it starts at or before key. Anything else starts over from the root.
+    template<typename Visit>
+    auto visitLeaf(const Key &key, const Visit &visit) {
+        while (true) {
+            std::optional<ReadGuard> leaf = optimisticLeaf(key);
+            // The leaf reached from its parent holds key if anything does, until it changes
+            bool coupled = true;
+            while (leaf) {
+                const BPlusNode *node = &**leaf;
+                auto result = visit(node);
+                if (coupled) {
+                    if (leaf->validate()) {
+                        return result;
+                    }
+                    coupled = false;
+                    *leaf = readNode(leaf->pageId(), Latch::OPTIMISTIC);
+                    continue;
+                }
+                // Released pages and empty leaves say nothing about which keys they cover
+                int count = boundedKeyCount(node);
+                bool covers = node->isLeaf && count > 0 && !KeyTraits::less(key, node->keys<Key>()[0]);
+                size_t next = covers && KeyTraits::less(node->keys<Key>()[count - 1], key) ? node->next : 0;
+                if (!leaf->validate()) {
+                    *leaf = readNode(leaf->pageId(), Latch::OPTIMISTIC);
+                    continue;
+                }
+                if (!covers) {
+                    break;
+                }
+                if (next == 0) {
+                    return result;
+                }
+                ReadGuard sibling = readNode(next, Latch::OPTIMISTIC);
+                int siblingCount = boundedKeyCount(&*sibling);
+                bool isLeaf = sibling->isLeaf;
+                bool moveRight = siblingCount > 0 && !KeyTraits::less(key, sibling->keys<Key>()[0]);
+                if (!sibling.validate() || !leaf->validate()) {
+                    *leaf = readNode(leaf->pageId(), Latch::OPTIMISTIC);
+                    continue;
+                }
+                if (!isLeaf || siblingCount == 0) {
+                    break;
+                }
+                if (!moveRight) {
+                    // Key falls between the two leaves, which hold neither
+                    return result;
+                }
+                leaf = std::move(sibling);
+            }
+            std::this_thread::yield();
         }
+    }
+
+    void insertIntoLeaf(WriteGuard &leaf, const Key &key) {
+        int index = findKeyIndex(&*leaf, key);
+        Key *keys = leaf->keys<Key>();
 
-        for (int i = 0; i <= insertPos; i++) {
-            allChildren[i] = oldNode.children[i];
+        for (int i = leaf->keyCount; i > index; i--) {
+            keys[i] = keys[i - 1];
         }
 
+        keys[index] = key;
+        leaf->keyCount++;
+    }
+
+    // Split a full leaf while adding key: in halves, or when `appending` a new maximum, leaving the
+    // old leaf full and the new one holding just key
+    WriteGuard splitLeaf(WriteGuard &oldLeaf, const Key &key, bool appending) {
+        WriteGuard newLeaf = newNode(allocatePage(), true);
+
+        Key *allKeys = splitBuffers().keys.data();
+        const Key *oldKeys = oldLeaf->keys<Key>();
+        int insertPos = findKeyIndex(&*oldLeaf, key);
+
+        std::copy(oldKeys, oldKeys + insertPos, allKeys);
+        allKeys[insertPos] = key;
+        std::copy(oldKeys + insertPos, oldKeys + oldLeaf->keyCount, allKeys + insertPos + 1);
+
+        int totalKeys = oldLeaf->keyCount + 1;
+        int midPoint = appending ? insertPos : totalKeys / 2;
+
+        oldLeaf->keyCount = midPoint;
+        std::copy(allKeys, allKeys + midPoint, oldLeaf->keys<Key>());
+
+        newLeaf->keyCount = totalKeys - midPoint;
+        std::copy(allKeys + midPoint, allKeys + totalKeys, newLeaf->keys<Key>());
+
+        newLeaf->next = oldLeaf->next;
+        oldLeaf->next = newLeaf.pageId();
+
+        return newLeaf;
+    }
+
+    // Split a full internal node while adding key with newChildPageId to its right.
+    // The middle key moves up to the parent through `separator` and is kept in neither half.
+    // When `appending` at the end, the new node only takes the last two children.
+    WriteGuard splitNonLeaf(WriteGuard &oldNode, const Key &key, size_t newChildPageId, Key &separator, bool appending) {
+        WriteGuard newNode = this->newNode(allocatePage(), false);
+
+        SplitBuffers &buffers = splitBuffers();
+        Key *allKeys = buffers.keys.data();
+        size_t *allChildren = buffers.children.data();
+        const Key *oldKeys = oldNode->keys<Key>();
+        const size_t *oldChildren = m_layout.children(&*oldNode);
+
+        int insertPos = findKeyIndex(&*oldNode, key);
+
+        std::copy(oldKeys, oldKeys + insertPos, allKeys);
+        allKeys[insertPos] = key;
+        std::copy(oldKeys + insertPos, oldKeys + oldNode->keyCount, allKeys + insertPos + 1);
+
+        std::copy(oldChildren, oldChildren + insertPos + 1, allChildren);
         allChildren[insertPos + 1] = newChildPageId;
+        std::copy(oldChildren + insertPos + 1, oldChildren + oldNode->keyCount + 1, allChildren + insertPos + 2);
 
-        for (int i = insertPos + 1; i <= oldNode.keyCount; i++) {
-            allChildren[i + 1] = oldNode.children[i];
-        }
+        int totalKeys = oldNode->keyCount + 1;
+        int midPoint = appending ? totalKeys - 2 : totalKeys / 2;
+        separator = allKeys[midPoint];
 
-        int totalKeys = oldNode.keyCount + 1;
-        int midPoint = totalKeys / 2;
+        oldNode->keyCount = midPoint;
+        std::copy(allKeys, allKeys + midPoint, oldNode->keys<Key>());
+        std::copy(allChildren, allChildren + midPoint + 1, m_layout.children(&*oldNode));
+
+        newNode->keyCount = totalKeys - midPoint - 1;
+        std::copy(allKeys + midPoint + 1, allKeys + totalKeys, newNode->keys<Key>());
+        std::copy(allChildren + midPoint + 1, allChildren + totalKeys + 1, m_layout.children(&*newNode));
+
+        return newNode;
+    }
+
+    // Room for two full nodes, plus the separator between them for internal nodes, reused by every
+    // split and rebalance of a thread
+    struct SplitBuffers {
+        std::vector<Key> keys;
+        std::vector<size_t> children;
+    };
 
-        oldNode.keyCount = midPoint;
-        for (int i = 0; i < midPoint; i++) {
-            oldNode.keys[i] = allKeys[i];
-            oldNode.children[i] = allChildren[i];
+    SplitBuffers &splitBuffers() {
+        thread_local SplitBuffers buffers;
+        size_t keys = std::max(2 * m_layout.maxLeafKeys, 2 * m_layout.maxInternalKeys + 1);
+        size_t children = 2 * m_layout.maxInternalKeys + 2;
+        if (buffers.keys.size() < keys || buffers.children.size() < children) {
+            buffers.keys.resize(std::max(buffers.keys.size(), keys));
+            buffers.children.resize(std::max(buffers.children.size(), children));
         }
-        oldNode.children[midPoint] = allChildren[midPoint];
+        return buffers;
+    }
 
-        newNode.keyCount = totalKeys - midPoint;
-        for (int i = 0; i < newNode.keyCount; i++) {
-            newNode.keys[i] = allKeys[midPoint + i];
-            newNode.children[i] = allChildren[midPoint + i];
+    static std::vector<Key> sortedBatch(std::span<const Key> batch) {
+        std::vector<Key> keys(batch.begin(), batch.end());
+        std::sort(keys.begin(), keys.end(), KeyTraits::less);
+        keys.erase(std::unique(keys.begin(), keys.end(), equal), keys.end());
+        return keys;
+    }
+
+    static void prefetch(const void *address) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address);
+#else
+        (void)address;
+#endif
+    }
+
+    // Touch the keys the first three steps of a binary search over node will compare
+    void prefetchSearch(const BPlusNode *node) const {
+        const Key *keys = node->keys<Key>();
+        for (int eighth = 1; eighth < 8; ++eighth) {
+            prefetch(keys + node->keyCount * eighth / 8);
         }
-        newNode.children[newNode.keyCount] = allChildren[totalKeys];
+    }
 
-        putNode(nodePageId, oldNode);
-        putNode(newNodePageId, newNode);
+    // First position in keys[begin, end) whose key is >= key
+    static size_t lowerBound(const std::vector<Key> &keys, size_t begin, size_t end, const Key &key) {
+        return std::lower_bound(keys.begin() + begin, keys.begin() + end, key, KeyTraits::less) - keys.begin();
+    }
 
-        return newNodePageId;
+    // Store `count` sorted keys in leaf, spreading them evenly over new leaves to its right when they
+    // do not fit; returns the first key and page of each new leaf
+    std::vector<std::pair<Key, size_t>> fillLeaves(WriteGuard &leaf, const Key *keys, int count) {
+        int pieces = (count + m_layout.maxLeafKeys - 1) / m_layout.maxLeafKeys;
+        std::vector<std::pair<Key, size_t>> splits;
+        size_t next = leaf->next;
+        BPlusNode *target = &*leaf;
+        std::optional<WriteGuard> newLeaf;
+        int begin = 0;
+        for (int piece = 0; piece < pieces; ++piece) {
+            int end = begin + (count - begin) / (pieces - piece);
+            if (piece > 0) {
+                WriteGuard page = newNode(allocatePage(), true);
+                target->next = page.pageId();
+                splits.push_back({keys[begin], page.pageId()});
+                newLeaf = std::move(page);
+                target = &**newLeaf;
+            }
+            std::copy(keys + begin, keys + end, target->keys<Key>());
+            target->keyCount = end - begin;
+            begin = end;
+        }
+        target->next = next;
+        return splits;
     }
 
-    bool deleteFromLeaf(size_t leafPageId, int key) {
-        BPlusNode leaf = getNode(leafPageId);
+    // Internal-node counterpart of fillLeaves: keyCount keys and keyCount + 1 children, with the key
+    // between two nodes moving up as the separator of the right one
+    std::vector<std::pair<Key, size_t>> fillInternals(WriteGuard &node, const Key *keys, const size_t *children, int keyCount) {
+        int childCount = keyCount + 1;
+        int pieces = (childCount + m_layout.maxInternalKeys) / (m_layout.maxInternalKeys + 1);
+        std::vector<std::pair<Key, size_t>> splits;
+        BPlusNode *target = &*node;
+        std::optional<WriteGuard> newInternal;
+        int begin = 0;
+        for (int piece = 0; piece < pieces; ++piece) {
+            int end = begin + (childCount - begin) / (pieces - piece);
+            if (piece > 0) {
+                newInternal = newNode(allocatePage(), false);
+                splits.push_back({keys[begin - 1], newInternal->pageId()});
+                target = &**newInternal;
+            }
+            std::copy(keys + begin, keys + end - 1, target->keys<Key>());
+            std::copy(children + begin, children + end, m_layout.children(target));
+            target->keyCount = end - begin - 1;
+            begin = end;
+        }
+        return splits;
+    }
+
+    void deleteFromLeaf(WriteGuard &leaf, int index) {
+        Key *keys = leaf->keys<Key>();
+        std::copy(keys + index + 1, keys + leaf->keyCount, keys + index);
+        leaf->keyCount--;
+    }
 
-        int index = findKeyIndex(&leaf, key);
-        if (index >= leaf.keyCount || leaf.keys[index] != key) {
+    // SplitPolicy::B_STAR: make room in parent's full child at childIndex by sharing its keys with an
+    // adjacent sibling that has room, or else by splitting it and a full sibling into three nodes.
+    // Returns false when the split needs a parent entry and the parent is full as well.
+    // Siblings are latched in either order, which is safe as only the holder of parent latches them.
+    bool makeRoom(WriteGuard &parent, int childIndex) {
+        const size_t *children = m_layout.children(&*parent);
+        for (int sibling : {childIndex + 1, childIndex - 1}) {
+            if (sibling < 0 || sibling > parent->keyCount) {
+                continue;
+            }
+            // Two keys of room, so that neither node is left full after the keys are shared
+            bool hasRoom = [&] {
+                ReadGuard node = readNode(children[sibling]);
+                return node->keyCount + 2 <= (node->isLeaf ? m_layout.maxLeafKeys : m_layout.maxInternalKeys);
+            }();
+            if (hasRoom) {
+                redistribute(parent, std::min(childIndex, sibling), 2, 2);
+                return true;
+            }
+        }
+        if (parent->keyCount >= m_layout.maxInternalKeys) {
             return false;
         }
+        if (parent->keyCount == 0) {
+            redistribute(parent, childIndex, 1, 2);
+        } else {
+            redistribute(parent, childIndex < parent->keyCount ? childIndex : childIndex - 1, 2, 3);
+        }
+        return true;
+    }
+
+    // Spread the entries of parent's children [first, first + count) evenly over `pieces` nodes,
+    // adding the missing nodes to their right; parent needs room for the added children.
+    // Separators of internal children come down from parent and the new ones go back up.
+    void redistribute(WriteGuard &parent, int first, int count, int pieces) {
+        Key *parentKeys = parent->keys<Key>();
+        size_t *parentChildren = m_layout.children(&*parent);
+        SplitBuffers &buffers = splitBuffers();
+        Key *allKeys = buffers.keys.data();
+        size_t *allChildren = buffers.children.data();
+
+        std::vector<WriteGuard> nodes;
+        int totalKeys = 0;
+        int totalChildren = 0;
+        for (int i = 0; i < count; ++i) {
+            nodes.push_back(writeNode(parentChildren[first + i]));
+            BPlusNode *node = &*nodes.back();
+            if (i > 0 && !node->isLeaf) {
+                allKeys[totalKeys++] = parentKeys[first + i - 1];
+            }
+            std::copy(node->keys<Key>(), node->keys<Key>() + node->keyCount, allKeys + totalKeys);
+            totalKeys += node->keyCount;
+            if (!node->isLeaf) {
+                const size_t *nodeChildren = m_layout.children(node);
+                std::copy(nodeChildren, nodeChildren + node->keyCount + 1, allChildren + totalChildren);
+                totalChildren += node->keyCount + 1;
+            }
+        }
+        bool isLeaf = nodes.front()->isLeaf;
+        for (int i = count; i < pieces; ++i) {
+            nodes.push_back(newNode(allocatePage(), isLeaf));
+            if (isLeaf) {
+                nodes[i]->next = nodes[i - 1]->next;
+                nodes[i - 1]->next = nodes[i].pageId();
+            }
+        }
 
-        for (int i = index; i < leaf.keyCount - 1; i++) {
-            leaf.keys[i] = leaf.keys[i + 1];
+        // Make room in parent for the added children and their separators
+        int added = pieces - count;
+        std::copy_backward(parentKeys + first + count - 1, parentKeys + parent->keyCount, parentKeys + parent->keyCount + added);
+        std::copy_backward(parentChildren + first + count, parentChildren + parent->keyCount + 1,
+                           parentChildren + parent->keyCount + 1 + added);
+        parent->keyCount += added;
+
+        // Each internal separator moves up, so internal pieces share one key fewer per separator
+        int entries = isLeaf ? totalKeys : totalKeys - (pieces - 1);
+        int nextKey = 0;
+        int nextChild = 0;
+        for (int i = 0; i < pieces; ++i) {
+            if (i > 0) {
+                parentKeys[first + i - 1] = allKeys[nextKey];
+                nextKey += isLeaf ? 0 : 1;
+            }
+            int size = entries * (i + 1) / pieces - entries * i / pieces;
+            BPlusNode *node = &*nodes[i];
+            std::copy(allKeys + nextKey, allKeys + nextKey + size, node->keys<Key>());
+            if (!isLeaf) {
+                std::copy(allChildren + nextChild, allChildren + nextChild + size + 1, m_layout.children(node));
+                nextChild += size + 1;
+            }
+            node->keyCount = size;
+            nextKey += size;
+            parentChildren[first + i] = nodes[i].pageId();
+        }
+    }
+
+    // Bring parent's child at childIndex back to its minimum, either by moving keys over from a
+    // sibling or, when both fit in one page, by merging the pair and dropping their separator.
+    void mergeOrRedistribute(WriteGuard &parent, int childIndex) {
+        // Pair the child with its left sibling, or with its right one for the first child
+        int leftIndex = childIndex > 0 ? childIndex - 1 : childIndex;
+        size_t *parentChildren = m_layout.children(&*parent);
+        WriteGuard left = writeNode(parentChildren[leftIndex]);
+        WriteGuard right = writeNode(parentChildren[leftIndex + 1]);
+        Key &separator = parent->keys<Key>()[leftIndex];
+
+        bool merged = left->isLeaf ? rebalanceLeaves(left, right, separator) : rebalanceInternals(left, right, separator);
+        if (!merged) {
+            return;
         }
 
-        leaf.keyCount--;
-        int newKeyCount = leaf.keyCount;
-        putNode(leafPageId, leaf);
+        // The right node is gone: drop it and its separator from the parent
+        Key *parentKeys = parent->keys<Key>();
+        std::copy(parentKeys + leftIndex + 1, parentKeys + parent->keyCount, parentKeys + leftIndex);
+        std::copy(parentChildren + leftIndex + 2, parentChildren + parent->keyCount + 1, parentChildren + leftIndex + 1);
+        parent->keyCount--;
 
-        if (newKeyCount < BPlusTree::MIN_KEYS && leafPageId != m_rootPageId) {
-            mergeOrRedistribute(leafPageId);
+        freePage(right);
+    }
+
+    // Returns true when right was merged into left, otherwise the keys were split evenly
+    // and separator is the new first key of right
+    bool rebalanceLeaves(WriteGuard &left, WriteGuard &right, Key &separator) {
+        Key *leftKeys = left->keys<Key>();
+        Key *rightKeys = right->keys<Key>();
+        int totalKeys = left->keyCount + right->keyCount;
+
+        if (totalKeys <= m_layout.maxLeafKeys) {
+            std::copy(rightKeys, rightKeys + right->keyCount, leftKeys + left->keyCount);
+            left->keyCount = totalKeys;
+            left->next = right->next;
+            right->keyCount = 0;
+            return true;
         }
 
-        return true;
+        int leftCount = totalKeys / 2;
+        if (left->keyCount < leftCount) {
+            int moved = leftCount - left->keyCount;
+            std::copy(rightKeys, rightKeys + moved, leftKeys + left->keyCount);
+            std::copy(rightKeys + moved, rightKeys + right->keyCount, rightKeys);
+        } else {
+            int moved = left->keyCount - leftCount;
+            std::copy_backward(rightKeys, rightKeys + right->keyCount, rightKeys + right->keyCount + moved);
+            std::copy(leftKeys + leftCount, leftKeys + left->keyCount, rightKeys);
+        }
+        left->keyCount = leftCount;
+        right->keyCount = totalKeys - leftCount;
+        separator = rightKeys[0];
+        return false;
+    }
+
+    // Like rebalanceLeaves, but the separator comes down from the parent between the two halves,
+    // and on redistribution the middle key goes back up
+    bool rebalanceInternals(WriteGuard &left, WriteGuard &right, Key &separator) {
+        SplitBuffers &buffers = splitBuffers();
+        Key *allKeys = buffers.keys.data();
+        size_t *allChildren = buffers.children.data();
+        const Key *leftKeys = left->keys<Key>();
+        const Key *rightKeys = right->keys<Key>();
+        const size_t *leftChildren = m_layout.children(&*left);
+        const size_t *rightChildren = m_layout.children(&*right);
+
+        std::copy(leftKeys, leftKeys + left->keyCount, allKeys);
+        allKeys[left->keyCount] = separator;
+        std::copy(rightKeys, rightKeys + right->keyCount, allKeys + left->keyCount + 1);
+        std::copy(leftChildren, leftChildren + left->keyCount + 1, allChildren);
+        std::copy(rightChildren, rightChildren + right->keyCount + 1, allChildren + left->keyCount + 1);
+
+        int totalKeys = left->keyCount + right->keyCount + 1;
+        if (totalKeys <= m_layout.maxInternalKeys) {
+            std::copy(allKeys, allKeys + totalKeys, left->keys<Key>());
+            std::copy(allChildren, allChildren + totalKeys + 1, m_layout.children(&*left));
+            left->keyCount = totalKeys;
+            right->keyCount = 0;
+            return true;
+        }
+
+        int midPoint = totalKeys / 2;
+        separator = allKeys[midPoint];
+
+        left->keyCount = midPoint;
+        std::copy(allKeys, allKeys + midPoint, left->keys<Key>());
+        std::copy(allChildren, allChildren + midPoint + 1, m_layout.children(&*left));
+
+        right->keyCount = totalKeys - midPoint - 1;
+        std::copy(allKeys + midPoint + 1, allKeys + totalKeys, right->keys<Key>());
+        std::copy(allChildren + midPoint + 1, allChildren + totalKeys + 1, m_layout.children(&*right));
+        return false;
+    }
+
+    // Page size of an existing table file, read from its metadata page before the file is opened,
+    // or the requested size (0 for the default) for a new file
+    static size_t tablePageSize(const std::string &fileName, size_t requested) {
+        TreeMetadata metadata{};
+        std::ifstream file(fileName, std::ios::binary);
+        if (file.read(reinterpret_cast<char *>(&metadata), sizeof(metadata))) {
+            return metadata.formatVersion >= 3 ? metadata.pageSize : Pager::PAGE_SIZE;
+        }
+        return requested == 0 ? Pager::PAGE_SIZE : requested;
     }
 
-    void mergeOrRedistribute(size_t pageId) {
-        (void)pageId;
+    // A mapped table needs no page I/O of its own, so useMmap wins over asyncIo
+    static Pager::Backend pagerBackend(const TreeOptions &options) {
+        if (options.useMmap) {
+            return Pager::Backend::MMAP;
+        }
+        return options.asyncIo ? Pager::Backend::URING : Pager::Backend::STREAM;
     }
 
     void saveMetadata() {
+        m_nodeManager->writeMetadata(makeMetadata(m_logGeneration));
+    }
+
+    // Metadata of the table file alone, without a checkpoint in the log
+    TreeMetadata makeMetadata(uint32_t logGeneration) {
         TreeMetadata metadata;
         metadata.rootPageId = m_rootPageId;
         metadata.nextPageId = m_nextPageId;
+        metadata.formatVersion = FORMAT_VERSION;
+        metadata.pageSize = static_cast<uint32_t>(m_pageSize);
+        metadata.keyWidth = static_cast<uint32_t>(KeyTraits::WIDTH);
+        metadata.logGeneration = logGeneration;
+        metadata.freeListHead = m_freeListHead;
+        metadata.freePageCount = m_freePageCount;
+        metadata.checkpointPosition = 0;
+        metadata.logSettings = logSettings();
         std::memset(metadata.padding, 0, sizeof(metadata.padding));
-        m_nodeManager->writeMetadata(metadata);
+        return metadata;
+    }
+
+    LogSettings logSettings() const {
+        if (!m_writeAheadLog) {
+            return {};
+        }
+        return {1, static_cast<uint32_t>(m_durability), m_syncInterval,
+                static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(m_checkpointInterval).count()), m_checkpointPages};
     }
 
-    void loadMetadata() {
+    void applyLogSettings(const LogSettings &settings) {
+        if (settings.durability > static_cast<uint32_t>(Durability::EVERY_OP)) {
+            throw std::runtime_error(std::format("Unknown durability level {} in the table metadata", settings.durability));
+        }
+        m_durability = static_cast<Durability>(settings.durability);
+        m_syncInterval = settings.syncInterval;
+        m_checkpointInterval = std::chrono::seconds(settings.checkpointSeconds);
+        m_checkpointPages = settings.checkpointPages;
+    }
+
+    // Returns the log settings the file records, none before version 7
+    LogSettings loadMetadata() {
         TreeMetadata metadata;
         m_nodeManager->readMetadata(metadata);
+        if (metadata.formatVersion < 2 || metadata.formatVersion > FORMAT_VERSION) {
+            throw std::runtime_error(std::format("Unsupported table file format version {}", metadata.formatVersion));
+        }
+        size_t keyWidth = metadata.formatVersion >= 4 ? metadata.keyWidth : sizeof(int32_t);
+        if (keyWidth != KeyTraits::WIDTH) {
+            throw std::runtime_error(std::format("Table file holds {}-byte keys, not {}-byte keys", keyWidth, KeyTraits::WIDTH));
+        }
         m_rootPageId = metadata.rootPageId;
         m_nextPageId = metadata.nextPageId;
+        if (metadata.formatVersion >= 5) {
+            m_freeListHead = metadata.freeListHead;
+            m_freePageCount = metadata.freePageCount;
+        }
+        m_logGeneration = metadata.formatVersion >= 6 ? metadata.logGeneration : 0;
+        m_checkpointPosition = metadata.formatVersion >= 6 ? metadata.checkpointPosition : 0;
+        return metadata.formatVersion >= 7 ? metadata.logSettings : LogSettings{};
     }
 
-    int findKeyIndex(const BPlusNode *node, int key) {
-        int index = 0;
-        while (index < node->keyCount && node->keys[index] < key) {
-            index++;
-        }
-        return index;
+    // First index whose key is >= key
+    int findKeyIndex(const BPlusNode *node, const Key &key) {
+        return static_cast<int>(m_search.lowerBound(node->keys<Key>(), node->keyCount, key));
     }
 
-    int findChildIndex(const BPlusNode *node, int key) {
-        int index = 0;
-        while (index < node->keyCount && key >= node->keys[index]) {
-            index++;
-        }
-        return index;
+    // Child covering key: the number of keys <= key
+    int findChildIndex(const BPlusNode *node, const Key &key) {
+        return static_cast<int>(m_search.upperBound(node->keys<Key>(), node->keyCount, key));
     }
 
-    size_t m_rootPageId;
-    size_t m_nextPageId;
+    // Changed only with the old root latched exclusively, see readRoot()
+    std::atomic<size_t> m_rootPageId;
+    std::atomic<size_t> m_nextPageId;
+    // Last leaf insert saw as the rightmost one; checked before use, as erases and splits elsewhere may move it
+    std::atomic<size_t> m_rightmostLeaf = 0;
+    // Levels below the root, as the latest descent to a leaf found them; see latchSafeLeaf()
+    std::atomic<int> m_leafLevel = 0;
+    std::atomic<bool> m_metadataDirty = false;
+    Durability m_durability;
+    SplitPolicy m_splitPolicy;
+    size_t m_syncInterval;
+    std::atomic<size_t> m_opsSinceSync = 0;
+    std::chrono::steady_clock::duration m_checkpointInterval;
+    size_t m_checkpointPages;
+    std::atomic<std::chrono::steady_clock::time_point> m_lastCheckpoint = std::chrono::steady_clock::now();
+    // CacheStats::writebacks at the last checkpoint
+    std::atomic<uint64_t> m_checkpointWritebacks = 0;
+    // Where the log ended after the last checkpoint
+    std::atomic<uint64_t> m_checkpointEnd = 0;
+    // See runCheckpointer(); started once the log is recovered and stopped before it is emptied on close
+    std::thread m_checkpointer;
+    std::mutex m_checkpointerMutex;
+    std::condition_variable m_checkpointerWakeup;
+    bool m_stopCheckpointer = false;
+    std::atomic<size_t> m_modificationsSinceCount = 0;
+    // Held shared by lookups, scans, inserts and erases, which latch the pages they visit or read them
+    // optimistically, and exclusively by operations on the whole tree (see ExclusiveTree), which do neither
+    std::shared_mutex m_treeLatch;
+    std::atomic<std::thread::id> m_exclusiveOwner;
+    bool m_unlatched = false;
+    // Guards the free list and m_nextPageId
+    std::mutex m_allocationMutex;
+    // In-node search, SIMD kernels picked for this CPU for integer keys
+    KeySearch<KeyTraits> m_search;
+    size_t m_pageSize;
+    // Declared before m_nodeManager, whose pager writes to it until the end
+    std::unique_ptr<WriteAheadLog> m_log;
+    // The table keeps its log; m_log is also set while a dropped log is applied
+    bool m_writeAheadLog = false;
+    uint32_t m_logGeneration = 0;
+    uint64_t m_checkpointPosition = 0;
+    // Log records are being applied, so they must not be logged again
+    bool m_replaying = false;
     std::unique_ptr<NodeManager> m_nodeManager;
+    NodeLayout<Key> m_layout;
+    // Merged leaf keys of a batch insert
+    std::vector<Key> m_batchKeys;
+    // Free list of released pages, see TreeMetadata
+    size_t m_freeListHead = 0;
+    size_t m_freePageCount = 0;
 };
 
-BPlusTree::BPlusTree(const std::string &fileName)
-    : m_impl(std::make_unique<Impl>(fileName)) {}
+std::shared_ptr<BufferPool> makeSharedBufferPool(size_t budgetBytes, size_t pageSize) {
+    if (pageSize == 0) {
+        pageSize = Pager::PAGE_SIZE;
+    }
+    if (!Pager::isValidPageSize(pageSize)) {
+        throw std::invalid_argument("Page size must be a power of two between 4K and 64K");
+    }
+    size_t frames = budgetBytes / pageSize;
+    return std::make_shared<BufferPool>(frames, pageSize, BufferPool::shardsFor(frames));
+}
+
+template<typename KeyTraits>
+BasicBPlusTree<KeyTraits>::BasicBPlusTree(const std::string &fileName, const TreeOptions &options)
+    : m_impl(std::make_unique<Impl>(fileName, options)) {}
 
-BPlusTree::~BPlusTree() = default;
+template<typename KeyTraits>
+BasicBPlusTree<KeyTraits>::~BasicBPlusTree() = default;
 
-BPlusTree::BPlusTree(BPlusTree &&other) noexcept = default;
+template<typename KeyTraits>
+BasicBPlusTree<KeyTraits>::BasicBPlusTree(BasicBPlusTree &&other) noexcept = default;
 
-BPlusTree &BPlusTree::operator=(BPlusTree &&other) noexcept = default;
+template<typename KeyTraits>
+BasicBPlusTree<KeyTraits> &BasicBPlusTree<KeyTraits>::operator=(BasicBPlusTree &&other) noexcept = default;
+
+template<typename KeyTraits>
+size_t BasicBPlusTree<KeyTraits>::recover(std::span<const std::string> fileNames, size_t threads) {
+    std::vector<std::string> pending;
+    for (const std::string &fileName : fileNames) {
+        std::error_code error;
+        if (std::filesystem::file_size(fileName + ".wal", error) > 0 && !error) {
+            pending.push_back(fileName);
+        }
+    }
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    threads = std::clamp<size_t>(threads, 1, std::max<size_t>(pending.size(), 1));
+
+    // Tables do not share a cache, so each worker recovers whole tables on its own
+    std::atomic<size_t> next = 0;
+    std::mutex failureMutex;
+    std::exception_ptr failure;
+    auto work = [&] {
+        for (size_t i = next++; i < pending.size(); i = next++) {
+            try {
+                BasicBPlusTree tree(pending[i]);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(failureMutex);
+                if (failure == nullptr) {
+                    failure = std::current_exception();
+                }
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    if (failure != nullptr) {
+        std::rethrow_exception(failure);
+    }
+    return pending.size();
+}
 
-bool BPlusTree::insert(int key) {
+template<typename KeyTraits>
+bool BasicBPlusTree<KeyTraits>::insert(const Key &key) {
     return m_impl->insert(key);
 }
 
-bool BPlusTree::search(int key) {
+template<typename KeyTraits>
+bool BasicBPlusTree<KeyTraits>::search(const Key &key) {
     return m_impl->search(key);
 }
 
-bool BPlusTree::erase(int key) {
+template<typename KeyTraits>
+bool BasicBPlusTree<KeyTraits>::erase(const Key &key) {
     return m_impl->erase(key);
 }
 
-void BPlusTree::dfs() {
+template<typename KeyTraits>
+size_t BasicBPlusTree<KeyTraits>::searchMany(std::span<const Key> keys, std::span<bool> found) {
+    return m_impl->searchMany(keys, found);
+}
+
+template<typename KeyTraits>
+size_t BasicBPlusTree<KeyTraits>::insertMany(std::span<const Key> keys) {
+    return m_impl->insertMany(keys);
+}
+
+template<typename KeyTraits>
+size_t BasicBPlusTree<KeyTraits>::eraseMany(std::span<const Key> keys) {
+    return m_impl->eraseMany(keys);
+}
+
+template<typename KeyTraits>
+size_t BasicBPlusTree<KeyTraits>::scan(const Key &low, const Key &high, const std::function<bool(const Key &)> &visit) {
+    return m_impl->scan(low, high, visit);
+}
+
+template<typename KeyTraits>
+size_t BasicBPlusTree<KeyTraits>::bulkLoad(const std::function<bool(Key &)> &next, double fillFactor) {
+    return m_impl->bulkLoad(next, fillFactor);
+}
+
+template<typename KeyTraits>
+size_t BasicBPlusTree<KeyTraits>::shrink() {
+    return m_impl->shrink();
+}
+
+template<typename KeyTraits>
+void BasicBPlusTree<KeyTraits>::sync() {
+    m_impl->sync();
+}
+
+template<typename KeyTraits>
+CacheStats BasicBPlusTree<KeyTraits>::cacheStats() const {
+    return m_impl->cacheStats();
+}
+
+template<typename KeyTraits>
+std::vector<CacheStats> BasicBPlusTree<KeyTraits>::cacheShardStats() const {
+    return m_impl->cacheShardStats();
+}
+
+template<typename KeyTraits>
+void BasicBPlusTree<KeyTraits>::dfs() {
     m_impl->dfs();
 }
 
+template class BasicBPlusTree<Int32Key>;
+template class BasicBPlusTree<Int64Key>;
+template class BasicBPlusTree<UInt64Key>;
+template class BasicBPlusTree<FixedBytesKey<8>>;
+template class BasicBPlusTree<FixedBytesKey<16>>;
+template class BasicBPlusTree<FixedBytesKey<32>>;
+
 }
@@ -0,0 +1,901 @@
+#ifndef __BUFFER_POOL_H__
+#define __BUFFER_POOL_H__
+
+#include "pager.h"
+#include "replacer.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace bplus_sql {
+
+// A tenant's frames over every shard of a pool, held within its maximum
+struct TenantQuota {
+    // PoolShard::UNLIMITED for none
+    size_t maxFrames = 0;
+    std::atomic<size_t> frames = 0;
+};
+
+/// @brief One partition of a BufferPool: frames with an open-addressing page table and an intrusive list
+/// of the frames holding pages. All memory is allocated up front, so looking up, installing and evicting
+/// pages never allocates.
+/// Tenants (see BufferPool) may reserve a minimum number of the shard's frames that other tenants cannot
+/// evict, and may be capped at a maximum over the whole pool (TenantQuota). The shard decides which tenant
+/// gives up a frame from a few counters per tenant (see tenantVictim()); the tenant's own Replacer then
+/// picks which of its pages goes. A hit only updates those counters and the replacer.
+/// Frames are numbered from 0 within the shard; `data` holds the shard's slice of the pool's memory.
+class PoolShard {
+public:
+    static constexpr uint32_t NO_FRAME = UINT32_MAX;
+    static constexpr size_t UNLIMITED = 0;
+    // A tree operation pins a root-to-leaf path plus split siblings, so a tenant never gets fewer frames
+    static constexpr size_t MIN_TENANT_FRAMES = 16;
+
+    PoolShard(size_t capacity, size_t frameSize, char *data)
+        : m_capacity(capacity), m_frameSize(frameSize), m_data(data), m_frames(capacity), m_replacement(capacity),
+          m_table(tableSizeFor(capacity), NO_FRAME) {
+        m_tableMask = m_table.size() - 1;
+        // Every frame starts on the free list
+        for (uint32_t frame = 0; frame < capacity; ++frame) {
+            m_frames[frame].next = frame + 1 < capacity ? frame + 1 : NO_FRAME;
+        }
+        m_freeHead = capacity > 0 ? 0 : NO_FRAME;
+    }
+
+    PoolShard(const PoolShard &) = delete;
+    PoolShard &operator=(const PoolShard &) = delete;
+
+    size_t capacity() const {
+        return m_capacity;
+    }
+
+    size_t size() const {
+        return m_used;
+    }
+
+    std::mutex &mutex() {
+        return m_mutex;
+    }
+
+    // Whether the shard can keep `minFrames` more frames for a tenant
+    bool canReserve(size_t minFrames) const {
+        return m_reservedFrames + minFrames <= m_capacity;
+    }
+
+    // Set up `tenant`, an id the pool picked, whose dirty pages are written back through `pager`
+    void registerTenant(uint32_t tenant, Pager *pager, size_t minFrames, TenantQuota *quota, ReplacementPolicy policy) {
+        if (tenant >= m_tenants.size()) {
+            m_tenants.resize(tenant + 1);
+        }
+        size_t replacerFrames = quota->maxFrames == UNLIMITED ? m_capacity : std::min(quota->maxFrames, m_capacity);
+        m_tenants[tenant] = {pager, minFrames, quota, 0, 0, 0, 0, 0, 0, true, makeReplacer(policy, m_replacement, replacerFrames), {}};
+        m_reservedFrames += minFrames;
+    }
+
+    bool isActive(uint32_t tenant) const {
+        return tenant < m_tenants.size() && m_tenants[tenant].active;
+    }
+
+    // Drop every frame of the tenant without writing it back; the caller flushes first and holds `lock`
+    void unregisterTenant(uint32_t tenant, std::unique_lock<std::mutex> &lock) {
+        waitForWritebacks(tenant, lock);
+        uint32_t frame = m_head;
+        while (frame != NO_FRAME) {
+            uint32_t next = m_frames[frame].next;
+            if (m_frames[frame].tenant == tenant) {
+                evict(frame);
+                release(frame);
+            }
+            frame = next;
+        }
+        m_reservedFrames -= m_tenants[tenant].minFrames;
+        m_tenants[tenant].active = false;
+        m_tenants[tenant].replacer.reset();
+    }
+
+    // Drop the tenant's cached pages from `firstPageId` on without writing them back; none may be pinned
+    void dropPages(uint32_t tenant, size_t firstPageId, std::unique_lock<std::mutex> &lock) {
+        waitForWritebacks(tenant, lock);
+        uint32_t frame = m_head;
+        while (frame != NO_FRAME) {
+            uint32_t next = m_frames[frame].next;
+            if (m_frames[frame].tenant == tenant && m_frames[frame].pageId >= firstPageId) {
+                evict(frame);
+                release(frame);
+            }
+            frame = next;
+        }
+    }
+
+    size_t tenantSize(uint32_t tenant) const {
+        return m_tenants[tenant].frames;
+    }
+
+    ReplacementPolicy policy(uint32_t tenant) const {
+        return m_tenants[tenant].replacer->policy();
+    }
+
+    const CacheStats &stats(uint32_t tenant) const {
+        return m_tenants[tenant].stats;
+    }
+
+    size_t reservedFrames(uint32_t tenant) const {
+        return m_tenants[tenant].minFrames;
+    }
+
+    // Cached pages of the tenant that are modified and not written back yet
+    size_t dirtyPages(uint32_t tenant) const {
+        return m_tenants[tenant].dirtyFrames;
+    }
+
+    // Frame holding the tenant's page, or NO_FRAME. Counts a hit or a miss for the tenant.
+    uint32_t lookup(uint32_t tenant, size_t pageId) {
+        uint32_t frame = m_table[findSlot(tenant, pageId)];
+        Tenant &owner = m_tenants[tenant];
+        if (frame != NO_FRAME) {
+            owner.lastUse = ++m_tick;
+            if (!m_frames[frame].reused) {
+                m_frames[frame].reused = true;
+                owner.coldFrames--;
+            }
+            owner.replacer->accessed(frame);
+            owner.stats.hits++;
+        } else {
+            owner.stats.misses++;
+        }
+        return frame;
+    }
+
+    // Frame holding the tenant's page, or NO_FRAME; counts nothing
+    uint32_t find(uint32_t tenant, size_t pageId) const {
+        return m_table[findSlot(tenant, pageId)];
+    }
+
+    bool contains(uint32_t tenant, size_t pageId) const {
+        return find(tenant, pageId) != NO_FRAME;
+    }
+
+    // Take a frame off the free list, or NO_FRAME once every frame holds a page
+    uint32_t freeFrame() {
+        uint32_t frame = m_freeHead;
+        if (frame != NO_FRAME) {
+            m_freeHead = m_frames[frame].next;
+        }
+        return frame;
+    }
+
+    /// @brief Frame the tenant may take over, or NO_FRAME if none qualifies.
+    /// A tenant at its maximum only replaces its own pages; otherwise the tenant picked by tenantVictim()
+    /// gives one up. Which of the owner's pages is evicted is up to the owner's replacement policy.
+    uint32_t victim(uint32_t tenant) {
+        const TenantQuota &quota = *m_tenants[tenant].quota;
+        if (quota.maxFrames != UNLIMITED && quota.frames >= quota.maxFrames) {
+            return m_tenants[tenant].replacer->victim();
+        }
+        return tenantVictim(tenant);
+    }
+
+    /// @brief A frame ready for install() of the tenant's page, with the shard locked through `lock`: a free
+    /// one, or a victim after writing it back. Clean victims match the disk already and are dropped for free;
+    /// dirty ones are written back with the shard unlocked (see reclaim()).
+    /// NO_FRAME means either that another thread installed the page meanwhile, or that the tenant is at
+    /// its maximum without a page of its own to give up in this shard; contains() tells which.
+    uint32_t acquireFrame(uint32_t tenant, size_t pageId, std::unique_lock<std::mutex> &lock) {
+        TenantQuota &quota = *m_tenants[tenant].quota;
+        while (true) {
+            bool charged = charge(quota);
+            uint32_t frame = charged ? freeFrame() : NO_FRAME;
+            if (frame != NO_FRAME) {
+                return frame;
+            }
+            frame = charged ? tenantVictim(tenant) : m_tenants[tenant].replacer->victim();
+            if (frame == NO_FRAME) {
+                if (!charged) {
+                    return NO_FRAME;
+                }
+                quota.frames--;
+                throw std::runtime_error("Buffer pool exhausted: every evictable frame is pinned");
+            }
+            // Replacing one of its own pages at the maximum: evicting it gives the frame back right away
+            if (!charged) {
+                quota.frames++;
+            }
+            bool unlocks = m_frames[frame].dirty;
+            try {
+                frame = reclaim(frame, lock);
+            } catch (...) {
+                quota.frames--;
+                throw;
+            }
+            if (unlocks && contains(tenant, pageId)) {
+                if (frame != NO_FRAME) {
+                    release(frame);
+                }
+                quota.frames--;
+                return NO_FRAME;
+            }
+            if (frame != NO_FRAME) {
+                return frame;
+            }
+            quota.frames--;
+        }
+    }
+
+    // Evict one of the tenant's own unpinned pages and free its frame, with the shard locked through `lock`;
+    // false if it has none to give up
+    bool shrink(uint32_t tenant, std::unique_lock<std::mutex> &lock) {
+        while (true) {
+            uint32_t frame = m_tenants[tenant].replacer->victim();
+            if (frame == NO_FRAME) {
+                return false;
+            }
+            frame = reclaim(frame, lock);
+            if (frame != NO_FRAME) {
+                release(frame);
+                return true;
+            }
+        }
+    }
+
+    // Map the tenant's page to a frame obtained from acquireFrame(); the frame starts clean and unpinned
+    void install(uint32_t frame, uint32_t tenant, size_t pageId) {
+        Frame &meta = m_frames[frame];
+        meta.tenant = tenant;
+        meta.pageId = pageId;
+        meta.pins = 0;
+        meta.dirty = false;
+        meta.reused = false;
+        m_table[findSlot(tenant, pageId)] = frame;
+        pushFront(frame);
+        m_replacement[frame].evictable = true;
+        Tenant &owner = m_tenants[tenant];
+        owner.replacer->inserted(frame, pageId);
+        owner.frames++;
+        owner.coldFrames++;
+        owner.lastUse = ++m_tick;
+        m_used++;
+    }
+
+    // Drop the page held by frame; the frame can be installed again right away
+    void evict(uint32_t frame) {
+        if (m_frames[frame].dirty) {
+            m_frames[frame].dirty = false;
+            m_tenants[m_frames[frame].tenant].dirtyFrames--;
+        }
+        eraseSlot(findSlot(m_frames[frame].tenant, m_frames[frame].pageId));
+        unlink(frame);
+        Tenant &owner = m_tenants[m_frames[frame].tenant];
+        owner.replacer->removed(frame);
+        owner.frames--;
+        if (!m_frames[frame].reused) {
+            owner.coldFrames--;
+        }
+        owner.quota->frames--;
+        m_used--;
+    }
+
+    // Return a frame that holds no page to the free list
+    void release(uint32_t frame) {
+        m_frames[frame].next = m_freeHead;
+        m_freeHead = frame;
+    }
+
+    char *data(uint32_t frame) const {
+        return m_data + static_cast<size_t>(frame) * m_frameSize;
+    }
+
+    size_t pageId(uint32_t frame) const {
+        return m_frames[frame].pageId;
+    }
+
+    uint32_t tenant(uint32_t frame) const {
+        return m_frames[frame].tenant;
+    }
+
+    void pin(uint32_t frame) {
+        if (m_frames[frame].pins++ == 0) {
+            m_tenants[m_frames[frame].tenant].replacer->setEvictable(frame, false);
+        }
+    }
+
+    void unpin(uint32_t frame) {
+        if (--m_frames[frame].pins == 0) {
+            m_tenants[m_frames[frame].tenant].replacer->setEvictable(frame, true);
+        }
+    }
+
+    bool isDirty(uint32_t frame) const {
+        return m_frames[frame].dirty;
+    }
+
+    void markDirty(uint32_t frame) {
+        if (!m_frames[frame].dirty) {
+            m_frames[frame].dirty = true;
+            m_tenants[m_frames[frame].tenant].dirtyFrames++;
+        }
+    }
+
+    void markClean(uint32_t frame) {
+        if (m_frames[frame].dirty) {
+            m_frames[frame].dirty = false;
+            m_tenants[m_frames[frame].tenant].dirtyFrames--;
+        }
+    }
+
+    // Apply fn(frame) to every frame holding a page of the tenant; fn must not reorder the pool
+    template<typename Func>
+    void forEachFrame(uint32_t tenant, Func &&fn) {
+        for (uint32_t frame = m_head; frame != NO_FRAME; frame = m_frames[frame].next) {
+            if (m_frames[frame].tenant == tenant) {
+                fn(frame);
+            }
+        }
+    }
+
+private:
+    struct Frame {
+        size_t pageId = 0;
+        uint32_t tenant = 0;
+        uint32_t pins = 0;
+        bool dirty = false;
+        // Hit at least once since the page was installed
+        bool reused = false;
+        // Intrusive links of the frames holding pages, in no particular order; `next` also chains the free list
+        uint32_t prev = NO_FRAME;
+        uint32_t next = NO_FRAME;
+    };
+
+    struct Tenant {
+        Pager *pager = nullptr;
+        size_t minFrames = 0;
+        // Shared with the tenant's entries in the other shards
+        TenantQuota *quota = nullptr;
+        size_t frames = 0;
+        // Frames whose page has not been hit since it was installed
+        size_t coldFrames = 0;
+        // Shard tick of the tenant's last hit or install
+        uint64_t lastUse = 0;
+        // Last tenantVictim() call that asked the tenant's replacer already
+        uint64_t triedSearch = 0;
+        size_t dirtyFrames = 0;
+        // Pages being written back by reclaim() with the shard unlocked
+        size_t writebacks = 0;
+        bool active = false;
+        std::unique_ptr<Replacer> replacer;
+        CacheStats stats;
+    };
+
+    // Count one more frame against the quota, unless it is at its maximum already
+    static bool charge(TenantQuota &quota) {
+        size_t frames = quota.frames.load();
+        do {
+            if (quota.maxFrames != UNLIMITED && frames >= quota.maxFrames) {
+                return false;
+            }
+        } while (!quota.frames.compare_exchange_weak(frames, frames + 1));
+        return true;
+    }
+
+    // Share of the tenant's frames whose page was never hit again, all of them once the tenant has been idle
+    // for as many ticks as the shard has frames: it has no more claim on them than a page LRU would evict
+    size_t coldFrames(const Tenant &owner) const {
+        return m_tick - owner.lastUse > m_capacity ? owner.frames : owner.coldFrames;
+    }
+
+    /// @brief Unpinned frame of the tenant that should give one up for `tenant`, or NO_FRAME.
+    /// Pages read once and never hit again, like those of a scan, are the cheapest to lose, so the tenant
+    /// with the largest share of them goes first and the least recently used one breaks ties. A table
+    /// scanning through the pool thus replaces its own pages rather than the ones other tables keep using.
+    /// The requester may always give up its own pages, other tenants only above their reserved minimum.
+    uint32_t tenantVictim(uint32_t tenant) {
+        uint64_t search = ++m_victimSearches;
+        while (true) {
+            Tenant *chosen = nullptr;
+            for (uint32_t candidate = 0; candidate < m_tenants.size(); ++candidate) {
+                Tenant &owner = m_tenants[candidate];
+                if (!owner.active || owner.frames == 0 || owner.triedSearch == search ||
+                    (candidate != tenant && owner.frames <= owner.minFrames)) {
+                    continue;
+                }
+                if (chosen == nullptr) {
+                    chosen = &owner;
+                    continue;
+                }
+                // Compare the cold shares coldFrames / frames without dividing
+                size_t colder = coldFrames(owner) * chosen->frames, current = coldFrames(*chosen) * owner.frames;
+                if (colder > current || (colder == current && owner.lastUse < chosen->lastUse)) {
+                    chosen = &owner;
+                }
+            }
+            if (chosen == nullptr) {
+                return NO_FRAME;
+            }
+            // Every frame of the chosen tenant may be pinned: fall back to the next one
+            chosen->triedSearch = search;
+            uint32_t frame = chosen->replacer->victim();
+            if (frame != NO_FRAME) {
+                return frame;
+            }
+        }
+    }
+
+    /// @brief Evict the victim so that its frame can be installed again, writing it back first if it is
+    /// dirty; NO_FRAME if the victim was pinned or modified during the write.
+    /// The write goes out from a copy, taken while nobody can be modifying the unpinned page, with the
+    /// victim pinned and the shard unlocked: other threads keep using the shard, and the page, meanwhile.
+    uint32_t reclaim(uint32_t frame, std::unique_lock<std::mutex> &lock) {
+        uint32_t owner = m_frames[frame].tenant;
+        if (m_frames[frame].dirty) {
+            thread_local std::unique_ptr<char[]> copy(new char[Pager::MAX_PAGE_SIZE]);
+            std::memcpy(copy.get(), data(frame), m_frameSize);
+            size_t pageId = m_frames[frame].pageId;
+            Pager *pager = m_tenants[owner].pager;
+            // Modified again meanwhile, it is dirty once more and stays
+            markClean(frame);
+            pin(frame);
+            m_tenants[owner].writebacks++;
+            lock.unlock();
+            std::exception_ptr error;
+            try {
+                pager->writePageData(pageId, copy.get());
+            } catch (...) {
+                error = std::current_exception();
+            }
+            lock.lock();
+            m_tenants[owner].writebacks--;
+            m_writebacksDone.notify_all();
+            unpin(frame);
+            if (error) {
+                markDirty(frame);
+                std::rethrow_exception(error);
+            }
+            m_tenants[owner].stats.writebacks++;
+            if (m_frames[frame].pins != 0 || m_frames[frame].dirty) {
+                return NO_FRAME;
+            }
+        }
+        m_tenants[owner].stats.evictions++;
+        evict(frame);
+        return frame;
+    }
+
+    // Frames being written back stay pinned, so the tenant's frames can only be dropped once they are done
+    void waitForWritebacks(uint32_t tenant, std::unique_lock<std::mutex> &lock) {
+        m_writebacksDone.wait(lock, [&] { return m_tenants[tenant].writebacks == 0; });
+    }
+
+    static size_t tableSizeFor(size_t capacity) {
+        // Keep the load factor at or below 1/2 so probe sequences stay short
+        size_t size = 2;
+        while (size < capacity * 2) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    size_t hash(uint32_t tenant, size_t pageId) const {
+        return ((pageId ^ (static_cast<size_t>(tenant) << 48)) * 0x9E3779B97F4A7C15ull) & m_tableMask;
+    }
+
+    // Slot holding the tenant's page, or the empty slot where it would be inserted
+    size_t findSlot(uint32_t tenant, size_t pageId) const {
+        size_t slot = hash(tenant, pageId);
+        while (m_table[slot] != NO_FRAME &&
+               (m_frames[m_table[slot]].pageId != pageId || m_frames[m_table[slot]].tenant != tenant)) {
+            slot = (slot + 1) & m_tableMask;
+        }
+        return slot;
+    }
+
+    // Linear-probing deletion: shift later entries back instead of leaving tombstones
+    void eraseSlot(size_t slot) {
+        size_t next = slot;
+        while (true) {
+            next = (next + 1) & m_tableMask;
+            uint32_t frame = m_table[next];
+            if (frame == NO_FRAME) {
+                break;
+            }
+            size_t home = hash(m_frames[frame].tenant, m_frames[frame].pageId);
+            // Move the entry back if its home slot is not in (slot, next]
+            bool between = slot <= next ? (slot < home && home <= next) : (slot < home || home <= next);
+            if (!between) {
+                m_table[slot] = frame;
+                slot = next;
+            }
+        }
+        m_table[slot] = NO_FRAME;
+    }
+
+    void pushFront(uint32_t frame) {
+        m_frames[frame].prev = NO_FRAME;
+        m_frames[frame].next = m_head;
+        if (m_head != NO_FRAME) {
+            m_frames[m_head].prev = frame;
+        }
+        m_head = frame;
+    }
+
+    void unlink(uint32_t frame) {
+        Frame &meta = m_frames[frame];
+        if (meta.prev != NO_FRAME) {
+            m_frames[meta.prev].next = meta.next;
+        } else {
+            m_head = meta.next;
+        }
+        if (meta.next != NO_FRAME) {
+            m_frames[meta.next].prev = meta.prev;
+        }
+        meta.prev = meta.next = NO_FRAME;
+    }
+
+    size_t m_capacity;
+    size_t m_frameSize;
+    size_t m_used = 0;
+    size_t m_reservedFrames = 0;
+    std::vector<Tenant> m_tenants;
+    char *m_data;
+    std::vector<Frame> m_frames;
+    // Per-frame state of the owning tenant's replacer
+    std::vector<ReplacementState> m_replacement;
+    std::vector<uint32_t> m_table;
+    size_t m_tableMask;
+    // Advanced by every hit and install
+    uint64_t m_tick = 0;
+    uint64_t m_victimSearches = 0;
+    uint32_t m_head = NO_FRAME;
+    uint32_t m_freeHead = NO_FRAME;
+    std::mutex m_mutex;
+    std::condition_variable m_writebacksDone;
+};
+
+/// @brief Fixed set of page-aligned frames that one or more tables ("tenants") cache their pages in.
+/// Each tenant may reserve a minimum number of frames that other tenants cannot evict, and may be capped
+/// at a maximum. Which of its pages a tenant gives up is decided by the tenant's replacement policy.
+/// The pool is partitioned into shards by a hash of (tenant, page id). Every shard has its own frames,
+/// page table, replacement state and mutex, so threads working on different pages rarely meet on a lock;
+/// in exchange, which tenant gives up a frame is decided per shard, and a tenant's minimum is split over
+/// the shards. Its maximum holds for the pool as a whole: a tenant at its maximum gives up one of its own
+/// pages, in another shard if it has none to give up in the one it needs a frame in.
+/// Frame and page operations do not lock: callers hold the shard's mutex (mutex() or frameMutex())
+/// around each use. Operations on a whole tenant lock every shard in turn themselves.
+class BufferPool {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1ull << 10;
+    static constexpr uint32_t NO_FRAME = PoolShard::NO_FRAME;
+    static constexpr size_t UNLIMITED = PoolShard::UNLIMITED;
+    static constexpr size_t MIN_TENANT_FRAMES = PoolShard::MIN_TENANT_FRAMES;
+    // Frames of a shard in a pool sized by shardsFor(), enough for the pins of several threads
+    static constexpr size_t MIN_SHARD_FRAMES = 4 * MIN_TENANT_FRAMES;
+    static constexpr size_t MAX_SHARDS = 64;
+
+    // `capacity` frames of `frameSize` bytes in `shards` shards; only tables with that page size can use the pool
+    explicit BufferPool(size_t capacity = DEFAULT_CAPACITY, size_t frameSize = Pager::PAGE_SIZE, size_t shards = 1)
+        : m_capacity(capacity), m_frameSize(frameSize) {
+        if (capacity >= NO_FRAME) {
+            throw std::invalid_argument("BufferPool capacity is too large");
+        }
+        if (shards == 0 || shards > std::max<size_t>(capacity, 1)) {
+            throw std::invalid_argument("BufferPool needs between one shard and one shard per frame");
+        }
+        if (capacity > 0) {
+            m_data = static_cast<char *>(::operator new(capacity * frameSize, std::align_val_t(frameSize)));
+        }
+        // Equal shards, the last one taking what is left over
+        m_shardCapacity = capacity / shards;
+        for (size_t shard = 0; shard < shards; ++shard) {
+            size_t first = shard * m_shardCapacity;
+            size_t frames = shard + 1 < shards ? m_shardCapacity : capacity - first;
+            m_shards.push_back(std::make_unique<PoolShard>(frames, frameSize, m_data + first * frameSize));
+        }
+    }
+
+    ~BufferPool() {
+        if (m_data != nullptr) {
+            ::operator delete(m_data, std::align_val_t(m_frameSize));
+        }
+    }
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    // Shards for a pool of `capacity` frames used by many threads: as many as keep MIN_SHARD_FRAMES each
+    static size_t shardsFor(size_t capacity) {
+        return std::clamp<size_t>(capacity / MIN_SHARD_FRAMES, 1, MAX_SHARDS);
+    }
+
+    size_t capacity() const {
+        return m_capacity;
+    }
+
+    size_t size() {
+        size_t used = 0;
+        for (auto &shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex());
+            used += shard->size();
+        }
+        return used;
+    }
+
+    size_t frameSize() const {
+        return m_frameSize;
+    }
+
+    size_t shards() const {
+        return m_shards.size();
+    }
+
+    // Mutex of the shard that holds (or would hold) the tenant's page
+    std::mutex &mutex(uint32_t tenant, size_t pageId) {
+        return shardFor(tenant, pageId).mutex();
+    }
+
+    // Mutex of the shard the frame belongs to
+    std::mutex &frameMutex(uint32_t frame) {
+        return shardOf(frame).mutex();
+    }
+
+    /// @brief Register a table whose dirty pages are written back through `pager`.
+    /// `minFrames` are kept for the tenant even under pressure from others; `maxFrames` caps it (UNLIMITED for none),
+    /// though never below MIN_TENANT_FRAMES.
+    uint32_t registerTenant(Pager *pager, size_t minFrames = 0, size_t maxFrames = UNLIMITED,
+                            ReplacementPolicy policy = ReplacementPolicy::LRU) {
+        if (pager->pageSize() != m_frameSize) {
+            throw std::invalid_argument("Table page size does not match the buffer pool frame size");
+        }
+        if (maxFrames != UNLIMITED && maxFrames < minFrames) {
+            throw std::invalid_argument("Tenant maximum is below its minimum");
+        }
+        std::vector<std::unique_lock<std::mutex>> locks;
+        for (auto &shard : m_shards) {
+            locks.emplace_back(shard->mutex());
+        }
+        for (size_t shard = 0; shard < m_shards.size(); ++shard) {
+            if (!m_shards[shard]->canReserve(shardMinimum(minFrames, shard))) {
+                throw std::invalid_argument("Buffer pool budget cannot cover the requested minimum");
+            }
+        }
+        uint32_t tenant = 0;
+        while (m_shards.front()->isActive(tenant)) {
+            tenant++;
+        }
+        if (tenant >= m_quotas.size()) {
+            m_quotas.resize(tenant + 1);
+        }
+        m_quotas[tenant] = std::make_unique<TenantQuota>();
+        // A tree operation's pins have to fit
+        m_quotas[tenant]->maxFrames = maxFrames == UNLIMITED ? UNLIMITED : std::max(maxFrames, MIN_TENANT_FRAMES);
+        for (size_t shard = 0; shard < m_shards.size(); ++shard) {
+            m_shards[shard]->registerTenant(tenant, pager, shardMinimum(minFrames, shard), m_quotas[tenant].get(), policy);
+        }
+        return tenant;
+    }
+
+    // Drop every frame of the tenant without writing it back; the caller flushes first
+    void unregisterTenant(uint32_t tenant) {
+        for (auto &shard : m_shards) {
+            std::unique_lock<std::mutex> lock(shard->mutex());
+            shard->unregisterTenant(tenant, lock);
+        }
+    }
+
+    // Drop the tenant's cached pages from `firstPageId` on without writing them back; none may be pinned
+    void dropPages(uint32_t tenant, size_t firstPageId) {
+        for (auto &shard : m_shards) {
+            std::unique_lock<std::mutex> lock(shard->mutex());
+            shard->dropPages(tenant, firstPageId, lock);
+        }
+    }
+
+    size_t tenantSize(uint32_t tenant) {
+        size_t frames = 0;
+        for (auto &shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex());
+            frames += shard->tenantSize(tenant);
+        }
+        return frames;
+    }
+
+    ReplacementPolicy policy(uint32_t tenant) {
+        std::lock_guard<std::mutex> lock(m_shards.front()->mutex());
+        return m_shards.front()->policy(tenant);
+    }
+
+    // The tenant's counters, summed over the shards
+    CacheStats stats(uint32_t tenant) {
+        CacheStats total;
+        for (const CacheStats &stats : shardStats(tenant)) {
+            total.hits += stats.hits;
+            total.misses += stats.misses;
+            total.evictions += stats.evictions;
+            total.writebacks += stats.writebacks;
+        }
+        return total;
+    }
+
+    // The tenant's counters in each shard, to tell whether some shards see more misses than others
+    std::vector<CacheStats> shardStats(uint32_t tenant) {
+        std::vector<CacheStats> stats;
+        for (auto &shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex());
+            stats.push_back(shard->stats(tenant));
+        }
+        return stats;
+    }
+
+    // Cached pages of the tenant that are modified and not written back yet
+    size_t dirtyPages(uint32_t tenant) {
+        size_t dirty = 0;
+        for (auto &shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex());
+            dirty += shard->dirtyPages(tenant);
+        }
+        return dirty;
+    }
+
+    // Frame holding the tenant's page, or NO_FRAME. Counts a hit or a miss for the tenant.
+    uint32_t lookup(uint32_t tenant, size_t pageId) {
+        size_t shard = shardIndex(tenant, pageId);
+        return globalFrame(shard, m_shards[shard]->lookup(tenant, pageId));
+    }
+
+    // Frame holding the tenant's page, or NO_FRAME; counts nothing
+    uint32_t find(uint32_t tenant, size_t pageId) const {
+        size_t shard = shardIndex(tenant, pageId);
+        return globalFrame(shard, m_shards[shard]->find(tenant, pageId));
+    }
+
+    // Frame of the page's shard the tenant may take over for the page, or NO_FRAME if none qualifies
+    uint32_t victim(uint32_t tenant, size_t pageId) {
+        size_t shard = shardIndex(tenant, pageId);
+        return globalFrame(shard, m_shards[shard]->victim(tenant));
+    }
+
+    /// @brief A frame of the page's shard ready for install() of the page, with the shard locked through
+    /// `lock`: a free one, or a victim after writing it back. Clean victims match the disk already and are
+    /// dropped for free; dirty ones are written back with the shard unlocked, so NO_FRAME means that
+    /// another thread installed the page meanwhile and it is to be looked up again.
+    uint32_t acquireFrame(uint32_t tenant, size_t pageId, std::unique_lock<std::mutex> &lock) {
+        size_t shard = shardIndex(tenant, pageId);
+        PoolShard &home = *m_shards[shard];
+        while (true) {
+            uint32_t frame = home.acquireFrame(tenant, pageId, lock);
+            if (frame != NO_FRAME || home.contains(tenant, pageId)) {
+                return globalFrame(shard, frame);
+            }
+            // At its maximum with nothing to give up here; other shards are locked one at a time, never
+            // together with this one
+            lock.unlock();
+            bool shrunk = shrink(tenant, shard);
+            lock.lock();
+            if (!shrunk) {
+                throw std::runtime_error("Buffer pool exhausted: every evictable frame is pinned");
+            }
+            if (home.contains(tenant, pageId)) {
+                return NO_FRAME;
+            }
+        }
+    }
+
+    // Map the tenant's page to a frame obtained from acquireFrame(); the frame starts clean and unpinned
+    void install(uint32_t frame, uint32_t tenant, size_t pageId) {
+        shardOf(frame).install(localFrame(frame), tenant, pageId);
+    }
+
+    // Drop the page held by frame; the frame can be installed again right away
+    void evict(uint32_t frame) {
+        shardOf(frame).evict(localFrame(frame));
+    }
+
+    // Return a frame that holds no page to its shard's free list
+    void release(uint32_t frame) {
+        shardOf(frame).release(localFrame(frame));
+    }
+
+    char *data(uint32_t frame) const {
+        return m_data + static_cast<size_t>(frame) * m_frameSize;
+    }
+
+    size_t pageId(uint32_t frame) const {
+        return shardOf(frame).pageId(localFrame(frame));
+    }
+
+    uint32_t tenant(uint32_t frame) const {
+        return shardOf(frame).tenant(localFrame(frame));
+    }
+
+    void pin(uint32_t frame) {
+        shardOf(frame).pin(localFrame(frame));
+    }
+
+    void unpin(uint32_t frame) {
+        shardOf(frame).unpin(localFrame(frame));
+    }
+
+    bool isDirty(uint32_t frame) const {
+        return shardOf(frame).isDirty(localFrame(frame));
+    }
+
+    void markDirty(uint32_t frame) {
+        shardOf(frame).markDirty(localFrame(frame));
+    }
+
+    void markClean(uint32_t frame) {
+        shardOf(frame).markClean(localFrame(frame));
+    }
+
+    // Apply fn(frame) to every frame holding a page of the tenant, with the frame's shard locked;
+    // fn must not reorder the pool
+    template<typename Func>
+    void forEachFrame(uint32_t tenant, Func &&fn) {
+        for (size_t shard = 0; shard < m_shards.size(); ++shard) {
+            std::lock_guard<std::mutex> lock(m_shards[shard]->mutex());
+            m_shards[shard]->forEachFrame(tenant, [&](uint32_t frame) { fn(globalFrame(shard, frame)); });
+        }
+    }
+
+private:
+    // The tenant's minimum split exactly over the shards, the first ones taking the remainder
+    size_t shardMinimum(size_t minFrames, size_t shard) const {
+        return minFrames / m_shards.size() + (shard < minFrames % m_shards.size() ? 1 : 0);
+    }
+
+    // Give up one of the tenant's unpinned pages in a shard other than `except`, starting with the next one
+    bool shrink(uint32_t tenant, size_t except) {
+        for (size_t i = 1; i < m_shards.size(); ++i) {
+            PoolShard &shard = *m_shards[(except + i) % m_shards.size()];
+            std::unique_lock<std::mutex> lock(shard.mutex());
+            if (shard.shrink(tenant, lock)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The high bits of the hash, as the shards' page tables index by the low ones
+    size_t shardIndex(uint32_t tenant, size_t pageId) const {
+        return static_cast<size_t>(((pageId ^ (static_cast<size_t>(tenant) << 48)) * 0x9E3779B97F4A7C15ull) >> 40) % m_shards.size();
+    }
+
+    PoolShard &shardFor(uint32_t tenant, size_t pageId) {
+        return *m_shards[shardIndex(tenant, pageId)];
+    }
+
+    size_t shardNumber(uint32_t frame) const {
+        return std::min<size_t>(frame / m_shardCapacity, m_shards.size() - 1);
+    }
+
+    PoolShard &shardOf(uint32_t frame) const {
+        return *m_shards[shardNumber(frame)];
+    }
+
+    uint32_t localFrame(uint32_t frame) const {
+        return static_cast<uint32_t>(frame - shardNumber(frame) * m_shardCapacity);
+    }
+
+    uint32_t globalFrame(size_t shard, uint32_t frame) const {
+        return frame == NO_FRAME ? NO_FRAME : static_cast<uint32_t>(shard * m_shardCapacity + frame);
+    }
+
+    size_t m_capacity;
+    size_t m_frameSize;
+    char *m_data = nullptr;
+    // Frames of every shard but the last, which may have more
+    size_t m_shardCapacity = 0;
+    std::vector<std::unique_ptr<PoolShard>> m_shards;
+    // Indexed by tenant, replaced when the id is registered again
+    std::vector<std::unique_ptr<TenantQuota>> m_quotas;
+};
+
+}
+
+#endif
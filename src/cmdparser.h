@@ -1,8 +1,12 @@
 #pragma once
 
+#include "bplus_tree.h"
 #include <string>
 #include <variant>
+#include <vector>
+#include <limits>
 #include <sstream>
+#include <cctype>
 
 namespace bplus_sql {
 
@@ -14,10 +18,17 @@ public:
 		INSERT,
 		ERASE,
 		QUERY,
-		DESTROY
+		DESTROY,
+		SYNC,
+		STATS,
+		RANGE,
+		SHRINK,
+		LOAD,
+		KEYS
 	};
 	struct CreateCommand {
 		std::string tableName;
+		TreeOptions options;
 	};
 	struct InsertCommand {
 		std::string tableName;
@@ -34,9 +45,35 @@ public:
 	struct DestroyCommand {
 		std::string tableName;
 	};
+	struct SyncCommand {
+		std::string tableName;
+	};
+	struct StatsCommand {
+		std::string tableName;
+	};
+	// QUERY FROM <table> RANGE <low> <high>, both ends included
+	struct RangeCommand {
+		std::string tableName;
+		int low;
+		int high;
+	};
+	struct ShrinkCommand {
+		std::string tableName;
+	};
+	// LOAD INTO <table> FROM '<file of sorted keys>' [FILL <fraction>]
+	struct LoadCommand {
+		std::string tableName;
+		std::string fileName;
+		double fillFactor = 1.0;
+	};
+	// QUERY FROM <table> KEYS <k1>,<k2>,...
+	struct KeysCommand {
+		std::string tableName;
+		std::vector<int> keys;
+	};
 	struct Command {
 		Operation op;
-		std::variant<CreateCommand, InsertCommand, EraseCommand, QueryCommand, DestroyCommand> cmd;
+		std::variant<CreateCommand, InsertCommand, EraseCommand, QueryCommand, DestroyCommand, SyncCommand, StatsCommand, RangeCommand, ShrinkCommand, LoadCommand, KeysCommand> cmd;
 	};
 	CmdParser() = delete;
 	// we assert that the line is valid
@@ -50,12 +87,62 @@ public:
 		if(!(ss >> line)) return Command{INVALID, {}};
 		if(tolower(line) == "create") {
 			result.op = CREATE;
+			CreateCommand cmd;
 			while(ss >> line) {
 				if(tolower(line) == "table") {
 					ss >> line;
-					result.cmd = CreateCommand{line};
+					cmd.tableName = line;
+				} else if(tolower(line) == "durability") {
+					// DURABILITY NONE | ON_SYNC | EVERY <n> | EVERY_OP
+					ss >> line;
+					if(tolower(line) == "none") {
+						cmd.options.durability = Durability::NONE;
+					} else if(tolower(line) == "every_op") {
+						cmd.options.durability = Durability::EVERY_OP;
+					} else if(tolower(line) == "every") {
+						cmd.options.durability = Durability::EVERY_N_OPS;
+						ss >> cmd.options.syncInterval;
+					} else {
+						cmd.options.durability = Durability::ON_SYNC;
+					}
+				} else if(tolower(line) == "min_cache") {
+					ss >> line;
+					cmd.options.minCacheBytes = parseBytes(line);
+				} else if(tolower(line) == "max_cache") {
+					ss >> line;
+					cmd.options.maxCacheBytes = parseBytes(line);
+				} else if(tolower(line) == "page_size") {
+					ss >> line;
+					cmd.options.pageSize = parseBytes(line);
+				} else if(tolower(line) == "policy") {
+					// POLICY LRU | CLOCK | 2Q | LRU2
+					ss >> line;
+					if(tolower(line) == "clock") {
+						cmd.options.replacement = ReplacementPolicy::CLOCK;
+					} else if(tolower(line) == "2q") {
+						cmd.options.replacement = ReplacementPolicy::TWO_QUEUE;
+					} else if(tolower(line) == "lru2" || tolower(line) == "lru-2") {
+						cmd.options.replacement = ReplacementPolicy::LRU_2;
+					} else {
+						cmd.options.replacement = ReplacementPolicy::LRU;
+					}
+				} else if(tolower(line) == "split") {
+					// SPLIT HALVES | BSTAR
+					ss >> line;
+					if(tolower(line) == "bstar" || tolower(line) == "b*") {
+						cmd.options.split = SplitPolicy::B_STAR;
+					} else {
+						cmd.options.split = SplitPolicy::HALVES;
+					}
+				} else if(tolower(line) == "wal") {
+					cmd.options.writeAheadLog = true;
+				} else if(tolower(line) == "checkpoint_seconds") {
+					ss >> cmd.options.checkpointSeconds;
+				} else if(tolower(line) == "checkpoint_pages") {
+					ss >> cmd.options.checkpointPages;
 				}
 			}
+			result.cmd = cmd;
 		} else if(tolower(line) == "insert") {
 			result.op = INSERT;
 			InsertCommand cmd;
@@ -83,15 +170,40 @@ public:
 		} else if(tolower(line) == "query") {
 			result.op = QUERY;
 			QueryCommand cmd;
+			RangeCommand range;
+			KeysCommand keys;
 			while(ss >> line) {
 				if(tolower(line) == "from") {
 					ss >> line;
 					cmd.tableName = line;
 				} else if(tolower(line) == "key") {
 					ss >> cmd.key;
+				} else if(tolower(line) == "range") {
+					result.op = RANGE;
+					ss >> range.low >> range.high;
+				} else if(tolower(line) == "keys") {
+					// The rest of the line is the list; spaces after the commas are allowed
+					result.op = KEYS;
+					std::getline(ss, line);
+					for(char &c : line) {
+						if(c == ',') c = ' ';
+					}
+					std::stringstream list(line);
+					int key;
+					while(list >> key) {
+						keys.keys.push_back(key);
+					}
 				}
 			}
-			result.cmd = cmd;
+			if(result.op == RANGE) {
+				range.tableName = cmd.tableName;
+				result.cmd = range;
+			} else if(result.op == KEYS) {
+				keys.tableName = cmd.tableName;
+				result.cmd = keys;
+			} else {
+				result.cmd = cmd;
+			}
 		} else if(tolower(line) == "destroy") {
 			result.op = DESTROY;
 			DestroyCommand cmd;
@@ -102,11 +214,83 @@ public:
 				}
 			}
 			result.cmd = cmd;
+		} else if(tolower(line) == "sync") {
+			result.op = SYNC;
+			SyncCommand cmd;
+			while(ss >> line) {
+				if(tolower(line) == "table") {
+					ss >> line;
+					cmd.tableName = line;
+				}
+			}
+			result.cmd = cmd;
+		} else if(tolower(line) == "stats") {
+			result.op = STATS;
+			StatsCommand cmd;
+			while(ss >> line) {
+				if(tolower(line) == "table") {
+					ss >> line;
+					cmd.tableName = line;
+				}
+			}
+			result.cmd = cmd;
+		} else if(tolower(line) == "load") {
+			result.op = LOAD;
+			LoadCommand cmd;
+			while(ss >> line) {
+				if(tolower(line) == "into") {
+					ss >> line;
+					cmd.tableName = line;
+				} else if(tolower(line) == "from") {
+					ss >> line;
+					// The file name may be quoted
+					if(line.size() >= 2 && (line.front() == '\'' || line.front() == '"') && line.back() == line.front()) {
+						line = line.substr(1, line.size() - 2);
+					}
+					cmd.fileName = line;
+				} else if(tolower(line) == "fill") {
+					ss >> cmd.fillFactor;
+				}
+			}
+			result.cmd = cmd;
+		} else if(tolower(line) == "shrink") {
+			result.op = SHRINK;
+			ShrinkCommand cmd;
+			while(ss >> line) {
+				if(tolower(line) == "table") {
+					ss >> line;
+					cmd.tableName = line;
+				}
+			}
+			result.cmd = cmd;
 		} else {
 			result.op = INVALID;
 		}
 		return result;
 	}
+	// "4096", "64K", "16M", "2G" (binary units) -> bytes; 0 if the number is malformed or does not fit a size_t
+	static size_t parseBytes(const std::string &str) {
+		size_t pos = 0;
+		unsigned long long value = 0;
+		try {
+			value = std::stoull(str, &pos);
+		} catch(...) {
+			return 0;
+		}
+		unsigned long long multiplier = 1;
+		if(pos < str.size()) {
+			switch(std::tolower(str[pos])) {
+				case 'k': multiplier = 1ull << 10; break;
+				case 'm': multiplier = 1ull << 20; break;
+				case 'g': multiplier = 1ull << 30; break;
+				default: return 0;
+			}
+		}
+		if(value > std::numeric_limits<size_t>::max() / multiplier) {
+			return 0;
+		}
+		return static_cast<size_t>(value * multiplier);
+	}
 private:
 	static std::string tolower(std::string str) {
 		for(char &c : str) {
@@ -0,0 +1,240 @@
+#ifndef __IO_RING_H__
+#define __IO_RING_H__
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define BPLUS_SQL_HAS_URING 1
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace bplus_sql {
+
+/// @brief A small io_uring, driven through the system calls directly: reads and writes at file offsets
+/// are queued, handed to the kernel together and completed in any order, each reported with the tag it
+/// was queued with. Reads and writes inside the registered buffer skip mapping it on every request.
+/// Not thread-safe; needs Linux 5.6 or later.
+class IoRing {
+public:
+    // A ring with room for `entries` requests at once, or null where the kernel has no io_uring or refuses one
+    static std::unique_ptr<IoRing> create(unsigned entries) {
+        io_uring_params params{};
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return nullptr;
+        }
+        // One mapping for both rings (5.4) and IORING_OP_READ/WRITE (5.6)
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0 || (params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+            ::close(fd);
+            return nullptr;
+        }
+        std::unique_ptr<IoRing> ring(new IoRing(fd));
+        if (!ring->map(params)) {
+            return nullptr;
+        }
+        return ring;
+    }
+
+    ~IoRing() {
+        if (m_sqes != nullptr) {
+            ::munmap(m_sqes, m_sqesBytes);
+        }
+        if (m_rings != nullptr) {
+            ::munmap(m_rings, m_ringBytes);
+        }
+        ::close(m_fd);
+    }
+
+    IoRing(const IoRing &) = delete;
+    IoRing &operator=(const IoRing &) = delete;
+
+    /// @brief Register [base, base + size) as the ring's fixed buffer, replacing the one before.
+    /// Fails when the kernel will not pin that much memory (RLIMIT_MEMLOCK); requests then map their
+    /// buffers one by one.
+    bool registerBuffer(char *base, size_t size) {
+        if (m_fixedBase != nullptr) {
+            ::syscall(__NR_io_uring_register, m_fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+            m_fixedBase = nullptr;
+            m_fixedSize = 0;
+        }
+        iovec buffer{base, size};
+        if (::syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, &buffer, 1) != 0) {
+            return false;
+        }
+        m_fixedBase = base;
+        m_fixedSize = size;
+        return true;
+    }
+
+    // Requests that may be outstanding at once
+    size_t capacity() const {
+        return m_entries;
+    }
+
+    // Requests queued or in flight and not reaped yet
+    size_t outstanding() const {
+        return m_outstanding;
+    }
+
+    // Requests queued on the registered buffer so far
+    size_t fixedRequests() const {
+        return m_fixedRequests;
+    }
+
+    // Queue a read of `size` bytes at `offset` of `fd`; false when capacity() requests are outstanding
+    bool read(int fd, char *buffer, size_t size, uint64_t offset, uint64_t tag) {
+        bool fixed = isFixed(buffer, size);
+        if (!queue(fixed ? IORING_OP_READ_FIXED : IORING_OP_READ, fd, buffer, size, offset, tag)) {
+            return false;
+        }
+        m_fixedRequests += fixed;
+        return true;
+    }
+
+    bool write(int fd, const char *buffer, size_t size, uint64_t offset, uint64_t tag) {
+        bool fixed = isFixed(buffer, size);
+        if (!queue(fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, buffer, size, offset, tag)) {
+            return false;
+        }
+        m_fixedRequests += fixed;
+        return true;
+    }
+
+    /// @brief Submit what is queued and wait until at least `minimum` outstanding requests completed.
+    /// `complete(tag, result)` is called for every request reaped meanwhile, with the bytes it moved or -errno.
+    template<typename Complete>
+    void reap(size_t minimum, Complete &&complete) {
+        minimum = std::min(minimum, m_outstanding);
+        size_t reaped = popCompletions(complete);
+        while (m_unsubmitted > 0 || reaped < minimum) {
+            enter(reaped < minimum);
+            reaped += popCompletions(complete);
+        }
+    }
+
+private:
+    explicit IoRing(int fd) : m_fd(fd) {}
+
+    bool map(const io_uring_params &params) {
+        size_t sqBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        size_t cqBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        m_ringBytes = std::max(sqBytes, cqBytes);
+        void *rings = ::mmap(nullptr, m_ringBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        if (rings == MAP_FAILED) {
+            return false;
+        }
+        m_rings = static_cast<char *>(rings);
+        m_sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = ::mmap(nullptr, m_sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        m_sqes = static_cast<io_uring_sqe *>(sqes);
+        m_entries = params.sq_entries;
+        m_sqTail = reinterpret_cast<unsigned *>(m_rings + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned *>(m_rings + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned *>(m_rings + params.sq_off.array);
+        m_cqHead = reinterpret_cast<unsigned *>(m_rings + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned *>(m_rings + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned *>(m_rings + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe *>(m_rings + params.cq_off.cqes);
+        return true;
+    }
+
+    bool isFixed(const char *buffer, size_t size) const {
+        auto address = reinterpret_cast<uintptr_t>(buffer);
+        auto base = reinterpret_cast<uintptr_t>(m_fixedBase);
+        return m_fixedBase != nullptr && address >= base && address + size <= base + m_fixedSize;
+    }
+
+    bool queue(uint8_t opcode, int fd, const char *buffer, size_t size, uint64_t offset, uint64_t tag) {
+        // The completion ring holds twice as many entries, so it cannot overflow
+        if (m_outstanding == m_entries) {
+            return false;
+        }
+        unsigned tail = std::atomic_ref<unsigned>(*m_sqTail).load(std::memory_order_relaxed);
+        unsigned index = tail & m_sqMask;
+        io_uring_sqe &sqe = m_sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<uint64_t>(buffer);
+        sqe.len = static_cast<uint32_t>(size);
+        sqe.off = offset;
+        sqe.user_data = tag;
+        // Fixed requests name buffer 0, the only one registered
+        sqe.buf_index = 0;
+        m_sqArray[index] = index;
+        // Publishes the entry to the kernel
+        std::atomic_ref<unsigned>(*m_sqTail).store(tail + 1, std::memory_order_release);
+        m_unsubmitted++;
+        m_outstanding++;
+        return true;
+    }
+
+    // Submit the queued requests, waiting for a completion if `wait`
+    void enter(bool wait) {
+        long submitted = ::syscall(__NR_io_uring_enter, m_fd, m_unsubmitted, wait ? 1u : 0u,
+                                   wait ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+        if (submitted < 0) {
+            // Interrupted, or out of resources until completions are reaped: the caller comes back
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                return;
+            }
+            throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+        }
+        m_unsubmitted -= static_cast<unsigned>(submitted);
+    }
+
+    template<typename Complete>
+    size_t popCompletions(Complete &complete) {
+        unsigned head = std::atomic_ref<unsigned>(*m_cqHead).load(std::memory_order_relaxed);
+        unsigned tail = std::atomic_ref<unsigned>(*m_cqTail).load(std::memory_order_acquire);
+        size_t reaped = 0;
+        for (; head != tail; ++head, ++reaped) {
+            const io_uring_cqe &cqe = m_cqes[head & m_cqMask];
+            uint64_t tag = cqe.user_data;
+            int result = cqe.res;
+            // Hands the entry back to the kernel before the callback may queue more
+            std::atomic_ref<unsigned>(*m_cqHead).store(head + 1, std::memory_order_release);
+            m_outstanding--;
+            complete(tag, result);
+        }
+        return reaped;
+    }
+
+    int m_fd;
+    char *m_rings = nullptr;
+    size_t m_ringBytes = 0;
+    io_uring_sqe *m_sqes = nullptr;
+    size_t m_sqesBytes = 0;
+    unsigned m_entries = 0;
+    unsigned *m_sqTail = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned *m_sqArray = nullptr;
+    unsigned *m_cqHead = nullptr;
+    unsigned *m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    io_uring_cqe *m_cqes = nullptr;
+    char *m_fixedBase = nullptr;
+    size_t m_fixedSize = 0;
+    unsigned m_unsubmitted = 0;
+    size_t m_outstanding = 0;
+    size_t m_fixedRequests = 0;
+};
+
+}
+
+#endif
+
+#endif
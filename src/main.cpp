@@ -4,8 +4,12 @@
 #include <cctype>
 #include <unordered_map>
 #include <memory>
+#include <vector>
+#include <span>
 #include <filesystem>
 #include <fstream>
+#include <cstdlib>
+#include <stdexcept>
 
 std::string tolower(std::string str) {
 	for(char &c : str) {
@@ -16,15 +20,35 @@ std::string tolower(std::string str) {
 
 char buffer[1 << 24];
 
+// Page cache shared by all tables unless --buffer-pool or BPLUS_SQL_BUFFER_POOL says otherwise
+constexpr size_t DEFAULT_BUFFER_POOL_BYTES = 64ull << 20;
+
 int main(int argc, char* argv[]) {
     // speed_up IO
     std::ios_base::sync_with_stdio(false);
 	// It is not important whether std::cin tie with std::cout, because database is INTERACTIVE, 
 	// and when we query, we should always flush
 
+	size_t bufferPoolBytes = DEFAULT_BUFFER_POOL_BYTES;
+	if(const char *poolEnv = std::getenv("BPLUS_SQL_BUFFER_POOL"); poolEnv != nullptr) {
+		bufferPoolBytes = bplus_sql::CmdParser::parseBytes(poolEnv);
+	}
+	std::string fileName;
+	for(int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if(arg.starts_with("--buffer-pool=")) {
+			bufferPoolBytes = bplus_sql::CmdParser::parseBytes(arg.substr(arg.find('=') + 1));
+		} else {
+			fileName = arg;
+		}
+	}
+	if(bufferPoolBytes == 0) {
+		std::cout << "Invalid buffer pool size" << std::endl;
+		return -1;
+	}
+
 	std::ifstream inFile;
-	if(argc > 1) {
-		std::string fileName = argv[1];
+	if(!fileName.empty()) {
 		inFile.open(fileName, std::ios_base::in);
 		if(!inFile.is_open()) {
 			std::cout << "File didn't open" << std::endl;
@@ -38,6 +62,28 @@ int main(int argc, char* argv[]) {
 	std::string command;
 	std::unordered_map<std::string, std::unique_ptr<bplus_sql::BPlusTree>> trees;
 	auto dst = std::filesystem::path(__FILE__).parent_path().parent_path() / "data";
+	// Tables a crash left with a write-ahead log are recovered side by side before any command runs
+	if(std::error_code ec; std::filesystem::is_directory(dst, ec)) {
+		std::vector<std::string> tables;
+		for(const auto &entry : std::filesystem::directory_iterator(dst, ec)) {
+			if(entry.path().extension() == ".bin") tables.push_back(entry.path().string());
+		}
+		try {
+			bplus_sql::BPlusTree::recover(tables);
+		} catch(const std::exception &e) {
+			std::cout << e.what() << std::endl;
+		}
+	}
+	bplus_sql::TreeOptions options;
+	options.bufferPool = bplus_sql::makeSharedBufferPool(bufferPoolBytes);
+	// BPLUS_SQL_MMAP=1 opens every table through the memory-mapped pager
+	if(const char *mmapEnv = std::getenv("BPLUS_SQL_MMAP"); mmapEnv != nullptr && std::string(mmapEnv) == "1") {
+		options.useMmap = true;
+	}
+	// BPLUS_SQL_URING=1 moves their pages through io_uring instead (Linux only)
+	if(const char *uringEnv = std::getenv("BPLUS_SQL_URING"); uringEnv != nullptr && std::string(uringEnv) == "1") {
+		options.asyncIo = true;
+	}
 	while(std::getline(std::cin, command)) {
 		if(command.empty()) continue;
 		if(tolower(command) == "exit") return 0;
@@ -48,16 +94,24 @@ int main(int argc, char* argv[]) {
 				break;
 			}
 			case bplus_sql::CmdParser::CREATE: {
-				std::string name = std::get<bplus_sql::CmdParser::CreateCommand>(parse_result.cmd).tableName;
+				auto create = std::get<bplus_sql::CmdParser::CreateCommand>(parse_result.cmd);
+				std::string name = create.tableName;
+				create.options.useMmap = options.useMmap;
+				create.options.asyncIo = options.asyncIo;
+				create.options.bufferPool = options.bufferPool;
 				if(!trees.contains(name)) {
-					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string()));
+					try {
+						trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string(), create.options));
+					} catch(const std::invalid_argument &e) {
+						std::cout << e.what() << std::endl;
+					}
 				}
 				break;
 			}
 			case bplus_sql::CmdParser::INSERT: {
 				auto [name, key] = std::get<bplus_sql::CmdParser::InsertCommand>(parse_result.cmd);
 				if(!trees.contains(name)) {
-					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string()));
+					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string(), options));
 				}
 				trees[name]->insert(key);
 				break;
@@ -65,7 +119,7 @@ int main(int argc, char* argv[]) {
 			case bplus_sql::CmdParser::ERASE: {
 				auto [name, key] = std::get<bplus_sql::CmdParser::EraseCommand>(parse_result.cmd);
 				if(!trees.contains(name)) {
-					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string()));
+					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string(), options));
 				}
 				trees[name]->erase(key);
 				break;
@@ -73,19 +127,92 @@ int main(int argc, char* argv[]) {
 			case bplus_sql::CmdParser::QUERY: {
 				auto [name, key] = std::get<bplus_sql::CmdParser::QueryCommand>(parse_result.cmd);
 				if(!trees.contains(name)) {
-					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string()));
+					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string(), options));
 				}
 				std::cout << trees[name]->search(key) << std::endl;
 				break;
 			}
+			case bplus_sql::CmdParser::RANGE: {
+				auto [name, low, high] = std::get<bplus_sql::CmdParser::RangeCommand>(parse_result.cmd);
+				if(!trees.contains(name)) {
+					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string(), options));
+				}
+				// All keys of the range on one line, an empty line if there are none
+				bool first = true;
+				trees[name]->scan(low, high, [&](int key) {
+					std::cout << (first ? "" : " ") << key;
+					first = false;
+					return true;
+				});
+				std::cout << std::endl;
+				break;
+			}
+			case bplus_sql::CmdParser::KEYS: {
+				auto [name, keys] = std::get<bplus_sql::CmdParser::KeysCommand>(parse_result.cmd);
+				if(!trees.contains(name)) {
+					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string(), options));
+				}
+				// One line per key as QUERY ... KEY prints it, flushed once for the whole list
+				auto found = std::make_unique<bool[]>(keys.size());
+				trees[name]->searchMany(keys, std::span<bool>(found.get(), keys.size()));
+				for(size_t i = 0; i < keys.size(); ++i) {
+					std::cout << found[i] << '\n';
+				}
+				std::cout << std::flush;
+				break;
+			}
 			case bplus_sql::CmdParser::DESTROY: {
 				std::string name = std::get<bplus_sql::CmdParser::DestroyCommand>(parse_result.cmd).tableName;
 				if(!trees.contains(name)) {
-					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string()));
+					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string(), options));
 				}
 				trees.erase(name);
 				std::error_code ec;
 				std::filesystem::remove((dst / (name + ".bin")), ec);
+				std::filesystem::remove((dst / (name + ".bin.wal")), ec);
+				break;
+			}
+			case bplus_sql::CmdParser::SYNC: {
+				std::string name = std::get<bplus_sql::CmdParser::SyncCommand>(parse_result.cmd).tableName;
+				if(!trees.contains(name)) {
+					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string(), options));
+				}
+				trees[name]->sync();
+				break;
+			}
+			case bplus_sql::CmdParser::SHRINK: {
+				std::string name = std::get<bplus_sql::CmdParser::ShrinkCommand>(parse_result.cmd).tableName;
+				if(!trees.contains(name)) {
+					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string(), options));
+				}
+				trees[name]->shrink();
+				break;
+			}
+			case bplus_sql::CmdParser::LOAD: {
+				auto [name, keyFile, fillFactor] = std::get<bplus_sql::CmdParser::LoadCommand>(parse_result.cmd);
+				if(!trees.contains(name)) {
+					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string(), options));
+				}
+				std::ifstream keys(keyFile);
+				if(!keys.is_open()) {
+					std::cout << "File didn't open" << std::endl;
+					break;
+				}
+				try {
+					trees[name]->bulkLoad([&](int &key) { return static_cast<bool>(keys >> key); }, fillFactor);
+				} catch(const std::logic_error &e) {
+					std::cout << e.what() << std::endl;
+				}
+				break;
+			}
+			case bplus_sql::CmdParser::STATS: {
+				std::string name = std::get<bplus_sql::CmdParser::StatsCommand>(parse_result.cmd).tableName;
+				if(!trees.contains(name)) {
+					trees.emplace(name, std::make_unique<bplus_sql::BPlusTree>((dst / (name + ".bin")).string(), options));
+				}
+				auto stats = trees[name]->cacheStats();
+				std::cout << "hits " << stats.hits << " misses " << stats.misses
+					<< " evictions " << stats.evictions << " writebacks " << stats.writebacks << std::endl;
 				break;
 			}
 		}
@@ -2,95 +2,672 @@
 #define __NODE_MANAGER_H__
 
 #include "bplus_node.h"
-#include "lru.h"
+#include "buffer_pool.h"
+#include "page_latches.h"
 #include "pager.h"
 #include <string>
 #include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace bplus_sql {
 
+/// @brief Hands out pinned, latched nodes of one table; safe to use from several threads.
+/// A guard holds its page's latch until it is released, shared for reading or exclusive for writing.
+/// Exclusive latches are reentrant: asking again for a page the thread already latched exclusively
+/// returns a guard that borrows that latch. Readers may also skip the latch and check afterwards that
+/// the page did not change under them, see Latch::OPTIMISTIC.
 class NodeManager {
 public:
-    NodeManager(const std::string &fileName) : m_lru(), m_pager(fileName) {}
+    class WriteGuard;
+
+    /// @brief How a guard latches its page against other threads.
+    /// NONE is for callers that keep every other thread out of the table by other means.
+    /// OPTIMISTIC latches nothing and neither waits for writers nor holds them up, but for a writer
+    /// changing the page right then; what is read only counts once ReadGuard::validate() says that no
+    /// writer got in since. Pages the thread latched exclusively cannot be read this way.
+    enum class Latch {
+        NONE,
+        SHARED,
+        EXCLUSIVE,
+        OPTIMISTIC
+    };
+
+private:
+    // A frame (NO_FRAME when mapped), whether the guard holds a pin on it, and the page's latch in `mode`:
+    // null when the page is not latched or its latch is borrowed. OPTIMISTIC pins keep the latch's
+    // version as it was when the page was pinned.
+    struct Pin {
+        uint32_t frame = BufferPool::NO_FRAME;
+        bool pinned = true;
+        PageLatch *latch = nullptr;
+        Latch mode = Latch::NONE;
+        uint64_t version = 0;
+    };
+
+public:
+    /// @brief Cache pages of `fileName` in `pool`, shared with other tables, or in a private pool if null.
+    /// `minFrames`/`maxFrames` bound this table's share of a shared pool, `policy` picks which of its pages to evict.
+    /// A pool whose frames do not match `pageSize` cannot hold this table's pages; the table then gets a
+    /// private pool of `maxFrames` (or the default budget) instead.
+    NodeManager(const std::string &fileName, Pager::Backend backend = Pager::Backend::STREAM, size_t pageSize = Pager::PAGE_SIZE,
+                std::shared_ptr<BufferPool> pool = nullptr, size_t minFrames = 0, size_t maxFrames = BufferPool::UNLIMITED,
+                ReplacementPolicy policy = ReplacementPolicy::LRU)
+        : m_pager(fileName, backend, pageSize), m_pool(std::move(pool)) {
+        // The mapping already is the cache, so a mapped table needs no frames
+        if(m_pager.isMapped()) {
+            return;
+        }
+        if(m_pool == nullptr || m_pool->frameSize() != pageSize) {
+            // The default budget is DEFAULT_CAPACITY default-sized pages, whatever the page size
+            size_t frames = maxFrames != BufferPool::UNLIMITED ? maxFrames
+                                                               : BufferPool::DEFAULT_CAPACITY * Pager::PAGE_SIZE / pageSize;
+            frames = std::max({frames, minFrames, 4 * BufferPool::MIN_TENANT_FRAMES});
+            m_pool = std::make_shared<BufferPool>(frames, pageSize, BufferPool::shardsFor(frames));
+            // Registering pins the frames once per ring, so only a pool of the table's own is registered:
+            // every table of a shared pool would pin all of it again. Without it pages still move, unregistered.
+            m_pager.registerBuffers(m_pool->data(0), m_pool->capacity() * m_pool->frameSize());
+        }
+        m_tenant = m_pool->registerTenant(&m_pager, minFrames, maxFrames, policy);
+    }
     ~NodeManager() {
-        // Write all nodes in m_lru back to m_pager
-        m_lru.traverse([&](size_t pageId, std::shared_ptr<BPlusNode> node) {
-            m_pager.writePage(pageId, *node);
-        });
+        if(m_pool != nullptr && !m_pager.isMapped()) {
+            // Write all modified nodes of this table back to m_pager, then hand the frames back
+            flushDirtyPages();
+            m_pool->unregisterTenant(m_tenant);
+        }
     }
     NodeManager(const NodeManager &) = delete;
     NodeManager &operator=(const NodeManager &) = delete;
-    
-    // Return a copy of the node - caller doesn't need to manage memory
-    BPlusNode getNode(size_t pageId) {
-        if(m_lru.contains(pageId)) {
-            // Return a copy of the cached node
-            auto cachedNode = m_lru.get(pageId);
-            return *cachedNode;
-        } else {
-            BPlusNode result;
-            m_pager.readPage(pageId, result);
-            
-            // Evict LRU node if at capacity
-            evictIfNeeded();
-            
-            // Store a copy in cache
-            m_lru.put(pageId, std::make_shared<BPlusNode>(result));
-            
-            return result;
-        }
-    }
-    
-    // Update the cache with the node value
-    void putNode(size_t pageId, const BPlusNode &node) {
-        // Update the cache with a copy of the node
-        auto cachedCopy = std::make_shared<BPlusNode>(node);
-        
-        if(m_lru.contains(pageId)) {
-            m_lru.put(pageId, cachedCopy);
-        } else {
-            // Evict LRU node if at capacity
-            evictIfNeeded();
-            m_lru.put(pageId, cachedCopy);
+
+    /// @brief Pins a cached page for reading; the node is accessed in place.
+    class ReadGuard {
+    public:
+        ReadGuard(ReadGuard &&other) noexcept
+            : m_manager(std::exchange(other.m_manager, nullptr)), m_pin(other.m_pin), m_pageId(other.m_pageId), m_node(other.m_node) {}
+        ReadGuard &operator=(ReadGuard &&other) noexcept {
+            if(this != &other) {
+                release();
+                m_manager = std::exchange(other.m_manager, nullptr);
+                m_pin = other.m_pin;
+                m_pageId = other.m_pageId;
+                m_node = other.m_node;
+            }
+            return *this;
+        }
+        ~ReadGuard() {
+            release();
+        }
+
+        size_t pageId() const {
+            return m_pageId;
+        }
+        const BPlusNode *operator->() const {
+            return m_node;
+        }
+        const BPlusNode &operator*() const {
+            return *m_node;
+        }
+
+        /// @brief Keep the pin and gain write access; the page becomes dirty.
+        /// Not an atomic upgrade: a shared latch is released and the page latched exclusively again, so
+        /// other writers may change or split the page in between. Whatever was read under the shared latch
+        /// has to be checked again on the returned guard. Exclusive guards keep their latch, and guards
+        /// that latch nothing, OPTIMISTIC ones included, stay unlatched.
+        WriteGuard relatchExclusive() &&;
+
+        // A guard on the same page that takes neither pin nor latch again; it must not outlive this one
+        ReadGuard borrow() const {
+            return ReadGuard(m_manager, Pin{m_pin.frame, false}, m_pageId, m_node);
         }
+
+        // Whether no writer changed the page since it was pinned OPTIMISTIC; latched pages always pass.
+        // Checked after reading, so that what was read is known to be one consistent state of the page.
+        bool validate() const {
+            if(m_pin.mode != Latch::OPTIMISTIC) {
+                return true;
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return m_pin.latch->version.load(std::memory_order_relaxed) == m_pin.version;
+        }
+
+    private:
+        friend class NodeManager;
+        ReadGuard(NodeManager *manager, Pin pin, size_t pageId, BPlusNode *node)
+            : m_manager(manager), m_pin(pin), m_pageId(pageId), m_node(node) {}
+        void release() {
+            if(m_manager != nullptr) {
+                m_manager->unpin(m_pin);
+                m_manager = nullptr;
+            }
+        }
+
+        NodeManager *m_manager;
+        Pin m_pin;
+        size_t m_pageId;
+        BPlusNode *m_node;
+    };
+
+    /// @brief Pins a cached page for writing; the page is marked dirty when the guard is taken.
+    class WriteGuard {
+    public:
+        WriteGuard(WriteGuard &&other) noexcept
+            : m_manager(std::exchange(other.m_manager, nullptr)), m_pin(other.m_pin), m_pageId(other.m_pageId), m_node(other.m_node) {}
+        WriteGuard &operator=(WriteGuard &&other) noexcept {
+            if(this != &other) {
+                release();
+                m_manager = std::exchange(other.m_manager, nullptr);
+                m_pin = other.m_pin;
+                m_pageId = other.m_pageId;
+                m_node = other.m_node;
+            }
+            return *this;
+        }
+        ~WriteGuard() {
+            release();
+        }
+
+        size_t pageId() const {
+            return m_pageId;
+        }
+        BPlusNode *operator->() const {
+            return m_node;
+        }
+        BPlusNode &operator*() const {
+            return *m_node;
+        }
+
+    private:
+        friend class NodeManager;
+        WriteGuard(NodeManager *manager, Pin pin, size_t pageId, BPlusNode *node)
+            : m_manager(manager), m_pin(pin), m_pageId(pageId), m_node(node) {}
+        void release() {
+            if(m_manager != nullptr) {
+                m_manager->unpin(m_pin);
+                m_manager = nullptr;
+            }
+        }
+
+        NodeManager *m_manager;
+        Pin m_pin;
+        size_t m_pageId;
+        BPlusNode *m_node;
+    };
+
+    ReadGuard readNode(size_t pageId, Latch latch = Latch::SHARED) {
+        Pin pin = pinPage(pageId, true, latch);
+        return ReadGuard(this, pin, pageId, nodeAt(pin.frame, pageId));
     }
-    
+
+    WriteGuard writeNode(size_t pageId, Latch latch = Latch::EXCLUSIVE) {
+        Pin pin = pinPage(pageId, true, latch);
+        beginWrite(pageId);
+        markDirty(pin.frame);
+        return WriteGuard(this, pin, pageId, nodeAt(pin.frame, pageId));
+    }
+
+    // Pin a freshly allocated page as a zeroed node, without reading it from disk
+    WriteGuard createNode(size_t pageId, Latch latch = Latch::EXCLUSIVE) {
+        Pin pin = pinPage(pageId, false, latch);
+        beginWrite(pageId);
+        BPlusNode *node = nodeAt(pin.frame, pageId);
+        std::memset(node, 0, m_pager.pageSize());
+        markDirty(pin.frame);
+        return WriteGuard(this, pin, pageId, node);
+    }
+
+    // Whether any thread, this one included, holds the page's latch right now
+    bool isLatched(size_t pageId) {
+        PageLatch &latch = m_latches.latch(pageId);
+        if(holdsExclusive(&latch) || !latch.mutex.try_lock()) {
+            return true;
+        }
+        latch.mutex.unlock();
+        return false;
+    }
+
+    /// @brief Bring the pages among `pageIds` that are not cached into the cache, reading them all at once:
+    /// with the URING backend their reads are in flight together. Nothing stays pinned; pages already
+    /// cached count as hits, the others as misses, and both again when they are pinned.
+    void loadPages(std::span<const size_t> pageIds) {
+        if(m_pager.isMapped()) {
+            return;
+        }
+        // Each page is pinned and latched exclusively until it arrives, like a miss in pinPage()
+        std::vector<Pin> pins;
+        std::vector<Pager::PageTransfer> transfers;
+        std::exception_ptr error;
+        for(size_t pageId : pageIds) {
+            std::unique_lock<std::mutex> lock(m_pool->mutex(m_tenant, pageId));
+            if(m_pool->lookup(m_tenant, pageId) != BufferPool::NO_FRAME) {
+                continue;
+            }
+            Pin pin;
+            try {
+                // NO_FRAME: another thread brought the page in while a victim was written back
+                do {
+                    pin.frame = m_pool->acquireFrame(m_tenant, pageId, lock);
+                } while(pin.frame == BufferPool::NO_FRAME && m_pool->lookup(m_tenant, pageId) == BufferPool::NO_FRAME);
+            } catch(...) {
+                // Out of frames: what was claimed so far is still read, the rest is left to pinPage()
+                error = std::current_exception();
+                break;
+            }
+            if(pin.frame == BufferPool::NO_FRAME) {
+                continue;
+            }
+            m_pool->install(pin.frame, m_tenant, pageId);
+            m_pool->pin(pin.frame);
+            pin.latch = &m_latches.latch(pageId);
+            pin.mode = Latch::EXCLUSIVE;
+            while(!takeLatch(pin, false)) {
+                std::this_thread::yield();
+            }
+            markWriting(&exclusiveLatches().back());
+            lock.unlock();
+            pins.push_back(pin);
+            transfers.push_back({pageId, m_pool->data(pin.frame)});
+        }
+        m_pager.readPages(transfers, [&](size_t i, bool ok) {
+            dropLatch(pins[i]);
+            std::lock_guard<std::mutex> lock(m_pool->frameMutex(pins[i].frame));
+            m_pool->unpin(pins[i].frame);
+            if(!ok) {
+                m_pool->evict(pins[i].frame);
+                m_pool->release(pins[i].frame);
+            }
+        });
+        if(error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Write every dirty cached page back to the pager in one batch, in file order; the pages stay cached.
+    // Pages being modified meanwhile may be written half done, so writers have to be kept out.
+    void flushDirtyPages() {
+        if(m_pager.isMapped()) {
+            return;
+        }
+        // Pinned until written, so that other tables cannot evict them in between
+        std::vector<std::pair<size_t, uint32_t>> dirty;
+        m_pool->forEachFrame(m_tenant, [&](uint32_t frame) {
+            if(m_pool->isDirty(frame)) {
+                m_pool->pin(frame);
+                dirty.emplace_back(m_pool->pageId(frame), frame);
+            }
+        });
+        std::sort(dirty.begin(), dirty.end());
+        std::vector<Pager::PageTransfer> transfers;
+        transfers.reserve(dirty.size());
+        for(auto [pageId, frame] : dirty) {
+            transfers.push_back({pageId, m_pool->data(frame)});
+        }
+        m_pager.writePages(transfers, [&](size_t i, bool ok) {
+            std::lock_guard<std::mutex> lock(m_pool->frameMutex(dirty[i].second));
+            if(ok) {
+                m_pool->markClean(dirty[i].second);
+            }
+            m_pool->unpin(dirty[i].second);
+        });
+    }
+
+    /// @brief Write the dirty cached pages back one at a time, each latched shared so that no writer is
+    /// halfway through it, while the other pages go on being modified. Pages modified after their write
+    /// are dirty again. The caller keeps out writers that do not latch pages.
+    void writeBackDirtyPages() {
+        if(m_pager.isMapped()) {
+            return;
+        }
+        std::vector<size_t> dirty;
+        m_pool->forEachFrame(m_tenant, [&](uint32_t frame) {
+            if(m_pool->isDirty(frame)) {
+                dirty.push_back(m_pool->pageId(frame));
+            }
+        });
+        std::sort(dirty.begin(), dirty.end());
+        for(size_t pageId : dirty) {
+            Pin pin;
+            {
+                std::lock_guard<std::mutex> lock(m_pool->mutex(m_tenant, pageId));
+                pin.frame = m_pool->find(m_tenant, pageId);
+                // Evicted, and written back with it, or written back by a flush meanwhile
+                if(pin.frame == BufferPool::NO_FRAME || !m_pool->isDirty(pin.frame)) {
+                    continue;
+                }
+                m_pool->pin(pin.frame);
+            }
+            pin.latch = &m_latches.latch(pageId);
+            pin.mode = Latch::SHARED;
+            takeLatch(pin, true);
+            try {
+                m_pager.writePageData(pageId, m_pool->data(pin.frame));
+            } catch(...) {
+                unpin(pin);
+                throw;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_pool->frameMutex(pin.frame));
+                m_pool->markClean(pin.frame);
+            }
+            unpin(pin);
+        }
+    }
+
+    // Force everything written to the pager so far onto the device
+    void syncData() {
+        m_pager.sync();
+    }
+
+    // Hand everything written to the pager so far to the OS
+    void flushData() {
+        m_pager.flush();
+    }
+
+    CacheStats cacheStats() const {
+        if(m_pager.isMapped()) {
+            return {};
+        }
+        return m_pool->stats(m_tenant);
+    }
+
+    // cacheStats() of each shard of the buffer pool
+    std::vector<CacheStats> cacheShardStats() const {
+        if(m_pager.isMapped()) {
+            return {};
+        }
+        return m_pool->shardStats(m_tenant);
+    }
+
     // Expose pager methods for metadata operations
     template<typename T>
     void writeMetadata(const T& metadata) {
         m_pager.writeMetadata(metadata);
     }
-    
+
     template<typename T>
     void readMetadata(T& metadata) {
         m_pager.readMetadata(metadata);
     }
-    
+
+    void writeMetadataBytes(size_t offset, const void *data, size_t size) {
+        m_pager.writeMetadataBytes(offset, data, size);
+    }
+
+    // Forget the pages from `pageCount` on, cached or not, and shrink the file to match
+    void truncate(size_t pageCount) {
+        if(!m_pager.isMapped()) {
+            m_pool->dropPages(m_tenant, pageCount);
+        }
+        m_pager.truncate(pageCount);
+    }
+
+    // See Pager::attachLog(); dirty pages evicted or flushed from now on go to `log`
+    void attachLog(WriteAheadLog *log) {
+        m_pager.attachLog(log);
+    }
+
+    void writeLoggedPages() {
+        m_pager.writeLoggedPages();
+    }
+
+    void restoreLoggedPage(size_t pageId, uint64_t position) {
+        m_pager.restoreLoggedPage(pageId, position);
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> loggedPages() const {
+        return m_pager.loggedPages();
+    }
+
+    // Cached pages modified since they were last written to the pager
+    size_t dirtyPages() const {
+        if(m_pager.isMapped()) {
+            return 0;
+        }
+        return m_pool->dirtyPages(m_tenant);
+    }
+
+    bool isMapped() const {
+        return m_pager.isMapped();
+    }
+
     bool fileExists() const {
         return m_pager.fileExists();
     }
-    
+
+    size_t pageSize() const {
+        return m_pager.pageSize();
+    }
+
     size_t getFileSize() {
         return m_pager.getFileSize();
     }
-    
+
 private:
-    void evictIfNeeded() {
-        // Check if we're at capacity and need to evict
-        if(m_lru.size() >= LRUCache::CAPACITY) {
-            // Get the tail node (least recently used) and write it back to pager
-            auto [tailPageId, tailNode] = m_lru.tail();
-            if(tailNode != nullptr) {
-                m_pager.writePage(tailPageId, *tailNode);
+    // An exclusive latch held by the calling thread, and whether its page is being written, which
+    // leaves the page's version odd until the latch is dropped
+    struct HeldLatch {
+        PageLatch *latch;
+        bool writing;
+    };
+
+    // Exclusive latches held by the calling thread, across all tables
+    static std::vector<HeldLatch> &exclusiveLatches() {
+        thread_local std::vector<HeldLatch> latches;
+        return latches;
+    }
+
+    static HeldLatch *findHeld(const PageLatch *latch) {
+        std::vector<HeldLatch> &latches = exclusiveLatches();
+        auto it = std::find_if(latches.rbegin(), latches.rend(), [&](const HeldLatch &held) { return held.latch == latch; });
+        return it != latches.rend() ? &*it : nullptr;
+    }
+
+    static bool holdsExclusive(const PageLatch *latch) {
+        return findHeld(latch) != nullptr;
+    }
+
+    // Take pin.latch in its mode; without `wait`, fails rather than wait for another thread
+    static bool takeLatch(Pin &pin, bool wait) {
+        if(pin.latch == nullptr || pin.mode == Latch::OPTIMISTIC) {
+            return true;
+        }
+        if(pin.mode == Latch::EXCLUSIVE) {
+            if(!wait && !pin.latch->mutex.try_lock()) {
+                return false;
+            }
+            if(wait) {
+                pin.latch->mutex.lock();
+            }
+            exclusiveLatches().push_back({pin.latch, false});
+            return true;
+        }
+        if(!wait) {
+            return pin.latch->mutex.try_lock_shared();
+        }
+        pin.latch->mutex.lock_shared();
+        return true;
+    }
+
+    static void dropLatch(const Pin &pin) {
+        if(pin.latch == nullptr || pin.mode == Latch::OPTIMISTIC) {
+            return;
+        }
+        if(pin.mode == Latch::EXCLUSIVE) {
+            std::vector<HeldLatch> &latches = exclusiveLatches();
+            auto held = std::find_if(latches.rbegin(), latches.rend(), [&](const HeldLatch &held) { return held.latch == pin.latch; });
+            finishWriting(*held);
+            latches.erase(held.base() - 1);
+            pin.latch->mutex.unlock();
+        } else {
+            pin.latch->mutex.unlock_shared();
+        }
+    }
+
+    // The page is about to change: optimistic readers of it have to read it again. Pages the thread
+    // did not latch exclusively are either not latched at all or not shared with other threads.
+    void beginWrite(size_t pageId) {
+        markWriting(findHeld(&m_latches.latch(pageId)));
+    }
+
+    static void markWriting(HeldLatch *held) {
+        if(held == nullptr || held->writing) {
+            return;
+        }
+        held->writing = true;
+        held->latch->version.store(held->latch->version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        // Keeps the odd version ahead of the changes that follow it
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    // Even again: the changes are done, and published along with the version
+    static void finishWriting(HeldLatch &held) {
+        if(held.writing) {
+            held.writing = false;
+            held.latch->version.store(held.latch->version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+    }
+
+    // An even version of the page, once no writer is changing it
+    static uint64_t stableVersion(const PageLatch &latch) {
+        uint64_t version = latch.version.load(std::memory_order_acquire);
+        while(version % 2 != 0) {
+            std::this_thread::yield();
+            version = latch.version.load(std::memory_order_acquire);
+        }
+        return version;
+    }
+
+    /// @brief Bring the page into a frame (reading it from disk if `load`), pin it and latch it as asked.
+    Pin pinPage(size_t pageId, bool load, Latch mode) {
+        Pin pin;
+        if(mode != Latch::NONE) {
+            PageLatch *latch = &m_latches.latch(pageId);
+            if(mode == Latch::OPTIMISTIC || !holdsExclusive(latch)) {
+                pin.latch = latch;
+                pin.mode = mode;
+            }
+        }
+        if(m_pager.isMapped()) {
+            takeLatch(pin, true);
+            if(pin.mode == Latch::OPTIMISTIC) {
+                pin.version = stableVersion(*pin.latch);
+            }
+            return pin;
+        }
+        std::unique_lock<std::mutex> lock(m_pool->mutex(m_tenant, pageId));
+        pin.frame = m_pool->lookup(m_tenant, pageId);
+        bool cached = pin.frame != BufferPool::NO_FRAME;
+        while(!cached) {
+            pin.frame = m_pool->acquireFrame(m_tenant, pageId, lock);
+            if(pin.frame != BufferPool::NO_FRAME) {
+                break;
+            }
+            // Another thread brought the page in while a victim was written back
+            pin.frame = m_pool->lookup(m_tenant, pageId);
+            cached = pin.frame != BufferPool::NO_FRAME;
+        }
+        if(cached) {
+            m_pool->pin(pin.frame);
+            lock.unlock();
+            takeLatch(pin, true);
+            if(pin.mode == Latch::OPTIMISTIC) {
+                pin.version = stableVersion(*pin.latch);
             }
+            return pin;
         }
+
+        // A loaded page matches the disk, so it starts clean
+        m_pool->install(pin.frame, m_tenant, pageId);
+        m_pool->pin(pin.frame);
+        // Latches are only held on pinned pages, so the latch of a page that was not cached is free, but
+        // for isLatched() trying it for an instant. Taking it exclusively before the pool is unlocked keeps
+        // other threads off until the page is read, and optimistic readers wait for its version to turn even.
+        Latch asked = pin.mode;
+        if(pin.latch != nullptr) {
+            pin.mode = Latch::EXCLUSIVE;
+            while(!takeLatch(pin, false)) {
+                std::this_thread::yield();
+            }
+            markWriting(&exclusiveLatches().back());
+        }
+        lock.unlock();
+        if(load) {
+            try {
+                m_pager.readPageData(pageId, m_pool->data(pin.frame));
+            } catch(...) {
+                dropLatch(pin);
+                lock.lock();
+                m_pool->unpin(pin.frame);
+                m_pool->evict(pin.frame);
+                m_pool->release(pin.frame);
+                throw;
+            }
+        }
+        if(pin.latch != nullptr) {
+            finishWriting(exclusiveLatches().back());
+        }
+        if(asked != pin.mode) {
+            dropLatch(pin);
+            pin.mode = asked;
+            takeLatch(pin, true);
+            if(pin.mode == Latch::OPTIMISTIC) {
+                pin.version = stableVersion(*pin.latch);
+            }
+        }
+        return pin;
+    }
+
+    BPlusNode *nodeAt(uint32_t frame, size_t pageId) {
+        if(m_pager.isMapped()) {
+            // The mapping already is the cache: hand out the page address itself
+            return reinterpret_cast<BPlusNode *>(m_pager.pageData(pageId));
+        }
+        return reinterpret_cast<BPlusNode *>(m_pool->data(frame));
     }
-    
-    LRUCache m_lru;
+
+    // Release the latch first: a page stays cached while it is latched
+    void unpin(const Pin &pin) {
+        dropLatch(pin);
+        if(pin.pinned && pin.frame != BufferPool::NO_FRAME) {
+            std::lock_guard<std::mutex> lock(m_pool->frameMutex(pin.frame));
+            m_pool->unpin(pin.frame);
+        }
+    }
+
+    void markDirty(uint32_t frame) {
+        if(frame != BufferPool::NO_FRAME) {
+            std::lock_guard<std::mutex> lock(m_pool->frameMutex(frame));
+            m_pool->markDirty(frame);
+        }
+    }
+
     Pager m_pager;
+    std::shared_ptr<BufferPool> m_pool;
+    uint32_t m_tenant = 0;
+    PageLatches m_latches;
 };
 
+inline NodeManager::WriteGuard NodeManager::ReadGuard::relatchExclusive() && {
+    if(m_pin.latch != nullptr && m_pin.mode == Latch::SHARED) {
+        dropLatch(m_pin);
+        m_pin.mode = Latch::EXCLUSIVE;
+        takeLatch(m_pin, true);
+    }
+    NodeManager *manager = std::exchange(m_manager, nullptr);
+    manager->beginWrite(m_pageId);
+    manager->markDirty(m_pin.frame);
+    return WriteGuard(manager, m_pin, m_pageId, m_node);
+}
+
 }
 
-#endif
\ No newline at end of file
+#endif
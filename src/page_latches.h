@@ -0,0 +1,68 @@
+#ifndef __PAGE_LATCHES_H__
+#define __PAGE_LATCHES_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <stdexcept>
+
+namespace bplus_sql {
+
+/// @brief A page's reader/writer latch, and a version that writers holding the latch bump around each
+/// change: odd while the page is being changed, even otherwise. Readers that do not latch the page
+/// compare the version before and after reading it.
+struct PageLatch {
+    std::shared_mutex mutex;
+    std::atomic<uint64_t> version = 0;
+};
+
+/// @brief One PageLatch per page of a table, created on first use and kept until the table closes.
+/// Latches come in chunks hanging off a directory that is sized once, so finding a page's latch takes
+/// no lock and a latch never moves while another thread waits on it.
+class PageLatches {
+public:
+    static constexpr size_t CHUNK_LATCHES = 1ull << 12;
+    // 64M pages, 256 GiB of 4K pages
+    static constexpr size_t MAX_CHUNKS = 1ull << 14;
+
+    PageLatches() : m_chunks(std::make_unique<std::atomic<Chunk *>[]>(MAX_CHUNKS)) {}
+    ~PageLatches() {
+        for (size_t i = 0; i < MAX_CHUNKS; ++i) {
+            delete m_chunks[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    PageLatches(const PageLatches &) = delete;
+    PageLatches &operator=(const PageLatches &) = delete;
+
+    PageLatch &latch(size_t pageId) {
+        size_t index = pageId / CHUNK_LATCHES;
+        if (index >= MAX_CHUNKS) {
+            throw std::runtime_error("Page id exceeds the latch table");
+        }
+        Chunk *chunk = m_chunks[index].load(std::memory_order_acquire);
+        if (chunk == nullptr) {
+            // Threads racing to create the chunk agree on the first one published
+            Chunk *created = new Chunk;
+            if (m_chunks[index].compare_exchange_strong(chunk, created, std::memory_order_acq_rel)) {
+                chunk = created;
+            } else {
+                delete created;
+            }
+        }
+        return chunk->latches[pageId % CHUNK_LATCHES];
+    }
+
+private:
+    struct Chunk {
+        PageLatch latches[CHUNK_LATCHES];
+    };
+
+    std::unique_ptr<std::atomic<Chunk *>[]> m_chunks;
+};
+
+}
+
+#endif
@@ -1,25 +1,87 @@
 #ifndef __PAGER_H__
 #define __PAGER_H__
 
-#include "bplus_node.h"
+#include "io_ring.h"
+#include "wal.h"
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <fstream>
 #include <cstring>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define BPLUS_SQL_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
 namespace bplus_sql {
 
+/// @brief Moves pages between the table file and memory.
+/// Safe to share between threads: stream I/O and the parked-page map are serialized by one mutex, and
+/// mapped page addresses are handed out without it once the file is large enough. URING reads single
+/// pages without the mutex, so misses of different threads overlap.
 class Pager {
 public:
-    explicit Pager(const std::string &fileName) : m_fileName(fileName) {
+    /// @brief How pages are moved between the file and memory.
+    /// STREAM goes through std::fstream; MMAP maps the file and hands out page addresses; URING reads and
+    /// writes through a file descriptor and hands batches of pages (readPages(), writePages()) to io_uring.
+    /// MMAP is only available on POSIX systems and URING on Linux; both silently fall back to STREAM
+    /// elsewhere, and URING also does where the kernel refuses to set up a ring.
+    enum class Backend {
+        STREAM,
+        MMAP,
+        URING
+    };
+
+    /// @brief A page to read into or write from `buffer`, which holds pageSize() bytes.
+    struct PageTransfer {
+        size_t pageId;
+        char *buffer;
+    };
+
+    // Default (and smallest) page size, and the largest one; page sizes are powers of two
+    static constexpr size_t PAGE_SIZE = 1ull << 12;
+    static constexpr size_t MAX_PAGE_SIZE = 1ull << 16;
+
+    explicit Pager(const std::string &fileName, Backend backend = Backend::STREAM, size_t pageSize = PAGE_SIZE)
+        : m_fileName(fileName), m_backend(backend), m_pageSize(pageSize) {
+        if (!isValidPageSize(pageSize)) {
+            throw std::invalid_argument("Page size must be a power of two between 4K and 64K");
+        }
         // Ensure the directory exists
         std::filesystem::path filePath(fileName);
         if (filePath.has_parent_path()) {
             std::filesystem::create_directories(filePath.parent_path());
         }
+
+#ifdef BPLUS_SQL_HAS_MMAP
+        if (m_backend == Backend::MMAP) {
+            openMapped();
+            return;
+        }
+#endif
+#ifdef BPLUS_SQL_HAS_URING
+        if (m_backend == Backend::URING && openRing()) {
+            return;
+        }
+#endif
+        m_backend = Backend::STREAM;
         
         // Try to open existing file first
         m_file.open(fileName, std::ios::in | std::ios::out | std::ios::binary);
@@ -36,57 +98,144 @@ public:
                 throw std::runtime_error("Failed to open file: " + fileName);
             }
         }
+
+        m_file.seekg(0, std::ios::end);
+        std::streampos endPos = m_file.tellg();
+        m_fileSize = (endPos != std::streampos(-1)) ? static_cast<size_t>(endPos) : 0;
+        m_file.clear();
+
+        // std::fstream cannot sync to the device, keep a descriptor for that
+#ifdef BPLUS_SQL_HAS_MMAP
+        m_fd = ::open(fileName.c_str(), O_RDWR);
+#elif defined(_WIN32)
+        m_fd = ::_open(fileName.c_str(), _O_RDWR | _O_BINARY);
+#endif
     }
 
     ~Pager() {
+#ifdef BPLUS_SQL_HAS_MMAP
+        if (m_map != nullptr) {
+            // Dirty mapped pages stay in the OS page cache after munmap, like a closed stream
+            ::munmap(m_map, MMAP_RESERVE);
+            // Give back the zeros growMapped() allocated ahead of the last page
+            if (m_fileBytes > m_fileSize) {
+                [[maybe_unused]] int trimmed = ::ftruncate(m_fd, static_cast<off_t>(m_fileSize.load()));
+            }
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+#elif defined(_WIN32)
+        if (m_fd >= 0) {
+            ::_close(m_fd);
+        }
+#endif
         if (m_file.is_open()) {
             m_file.flush();
             m_file.close();
         }
     }
 
-    static constexpr size_t PAGE_SIZE = 1ull << 12;
+    Pager(const Pager &) = delete;
+    Pager &operator=(const Pager &) = delete;
 
-    void ensurePageExists(size_t pageId) {
-        // Ensure the file has at least metadata page + (pageId+1)*PAGE_SIZE bytes
-        size_t need = PAGE_SIZE + (pageId + 1) * PAGE_SIZE; // First page is metadata
-        
-        // Get current file size
-        m_file.seekg(0, std::ios::end);
-        std::streampos endPos = m_file.tellg();
-        size_t curSize = (endPos != std::streampos(-1)) ? static_cast<size_t>(endPos) : 0;
-        
-        if (curSize >= need) {
-            m_file.clear(); // Clear any EOF flags
+    // The mapping grows by this many bytes at a time
+    static constexpr size_t MMAP_EXTENT = 1ull << 26;
+    // Address space reserved up front so page addresses stay valid while the mapping grows
+    static constexpr size_t MMAP_RESERVE = 1ull << 36;
+    // Reads or writes the URING backend keeps in flight at once
+    static constexpr unsigned RING_ENTRIES = 128;
+
+    static bool isValidPageSize(size_t pageSize) {
+        return pageSize >= PAGE_SIZE && pageSize <= MAX_PAGE_SIZE && (pageSize & (pageSize - 1)) == 0;
+    }
+
+    size_t pageSize() const {
+        return m_pageSize;
+    }
+
+    Backend backend() const {
+        return m_backend;
+    }
+
+    bool isMapped() const {
+        return m_backend == Backend::MMAP;
+    }
+
+    /// @brief Address of a node page inside the mapping (MMAP backend only).
+    /// The address stays valid for the lifetime of the Pager.
+    char *pageData(size_t pageId) {
+        if (!isMapped()) {
+            throw std::logic_error("pageData() requires the MMAP backend");
+        }
+        size_t offset = m_pageSize + pageId * m_pageSize; // First page is metadata
+        if (m_fileSize < offset + m_pageSize) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ensurePageExists(pageId);
+        }
+        return m_map + offset;
+    }
+
+    // Hand buffered writes to the OS without waiting for the device
+    void flush() {
+        if (m_backend == Backend::STREAM) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_file.flush();
+        }
+    }
+
+    /// @brief Push written pages to stable storage.
+    /// Writes are only buffered until this is called: MMAP uses msync, STREAM flushes and fdatasyncs.
+    void sync() {
+#ifdef BPLUS_SQL_HAS_MMAP
+        if (isMapped()) {
+            if (m_fileSize > 0 && ::msync(m_map, m_fileSize, MS_SYNC) != 0) {
+                throw std::runtime_error("Failed to msync file: " + m_fileName);
+            }
             return;
         }
-        
-        // Append zeros to expand the file
-        m_file.clear();
-        m_file.seekp(0, std::ios::end);
-        
-        size_t remaining = need - curSize;
-        // Use heap allocation for the buffer to avoid stack overflow
-        std::vector<char> zeroBuf(PAGE_SIZE, 0);
-        
-        while (remaining > 0) {
-            size_t toWrite = (remaining > PAGE_SIZE) ? PAGE_SIZE : remaining;
-            m_file.write(zeroBuf.data(), toWrite);
-            remaining -= toWrite;
+#endif
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_backend == Backend::STREAM) {
+            m_file.flush();
+            if (!m_file.good()) {
+                throw std::runtime_error("Failed to flush file: " + m_fileName);
+            }
+        }
+#if defined(__APPLE__)
+        bool failed = m_fd >= 0 && ::fsync(m_fd) != 0;
+#elif defined(BPLUS_SQL_HAS_MMAP)
+        bool failed = m_fd >= 0 && ::fdatasync(m_fd) != 0;
+#elif defined(_WIN32)
+        bool failed = m_fd >= 0 && ::_commit(m_fd) != 0;
+#else
+        bool failed = false;
+#endif
+        if (failed) {
+            throw std::runtime_error("Failed to sync file: " + m_fileName);
         }
-        
-        m_file.flush();
-        m_file.clear(); // Clear any flags
     }
 
     template<typename T>
     void readPage(size_t pageId, T &node) {
         static_assert(sizeof(T) <= PAGE_SIZE, "T should fit in a page");
+        if (isMapped()) {
+            std::memcpy(&node, pageData(pageId), sizeof(node));
+            return;
+        }
+        if (usesRing()) {
+            std::vector<char> pageBuf(m_pageSize);
+            readPageData(pageId, pageBuf.data());
+            std::memcpy(&node, pageBuf.data(), sizeof(node));
+            return;
+        }
+
         // Ensure the page exists
+        std::lock_guard<std::mutex> lock(m_mutex);
         ensurePageExists(pageId);
         
         // Seek to the page position (offset by metadata size)
-        size_t offset = PAGE_SIZE + pageId * PAGE_SIZE; // First page is metadata
+        size_t offset = m_pageSize + pageId * m_pageSize; // First page is metadata
         m_file.clear();
         m_file.seekg(offset, std::ios::beg);
         
@@ -96,8 +245,8 @@ public:
         }
         
         // Read the page into a buffer (use heap allocation to avoid stack overflow)
-        std::vector<char> pageBuf(PAGE_SIZE);
-        m_file.read(pageBuf.data(), PAGE_SIZE);
+        std::vector<char> pageBuf(m_pageSize);
+        m_file.read(pageBuf.data(), m_pageSize);
         
         // Copy node data from buffer
         std::memcpy(&node, pageBuf.data(), sizeof(node));
@@ -106,43 +255,268 @@ public:
     template<typename T>
     void writePage(size_t pageId, T &node) {
         static_assert(sizeof(T) <= PAGE_SIZE, "T should fit in a page");
+        if (isMapped()) {
+            std::memcpy(pageData(pageId), &node, sizeof(node));
+            return;
+        }
+        if (usesRing()) {
+            std::vector<char> pageBuf(m_pageSize, 0);
+            std::memcpy(pageBuf.data(), &node, sizeof(node));
+            writePageData(pageId, pageBuf.data());
+            return;
+        }
         
         // Ensure the page exists
+        std::lock_guard<std::mutex> lock(m_mutex);
         ensurePageExists(pageId);
         
         // Prepare page buffer with zeros (use heap allocation to avoid stack overflow)
-        std::vector<char> pageBuf(PAGE_SIZE, 0);
+        std::vector<char> pageBuf(m_pageSize, 0);
         
         // Copy node data to buffer
         std::memcpy(pageBuf.data(), &node, sizeof(node));
         
         // Seek to the page position (offset by metadata size)
-        size_t offset = PAGE_SIZE + pageId * PAGE_SIZE; // First page is metadata
+        size_t offset = m_pageSize + pageId * m_pageSize; // First page is metadata
         m_file.clear();
         m_file.seekp(offset, std::ios::beg);
         
-        // Write the page
-        m_file.write(pageBuf.data(), PAGE_SIZE);
-        m_file.flush();
+        // Write the page, it stays buffered until sync()
+        m_file.write(pageBuf.data(), m_pageSize);
+    }
+    
+    // Read a whole page straight into `buffer` (pageSize() bytes), without a staging copy
+    void readPageData(size_t pageId, char *buffer) {
+        if (isMapped()) {
+            std::memcpy(buffer, pageData(pageId), m_pageSize);
+            return;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (auto logged = m_logged.find(pageId); logged != m_logged.end()) {
+            m_log->readPage(logged->second, buffer, m_pageSize);
+            return;
+        }
+        ensurePageExists(pageId);
+        if (usesRing()) {
+            lock.unlock();
+            if (!readAt(pageOffset(pageId), buffer, m_pageSize)) {
+                std::memset(buffer, 0, m_pageSize);
+            }
+            return;
+        }
+        m_file.clear();
+        m_file.seekg(m_pageSize + pageId * m_pageSize, std::ios::beg); // First page is metadata
+        m_file.read(buffer, m_pageSize);
+        if (!m_file.good()) {
+            std::memset(buffer, 0, m_pageSize);
+        }
+    }
+
+    // Write a whole page from `buffer` (pageSize() bytes), it stays buffered until sync().
+    // While a log is attached the page goes to the log instead, see attachLog().
+    void writePageData(size_t pageId, const char *buffer) {
+        if (isMapped()) {
+            std::memcpy(pageData(pageId), buffer, m_pageSize);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_log != nullptr) {
+            m_logged[pageId] = m_log->appendPage(pageId, buffer, m_pageSize);
+            return;
+        }
+        writeInPlace(pageId, buffer);
+    }
+
+    /// @brief Read the pages together, calling `done(i, ok)` as pages[i] arrives, in any order and on the
+    /// calling thread; throws once all of them are done if any failed.
+    /// URING hands all of them to the kernel at once, the other backends read one page after the other.
+    void readPages(std::span<const PageTransfer> pages, const std::function<void(size_t, bool)> &done) {
+#ifdef BPLUS_SQL_HAS_URING
+        if (usesRing()) {
+            std::vector<size_t> fromFile = prepareTransfers(pages, false, done);
+            // Short only at the end of the file, which then reads as zeros
+            transferAll(pages, fromFile, false, [&](size_t i, int result) {
+                if (result >= 0) {
+                    std::memset(pages[i].buffer + result, 0, m_pageSize - result);
+                }
+                done(i, result >= 0);
+            });
+            return;
+        }
+#endif
+        bool failed = false;
+        for (size_t i = 0; i < pages.size(); ++i) {
+            bool ok = true;
+            try {
+                readPageData(pages[i].pageId, pages[i].buffer);
+            } catch (const std::exception &) {
+                ok = false;
+                failed = true;
+            }
+            done(i, ok);
+        }
+        if (failed) {
+            throw std::runtime_error("Failed to read pages from file: " + m_fileName);
+        }
+    }
+
+    // writePageData() of every page, like readPages(): all at once with URING, one after the other otherwise.
+    // While a log is attached the pages go to the log one after the other.
+    void writePages(std::span<const PageTransfer> pages, const std::function<void(size_t, bool)> &done) {
+#ifdef BPLUS_SQL_HAS_URING
+        if (usesRing()) {
+            std::vector<size_t> toFile = prepareTransfers(pages, true, done);
+            transferAll(pages, toFile, true, [&](size_t i, int result) {
+                done(i, result == static_cast<int>(m_pageSize));
+            });
+            return;
+        }
+#endif
+        bool failed = false;
+        for (size_t i = 0; i < pages.size(); ++i) {
+            bool ok = true;
+            try {
+                writePageData(pages[i].pageId, pages[i].buffer);
+            } catch (const std::exception &) {
+                ok = false;
+                failed = true;
+            }
+            done(i, ok);
+        }
+        if (failed) {
+            throw std::runtime_error("Failed to write pages to file: " + m_fileName);
+        }
+    }
+
+    /// @brief Let URING move pages in and out of [base, base + size) without mapping the buffers on every
+    /// request. The kernel pins the whole range for the ring, against RLIMIT_MEMLOCK. False without a ring
+    /// or when the kernel refuses; pages then move through plain reads and writes.
+    bool registerBuffers(char *base, size_t size) {
+#ifdef BPLUS_SQL_HAS_URING
+        if (usesRing()) {
+            std::lock_guard<std::mutex> lock(m_ringMutex);
+            return m_ring->registerBuffer(base, size);
+        }
+#endif
+        return false;
+    }
+
+    // Pages moved through the registered buffers so far
+    size_t fixedTransfers() {
+#ifdef BPLUS_SQL_HAS_URING
+        if (usesRing()) {
+            std::lock_guard<std::mutex> lock(m_ringMutex);
+            return m_ring->fixedRequests();
+        }
+#endif
+        return 0;
+    }
+
+    /// @brief Park written pages in `log` rather than the file, so the file keeps its last checkpoint;
+    /// null detaches the log. Reads of parked pages are served from the log (STREAM backend only).
+    void attachLog(WriteAheadLog *log) {
+        if (log != nullptr && isMapped()) {
+            throw std::logic_error("A write-ahead log requires the STREAM backend");
+        }
+        m_log = log;
+    }
+
+    // Copy the pages parked in the log to their places in the file, in file order
+    void writeLoggedPages() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<char> pageBuf(m_pageSize);
+        for (auto [pageId, position] : m_logged) {
+            m_log->readPage(position, pageBuf.data(), m_pageSize);
+            writeInPlace(pageId, pageBuf.data());
+        }
+        m_logged.clear();
+    }
+
+    // Recovery: the latest image of `pageId` is at `position` in the attached log
+    void restoreLoggedPage(size_t pageId, uint64_t position) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_logged[pageId] = position;
+    }
+
+    // (page id, log position) of every page parked in the log, in page order
+    std::vector<std::pair<uint64_t, uint64_t>> loggedPages() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return {m_logged.begin(), m_logged.end()};
     }
     
     // Metadata operations - store at the beginning of file (before first page)
     template<typename T>
     void writeMetadata(const T& metadata) {
         static_assert(sizeof(T) <= PAGE_SIZE, "Metadata type T must fit in one page");
+        std::lock_guard<std::mutex> lock(m_mutex);
+#ifdef BPLUS_SQL_HAS_MMAP
+        if (isMapped()) {
+            growMapped(m_pageSize);
+            std::memcpy(m_map, &metadata, sizeof(T));
+            return;
+        }
+#endif
+        if (usesRing()) {
+            if (!writeAt(0, reinterpret_cast<const char *>(&metadata), sizeof(T))) {
+                throw std::runtime_error("Failed to write metadata to file: " + m_fileName);
+            }
+            if (m_fileSize < sizeof(T)) {
+                m_fileSize = sizeof(T);
+            }
+            return;
+        }
         
         // Seek to the beginning of file
         m_file.clear();
         m_file.seekp(0, std::ios::beg);
         
-        // Write metadata
+        // Write metadata, it stays buffered until sync()
         m_file.write(reinterpret_cast<const char*>(&metadata), sizeof(T));
-        m_file.flush();
+        if (m_fileSize < sizeof(T)) {
+            m_fileSize = sizeof(T);
+        }
     }
     
+    // Overwrite `size` bytes of the metadata page at `offset`, leaving the rest of it as it is
+    void writeMetadataBytes(size_t offset, const void *data, size_t size) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+#ifdef BPLUS_SQL_HAS_MMAP
+        if (isMapped()) {
+            growMapped(m_pageSize);
+            std::memcpy(m_map + offset, data, size);
+            return;
+        }
+#endif
+        if (usesRing()) {
+            if (!writeAt(offset, static_cast<const char *>(data), size)) {
+                throw std::runtime_error("Failed to write metadata to file: " + m_fileName);
+            }
+            return;
+        }
+        m_file.clear();
+        m_file.seekp(static_cast<std::streamoff>(offset), std::ios::beg);
+        m_file.write(static_cast<const char *>(data), size);
+    }
+
     template<typename T>
     void readMetadata(T& metadata) {
         static_assert(sizeof(T) <= PAGE_SIZE, "Metadata type T must fit in one page");
+        std::lock_guard<std::mutex> lock(m_mutex);
+#ifdef BPLUS_SQL_HAS_MMAP
+        if (isMapped()) {
+            if (m_fileSize < sizeof(T)) {
+                throw std::runtime_error("Failed to read metadata from file");
+            }
+            std::memcpy(&metadata, m_map, sizeof(T));
+            return;
+        }
+#endif
+        if (usesRing()) {
+            if (!readAt(0, reinterpret_cast<char *>(&metadata), sizeof(T))) {
+                throw std::runtime_error("Failed to read metadata from file");
+            }
+            return;
+        }
         
         // Seek to the beginning of file
         m_file.clear();
@@ -157,24 +531,296 @@ public:
         }
     }
     
+    /// @brief Cut the file down to the metadata page plus `pageCount` node pages.
+    /// Anything written to the dropped pages is lost; a file that is already shorter is left alone.
+    void truncate(size_t pageCount) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_logged.erase(m_logged.lower_bound(pageCount), m_logged.end());
+        size_t size = m_pageSize + pageCount * m_pageSize; // First page is metadata
+        if (size >= m_fileSize) {
+            return;
+        }
+#ifdef BPLUS_SQL_HAS_MMAP
+        if (isMapped() || usesRing()) {
+            // A mapping keeps its extents; growMapped() extends the file again before they are touched
+            if (::ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+                throw std::runtime_error("Failed to truncate file: " + m_fileName);
+            }
+            m_fileSize = size;
+            m_fileBytes = size;
+            return;
+        }
+#endif
+        m_file.flush();
+        std::filesystem::resize_file(m_fileName, size);
+        m_fileSize = size;
+        m_file.clear();
+    }
+
     bool fileExists() const {
         return std::filesystem::exists(m_fileName);
     }
     
     size_t getFileSize() {
         if (!fileExists()) return 0;
+        return m_fileSize;
+    }
+    
+private:
+    void ensurePageExists(size_t pageId) {
+        // Ensure the file has at least metadata page + (pageId+1) pages
+        size_t need = m_pageSize + (pageId + 1) * m_pageSize; // First page is metadata
+
+#ifdef BPLUS_SQL_HAS_MMAP
+        if (isMapped()) {
+            growMapped(need);
+            return;
+        }
+        if (usesRing()) {
+            // ftruncate zero-fills the new range, like appending zeros to the stream
+            if (m_fileSize < need && ::ftruncate(m_fd, static_cast<off_t>(need)) != 0) {
+                throw std::runtime_error("Failed to extend file: " + m_fileName);
+            }
+            m_fileSize = std::max<size_t>(m_fileSize, need);
+            return;
+        }
+#endif
         
+        if (m_fileSize >= need) {
+            return;
+        }
+        
+        // Append zeros to expand the file
         m_file.clear();
-        m_file.seekg(0, std::ios::end);
-        std::streampos endPos = m_file.tellg();
-        m_file.clear();
+        m_file.seekp(static_cast<std::streamoff>(m_fileSize), std::ios::beg);
+        
+        size_t remaining = need - m_fileSize;
+        // Use heap allocation for the buffer to avoid stack overflow
+        std::vector<char> zeroBuf(m_pageSize, 0);
         
-        return (endPos != std::streampos(-1)) ? static_cast<size_t>(endPos) : 0;
+        while (remaining > 0) {
+            size_t toWrite = (remaining > m_pageSize) ? m_pageSize : remaining;
+            m_file.write(zeroBuf.data(), toWrite);
+            remaining -= toWrite;
+        }
+        
+        m_fileSize = need;
+        m_file.clear(); // Clear any flags
     }
-    
-private:
+
+    void writeInPlace(size_t pageId, const char *buffer) {
+        ensurePageExists(pageId);
+        if (usesRing()) {
+            if (!writeAt(pageOffset(pageId), buffer, m_pageSize)) {
+                throw std::runtime_error("Failed to write page to file: " + m_fileName);
+            }
+            return;
+        }
+        m_file.clear();
+        m_file.seekp(m_pageSize + pageId * m_pageSize, std::ios::beg); // First page is metadata
+        m_file.write(buffer, m_pageSize);
+    }
+
+    bool usesRing() const {
+        return m_backend == Backend::URING;
+    }
+
+    size_t pageOffset(size_t pageId) const {
+        return m_pageSize + pageId * m_pageSize; // First page is metadata
+    }
+
+#ifdef BPLUS_SQL_HAS_MMAP
+    // `size` bytes at `offset` of m_fd, in as many system calls as it takes; false on an error or at the end of the file
+    bool readAt(size_t offset, char *buffer, size_t size) {
+        while (size > 0) {
+            ssize_t done = ::pread(m_fd, buffer, size, static_cast<off_t>(offset));
+            if (done <= 0) {
+                if (done < 0 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            buffer += done;
+            offset += static_cast<size_t>(done);
+            size -= static_cast<size_t>(done);
+        }
+        return true;
+    }
+
+    bool writeAt(size_t offset, const char *buffer, size_t size) {
+        while (size > 0) {
+            ssize_t done = ::pwrite(m_fd, buffer, size, static_cast<off_t>(offset));
+            if (done < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            buffer += done;
+            offset += static_cast<size_t>(done);
+            size -= static_cast<size_t>(done);
+        }
+        return true;
+    }
+#else
+    bool readAt(size_t, char *, size_t) {
+        return false;
+    }
+
+    bool writeAt(size_t, const char *, size_t) {
+        return false;
+    }
+#endif
+
+#ifdef BPLUS_SQL_HAS_URING
+    bool openRing() {
+        m_ring = IoRing::create(RING_ENTRIES);
+        if (m_ring == nullptr) {
+            return false;
+        }
+        m_fd = ::open(m_fileName.c_str(), O_RDWR | O_CREAT, 0644);
+        if (m_fd < 0) {
+            throw std::runtime_error("Failed to open file: " + m_fileName);
+        }
+        struct stat st;
+        if (::fstat(m_fd, &st) != 0) {
+            throw std::runtime_error("Failed to stat file: " + m_fileName);
+        }
+        m_fileSize = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    /// @brief Serve the pages parked in the log right away (writes: park them all, if a log is attached)
+    /// and make the file cover the rest; returns the indices of the pages left to move through the ring.
+    /// `done` is only called once m_mutex is released, since it may lock the buffer pool.
+    std::vector<size_t> prepareTransfers(std::span<const PageTransfer> pages, bool writing,
+                                         const std::function<void(size_t, bool)> &done) {
+        std::vector<size_t> served, remaining;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < pages.size(); ++i) {
+                auto [pageId, buffer] = pages[i];
+                if (writing && m_log != nullptr) {
+                    m_logged[pageId] = m_log->appendPage(pageId, buffer, m_pageSize);
+                    served.push_back(i);
+                } else if (auto logged = m_logged.find(pageId); !writing && logged != m_logged.end()) {
+                    m_log->readPage(logged->second, buffer, m_pageSize);
+                    served.push_back(i);
+                } else {
+                    ensurePageExists(pageId);
+                    remaining.push_back(i);
+                }
+            }
+        }
+        for (size_t i : served) {
+            done(i, true);
+        }
+        return remaining;
+    }
+
+    // Move pages[i] for every i in `indices` through the ring, RING_ENTRIES at a time, calling
+    // complete(i, result) as each finishes; throws once all are done if any failed
+    template<typename Complete>
+    void transferAll(std::span<const PageTransfer> pages, const std::vector<size_t> &indices, bool writing, Complete &&complete) {
+        bool failed = false;
+        auto finish = [&](uint64_t i, int result) {
+            failed |= writing ? result != static_cast<int>(m_pageSize) : result < 0;
+            complete(static_cast<size_t>(i), result);
+        };
+        std::lock_guard<std::mutex> lock(m_ringMutex);
+        for (size_t i : indices) {
+            auto [pageId, buffer] = pages[i];
+            while (writing ? !m_ring->write(m_fd, buffer, m_pageSize, pageOffset(pageId), i)
+                           : !m_ring->read(m_fd, buffer, m_pageSize, pageOffset(pageId), i)) {
+                m_ring->reap(1, finish);
+            }
+        }
+        m_ring->reap(m_ring->outstanding(), finish);
+        if (failed) {
+            throw std::runtime_error(std::string(writing ? "Failed to write pages to file: " : "Failed to read pages from file: ") + m_fileName);
+        }
+    }
+#endif
+
+#ifdef BPLUS_SQL_HAS_MMAP
+    void openMapped() {
+        m_fd = ::open(m_fileName.c_str(), O_RDWR | O_CREAT, 0644);
+        if (m_fd < 0) {
+            throw std::runtime_error("Failed to open file: " + m_fileName);
+        }
+        struct stat st;
+        if (::fstat(m_fd, &st) != 0) {
+            ::close(m_fd);
+            throw std::runtime_error("Failed to stat file: " + m_fileName);
+        }
+        m_fileSize = static_cast<size_t>(st.st_size);
+        m_fileBytes = m_fileSize;
+
+        // Reserve the address range once; file extents are mapped into it with MAP_FIXED
+        void *reserved = ::mmap(nullptr, MMAP_RESERVE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (reserved == MAP_FAILED) {
+            ::close(m_fd);
+            throw std::runtime_error("Failed to reserve address space for: " + m_fileName);
+        }
+        m_map = static_cast<char *>(reserved);
+        mapExtents(m_fileSize);
+    }
+
+    /// @brief Extend the file to at least `need` bytes and make sure the mapping covers it.
+    /// The file grows a whole extent at a time, so appending pages costs one ftruncate per extent;
+    /// m_fileSize keeps the size up to the last page, and the file is cut back to it on close.
+    void growMapped(size_t need) {
+        if (m_fileSize >= need) {
+            return;
+        }
+        if (need > MMAP_RESERVE) {
+            throw std::runtime_error("File exceeds the mmap reservation: " + m_fileName);
+        }
+        // ftruncate zero-fills the new range, matching the STREAM backend
+        if (m_fileBytes < need) {
+            size_t target = std::min((need + MMAP_EXTENT - 1) / MMAP_EXTENT * MMAP_EXTENT, MMAP_RESERVE);
+            if (::ftruncate(m_fd, static_cast<off_t>(target)) != 0) {
+                throw std::runtime_error("Failed to extend file: " + m_fileName);
+            }
+            m_fileBytes = target;
+        }
+        // Map the new range before publishing the size, pageData() hands out addresses below it unlocked
+        mapExtents(need);
+        m_fileSize = need;
+    }
+
+    void mapExtents(size_t need) {
+        while (m_mappedBytes < need) {
+            void *addr = ::mmap(m_map + m_mappedBytes, MMAP_EXTENT, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_FIXED, m_fd, static_cast<off_t>(m_mappedBytes));
+            if (addr == MAP_FAILED) {
+                throw std::runtime_error("Failed to map file: " + m_fileName);
+            }
+            m_mappedBytes += MMAP_EXTENT;
+        }
+    }
+#endif
+
     std::string m_fileName;
+    Backend m_backend;
+    size_t m_pageSize;
     std::fstream m_file;
+    int m_fd = -1;
+    char *m_map = nullptr;
+    size_t m_mappedBytes = 0;
+    std::atomic<size_t> m_fileSize = 0;
+    // MMAP: bytes the file really has, up to a whole extent past m_fileSize while it is open
+    size_t m_fileBytes = 0;
+    WriteAheadLog *m_log = nullptr;
+    // Log position of the latest image of every page parked in m_log
+    std::map<size_t, uint64_t> m_logged;
+    // Serializes the stream, growing the file and m_logged
+    mutable std::mutex m_mutex;
+#ifdef BPLUS_SQL_HAS_URING
+    std::unique_ptr<IoRing> m_ring;
+    // A batch has the ring to itself, from its first request until its last completion
+    std::mutex m_ringMutex;
+#endif
 };
 
 }
@@ -0,0 +1,464 @@
+#ifndef __REPLACER_H__
+#define __REPLACER_H__
+
+#include "bplus_tree.h"
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace bplus_sql {
+
+/// @brief Replacement bookkeeping the buffer pool keeps next to every frame.
+/// Replacers link their frames through prev/next, so tracking a page never allocates.
+struct ReplacementState {
+    static constexpr uint32_t NO_LINK = UINT32_MAX;
+
+    size_t pageId = 0;
+    uint32_t prev = NO_LINK;
+    uint32_t next = NO_LINK;
+    uint64_t lastAccess = 0;
+    // Access before lastAccess, 0 if the page was only touched once (LRU-2)
+    uint64_t previousAccess = 0;
+    // Position in the heap of evictable frames, NO_LINK when not on it (LRU-2)
+    uint32_t heapIndex = NO_LINK;
+    // Queue the frame is on (2Q)
+    uint8_t queue = 0;
+    // Reference bit (CLOCK)
+    bool referenced = false;
+    // Cleared while the frame is pinned
+    bool evictable = true;
+};
+
+/// @brief Decides which of one table's frames the buffer pool should evict next.
+class Replacer {
+public:
+    static constexpr uint32_t NO_FRAME = ReplacementState::NO_LINK;
+
+    explicit Replacer(std::vector<ReplacementState> &states) : m_states(states) {}
+    virtual ~Replacer() = default;
+
+    Replacer(const Replacer &) = delete;
+    Replacer &operator=(const Replacer &) = delete;
+
+    // The frame now holds pageId (a miss)
+    virtual void inserted(uint32_t frame, size_t pageId) = 0;
+    // The frame's page was found in the cache (a hit)
+    virtual void accessed(uint32_t frame) = 0;
+    // The frame's page left the cache
+    virtual void removed(uint32_t frame) = 0;
+    // Evictable frame to replace next, or NO_FRAME; the pool calls removed() once it evicts it
+    virtual uint32_t victim() = 0;
+
+    virtual ReplacementPolicy policy() const = 0;
+
+    virtual void setEvictable(uint32_t frame, bool evictable) {
+        m_states[frame].evictable = evictable;
+    }
+
+protected:
+    // Doubly linked list threaded through ReplacementState::prev/next, front is most recent
+    struct FrameList {
+        uint32_t head = NO_FRAME;
+        uint32_t tail = NO_FRAME;
+        size_t size = 0;
+    };
+
+    void pushFront(FrameList &list, uint32_t frame) {
+        ReplacementState &state = m_states[frame];
+        state.prev = NO_FRAME;
+        state.next = list.head;
+        if (list.head != NO_FRAME) {
+            m_states[list.head].prev = frame;
+        } else {
+            list.tail = frame;
+        }
+        list.head = frame;
+        list.size++;
+    }
+
+    void unlink(FrameList &list, uint32_t frame) {
+        ReplacementState &state = m_states[frame];
+        if (state.prev != NO_FRAME) {
+            m_states[state.prev].next = state.next;
+        } else {
+            list.head = state.next;
+        }
+        if (state.next != NO_FRAME) {
+            m_states[state.next].prev = state.prev;
+        } else {
+            list.tail = state.prev;
+        }
+        state.prev = state.next = NO_FRAME;
+        list.size--;
+    }
+
+    // Least recently used evictable frame of the list
+    uint32_t lastEvictable(const FrameList &list) const {
+        for (uint32_t frame = list.tail; frame != NO_FRAME; frame = m_states[frame].prev) {
+            if (m_states[frame].evictable) {
+                return frame;
+            }
+        }
+        return NO_FRAME;
+    }
+
+    std::vector<ReplacementState> &m_states;
+};
+
+/// @brief Strict least recently used.
+class LruReplacer : public Replacer {
+public:
+    using Replacer::Replacer;
+
+    void inserted(uint32_t frame, size_t pageId) override {
+        m_states[frame].pageId = pageId;
+        pushFront(m_list, frame);
+    }
+    void accessed(uint32_t frame) override {
+        unlink(m_list, frame);
+        pushFront(m_list, frame);
+    }
+    void removed(uint32_t frame) override {
+        unlink(m_list, frame);
+    }
+    ReplacementPolicy policy() const override {
+        return ReplacementPolicy::LRU;
+    }
+    uint32_t victim() override {
+        return lastEvictable(m_list);
+    }
+
+private:
+    FrameList m_list;
+};
+
+/// @brief CLOCK (second chance): a hit only sets a reference bit, so hits never reorder anything.
+class ClockReplacer : public Replacer {
+public:
+    using Replacer::Replacer;
+
+    void inserted(uint32_t frame, size_t pageId) override {
+        ReplacementState &state = m_states[frame];
+        state.pageId = pageId;
+        state.referenced = true;
+        if (m_hand == NO_FRAME) {
+            state.prev = state.next = frame;
+            m_hand = frame;
+        } else {
+            // Just behind the hand, so the new page is the last one the hand reaches
+            uint32_t before = m_states[m_hand].prev;
+            state.prev = before;
+            state.next = m_hand;
+            m_states[before].next = frame;
+            m_states[m_hand].prev = frame;
+        }
+        m_size++;
+    }
+    void accessed(uint32_t frame) override {
+        m_states[frame].referenced = true;
+    }
+    void removed(uint32_t frame) override {
+        ReplacementState &state = m_states[frame];
+        if (--m_size == 0) {
+            m_hand = NO_FRAME;
+        } else {
+            m_states[state.prev].next = state.next;
+            m_states[state.next].prev = state.prev;
+            if (m_hand == frame) {
+                m_hand = state.next;
+            }
+        }
+        state.prev = state.next = NO_FRAME;
+    }
+    ReplacementPolicy policy() const override {
+        return ReplacementPolicy::CLOCK;
+    }
+    uint32_t victim() override {
+        // Two sweeps clear every reference bit, so an evictable frame is found if one exists
+        for (size_t step = 0; m_hand != NO_FRAME && step < 2 * m_size + 1; ++step) {
+            uint32_t frame = m_hand;
+            ReplacementState &state = m_states[frame];
+            m_hand = state.next;
+            if (!state.evictable) {
+                continue;
+            }
+            if (state.referenced) {
+                state.referenced = false;
+                continue;
+            }
+            return frame;
+        }
+        return NO_FRAME;
+    }
+
+private:
+    uint32_t m_hand = NO_FRAME;
+    size_t m_size = 0;
+};
+
+/// @brief 2Q (Johnson & Shasha): pages seen once wait in a FIFO (A1in) and only pages referenced
+/// again after leaving it, remembered in the ghost queue A1out, reach the LRU queue Am.
+/// A sequential scan therefore cycles through A1in without touching the hot pages in Am.
+class TwoQueueReplacer : public Replacer {
+public:
+    TwoQueueReplacer(std::vector<ReplacementState> &states, size_t capacity)
+        : Replacer(states),
+          m_inCapacity(std::max<size_t>(1, capacity / 4)),
+          m_ghosts(std::max<size_t>(1, capacity / 2)),
+          m_ghostTable(tableSizeFor(m_ghosts.size()), EMPTY) {
+        m_ghostMask = m_ghostTable.size() - 1;
+    }
+
+    void inserted(uint32_t frame, size_t pageId) override {
+        ReplacementState &state = m_states[frame];
+        state.pageId = pageId;
+        size_t slot = findGhost(pageId);
+        if (m_ghostTable[slot] != EMPTY) {
+            // Referenced again after it left A1in: the page is hot
+            eraseGhostSlot(slot);
+            state.queue = AM;
+            pushFront(m_am, frame);
+        } else {
+            state.queue = A1IN;
+            pushFront(m_a1in, frame);
+        }
+    }
+    void accessed(uint32_t frame) override {
+        // Hits inside A1in are correlated references and do not promote the page
+        if (m_states[frame].queue == AM) {
+            unlink(m_am, frame);
+            pushFront(m_am, frame);
+        }
+    }
+    void removed(uint32_t frame) override {
+        if (m_states[frame].queue == AM) {
+            unlink(m_am, frame);
+        } else {
+            unlink(m_a1in, frame);
+            rememberGhost(m_states[frame].pageId);
+        }
+    }
+    ReplacementPolicy policy() const override {
+        return ReplacementPolicy::TWO_QUEUE;
+    }
+    uint32_t victim() override {
+        uint32_t frame = NO_FRAME;
+        if (m_a1in.size > m_inCapacity || m_am.size == 0) {
+            frame = lastEvictable(m_a1in);
+        }
+        if (frame == NO_FRAME) {
+            frame = lastEvictable(m_am);
+        }
+        if (frame == NO_FRAME) {
+            frame = lastEvictable(m_a1in);
+        }
+        return frame;
+    }
+
+private:
+    static constexpr uint8_t A1IN = 1;
+    static constexpr uint8_t AM = 2;
+    static constexpr size_t EMPTY = SIZE_MAX;
+
+    static size_t tableSizeFor(size_t entries) {
+        size_t size = 2;
+        while (size < entries * 2) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    size_t hash(size_t pageId) const {
+        return (pageId * 0x9E3779B97F4A7C15ull) & m_ghostMask;
+    }
+
+    // The ghost table maps a page id to its slot in the A1out ring; slots hold ring positions
+    size_t findGhost(size_t pageId) const {
+        size_t slot = hash(pageId);
+        while (m_ghostTable[slot] != EMPTY && m_ghosts[m_ghostTable[slot]] != pageId) {
+            slot = (slot + 1) & m_ghostMask;
+        }
+        return slot;
+    }
+
+    void eraseGhostSlot(size_t slot) {
+        size_t next = slot;
+        while (true) {
+            next = (next + 1) & m_ghostMask;
+            if (m_ghostTable[next] == EMPTY) {
+                break;
+            }
+            size_t home = hash(m_ghosts[m_ghostTable[next]]);
+            bool between = slot <= next ? (slot < home && home <= next) : (slot < home || home <= next);
+            if (!between) {
+                m_ghostTable[slot] = m_ghostTable[next];
+                slot = next;
+            }
+        }
+        m_ghostTable[slot] = EMPTY;
+    }
+
+    void rememberGhost(size_t pageId) {
+        if (m_ghostTable[findGhost(pageId)] != EMPTY) {
+            return;
+        }
+        // The ring is full: forget the oldest ghost if it is still remembered at this position
+        if (m_ghostCount == m_ghosts.size()) {
+            size_t oldSlot = findGhost(m_ghosts[m_ghostHead]);
+            if (m_ghostTable[oldSlot] == m_ghostHead) {
+                eraseGhostSlot(oldSlot);
+            }
+        } else {
+            m_ghostCount++;
+        }
+        m_ghosts[m_ghostHead] = pageId;
+        m_ghostTable[findGhost(pageId)] = m_ghostHead;
+        m_ghostHead = (m_ghostHead + 1) % m_ghosts.size();
+    }
+
+    size_t m_inCapacity;
+    FrameList m_a1in;
+    FrameList m_am;
+    // A1out: ring of page ids recently evicted from A1in, indexed by m_ghostTable
+    std::vector<size_t> m_ghosts;
+    std::vector<size_t> m_ghostTable;
+    size_t m_ghostMask;
+    size_t m_ghostHead = 0;
+    size_t m_ghostCount = 0;
+};
+
+/// @brief LRU-2 (O'Neil et al.): evict the page whose second most recent access is oldest.
+/// Pages referenced only once have an infinite backward distance and go first, oldest first,
+/// so a one-pass scan cannot displace pages that were used twice.
+/// Evictable frames are kept in a binary heap ordered that way, so picking a victim takes no scan.
+class Lru2Replacer : public Replacer {
+public:
+    Lru2Replacer(std::vector<ReplacementState> &states, size_t capacity) : Replacer(states) {
+        m_heap.reserve(capacity);
+    }
+
+    void inserted(uint32_t frame, size_t pageId) override {
+        ReplacementState &state = m_states[frame];
+        state.pageId = pageId;
+        state.previousAccess = 0;
+        state.lastAccess = ++m_tick;
+        if (state.evictable) {
+            push(frame);
+        }
+    }
+    void accessed(uint32_t frame) override {
+        ReplacementState &state = m_states[frame];
+        state.previousAccess = state.lastAccess;
+        state.lastAccess = ++m_tick;
+        // An access only ever moves a frame further from eviction
+        if (state.heapIndex != NO_FRAME) {
+            siftDown(state.heapIndex);
+        }
+    }
+    void removed(uint32_t frame) override {
+        if (m_states[frame].heapIndex != NO_FRAME) {
+            erase(frame);
+        }
+    }
+    void setEvictable(uint32_t frame, bool evictable) override {
+        Replacer::setEvictable(frame, evictable);
+        bool onHeap = m_states[frame].heapIndex != NO_FRAME;
+        if (evictable && !onHeap) {
+            push(frame);
+        } else if (!evictable && onHeap) {
+            erase(frame);
+        }
+    }
+    ReplacementPolicy policy() const override {
+        return ReplacementPolicy::LRU_2;
+    }
+    uint32_t victim() override {
+        return m_heap.empty() ? NO_FRAME : m_heap.front();
+    }
+
+private:
+    // Whether frame a goes before frame b: pages touched once first, then by backward 2-distance
+    bool before(uint32_t a, uint32_t b) const {
+        const ReplacementState &first = m_states[a], &second = m_states[b];
+        bool firstOnce = first.previousAccess == 0, secondOnce = second.previousAccess == 0;
+        if (firstOnce != secondOnce) {
+            return firstOnce;
+        }
+        return firstOnce ? first.lastAccess < second.lastAccess : first.previousAccess < second.previousAccess;
+    }
+
+    void place(size_t index, uint32_t frame) {
+        m_heap[index] = frame;
+        m_states[frame].heapIndex = static_cast<uint32_t>(index);
+    }
+
+    void siftUp(size_t index) {
+        uint32_t frame = m_heap[index];
+        while (index > 0 && before(frame, m_heap[(index - 1) / 2])) {
+            place(index, m_heap[(index - 1) / 2]);
+            index = (index - 1) / 2;
+        }
+        place(index, frame);
+    }
+
+    void siftDown(size_t index) {
+        uint32_t frame = m_heap[index];
+        while (true) {
+            size_t child = 2 * index + 1;
+            if (child >= m_heap.size()) {
+                break;
+            }
+            if (child + 1 < m_heap.size() && before(m_heap[child + 1], m_heap[child])) {
+                child++;
+            }
+            if (!before(m_heap[child], frame)) {
+                break;
+            }
+            place(index, m_heap[child]);
+            index = child;
+        }
+        place(index, frame);
+    }
+
+    void push(uint32_t frame) {
+        m_heap.push_back(frame);
+        siftUp(m_heap.size() - 1);
+    }
+
+    void erase(uint32_t frame) {
+        size_t index = m_states[frame].heapIndex;
+        uint32_t last = m_heap.back();
+        m_heap.pop_back();
+        m_states[frame].heapIndex = NO_FRAME;
+        if (last != frame) {
+            place(index, last);
+            siftUp(index);
+            siftDown(m_states[last].heapIndex);
+        }
+    }
+
+    std::vector<uint32_t> m_heap;
+    uint64_t m_tick = 0;
+};
+
+// `capacity` is the most frames the replacer will ever track; it sizes 2Q's queues and the LRU-2 heap
+inline std::unique_ptr<Replacer> makeReplacer(ReplacementPolicy policy, std::vector<ReplacementState> &states, size_t capacity) {
+    switch (policy) {
+        case ReplacementPolicy::LRU:
+            return std::make_unique<LruReplacer>(states);
+        case ReplacementPolicy::CLOCK:
+            return std::make_unique<ClockReplacer>(states);
+        case ReplacementPolicy::TWO_QUEUE:
+            return std::make_unique<TwoQueueReplacer>(states, capacity);
+        case ReplacementPolicy::LRU_2:
+            return std::make_unique<Lru2Replacer>(states, capacity);
+    }
+    throw std::invalid_argument("Unknown replacement policy");
+}
+
+}
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef __SEARCH_KERNELS_H__
+#define __SEARCH_KERNELS_H__
+
+#include "key_traits.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BPLUS_SQL_HAS_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace bplus_sql {
+
+/// @brief In-node search over a sorted array of integer keys.
+/// lowerBound counts the keys < key (where key would be inserted), upperBound counts the keys <= key
+/// (the child to descend into). Every kernel returns exactly what the scalar loop returns.
+template<typename Key>
+struct BasicSearchKernel {
+    const char *name;
+    size_t (*lowerBound)(const Key *keys, size_t count, Key key);
+    size_t (*upperBound)(const Key *keys, size_t count, Key key);
+};
+
+using SearchKernel = BasicSearchKernel<int32_t>;
+
+namespace search_kernels {
+
+// The original linear scan, stopping at the first key that is not smaller
+template<typename Key>
+inline size_t scalarLowerBound(const Key *keys, size_t count, Key key) {
+    size_t index = 0;
+    while (index < count && keys[index] < key) {
+        index++;
+    }
+    return index;
+}
+
+template<typename Key>
+inline size_t scalarUpperBound(const Key *keys, size_t count, Key key) {
+    size_t index = 0;
+    while (index < count && keys[index] <= key) {
+        index++;
+    }
+    return index;
+}
+
+// Binary search whose only data-dependent step is a conditional move; works for any ordering
+template<bool UPPER, typename Key, typename Less>
+inline size_t binaryBound(const Key *keys, size_t count, const Key &key, Less less) {
+    if (count == 0) {
+        return 0;
+    }
+    const Key *base = keys;
+    while (count > 1) {
+        size_t half = count / 2;
+        bool right = UPPER ? !less(key, base[half]) : less(base[half], key);
+        base = right ? base + half : base;
+        count -= half;
+    }
+    bool last = UPPER ? !less(key, *base) : less(*base, key);
+    return static_cast<size_t>(base - keys) + last;
+}
+
+template<typename Key>
+inline size_t binaryLowerBound(const Key *keys, size_t count, Key key) {
+    return binaryBound<false>(keys, count, key, [](const Key &a, const Key &b) { return a < b; });
+}
+
+template<typename Key>
+inline size_t binaryUpperBound(const Key *keys, size_t count, Key key) {
+    return binaryBound<true>(keys, count, key, [](const Key &a, const Key &b) { return a < b; });
+}
+
+#ifdef BPLUS_SQL_HAS_X86_KERNELS
+
+// Branch-free binary steps narrow the range to a window of at most `width` keys; every key before the
+// window is < key (or <= key) and every key after it is not, so the result is the window start plus the
+// number of window keys that compare true. The window is counted with vector compares, so no branch
+// depends on the data. Unsigned keys are compared as signed after flipping their top bit.
+template<bool UPPER, typename Key>
+inline const Key *narrow(const Key *keys, size_t &count, Key key, size_t width) {
+    const Key *base = keys;
+    while (count > width) {
+        size_t half = count / 2;
+        bool right = UPPER ? base[half] <= key : base[half] < key;
+        base = right ? base + half : base;
+        count -= half;
+    }
+    return base;
+}
+
+template<bool UPPER>
+__attribute__((target("sse4.1,popcnt"))) inline size_t sse4Bound(const int32_t *keys, size_t count, int32_t key) {
+    const int32_t *base = narrow<UPPER>(keys, count, key, 8);
+    __m128i needle = _mm_set1_epi32(key);
+    size_t result = static_cast<size_t>(base - keys);
+    size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(base + index));
+        __m128i hit = UPPER ? _mm_cmpgt_epi32(block, needle) : _mm_cmpgt_epi32(needle, block);
+        size_t bits = static_cast<size_t>(_mm_popcnt_u32(static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(hit)))));
+        result += UPPER ? 4 - bits : bits;
+    }
+    for (; index < count; ++index) {
+        result += UPPER ? base[index] <= key : base[index] < key;
+    }
+    return result;
+}
+
+template<bool UPPER, typename Key>
+__attribute__((target("avx2,popcnt"))) inline size_t avx2Bound32(const Key *keys, size_t count, Key key) {
+    const Key *base = narrow<UPPER>(keys, count, key, 16);
+    const int bias = std::is_unsigned_v<Key> ? INT32_MIN : 0;
+    // Masked loads cover the partial window without reading past the array
+    __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i lowMask = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(count)), lanes);
+    __m256i highMask = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(count) - 8), lanes);
+    __m256i flip = _mm256_set1_epi32(bias);
+    __m256i low = _mm256_xor_si256(_mm256_maskload_epi32(reinterpret_cast<const int *>(base), lowMask), flip);
+    __m256i high = _mm256_xor_si256(_mm256_maskload_epi32(reinterpret_cast<const int *>(base + 8), highMask), flip);
+    __m256i needle = _mm256_set1_epi32(static_cast<int>(key) ^ bias);
+    __m256i lowHit, highHit;
+    if constexpr (UPPER) {
+        lowHit = _mm256_andnot_si256(_mm256_cmpgt_epi32(low, needle), lowMask);
+        highHit = _mm256_andnot_si256(_mm256_cmpgt_epi32(high, needle), highMask);
+    } else {
+        lowHit = _mm256_and_si256(_mm256_cmpgt_epi32(needle, low), lowMask);
+        highHit = _mm256_and_si256(_mm256_cmpgt_epi32(needle, high), highMask);
+    }
+    unsigned bits = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(lowHit))) |
+                    static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(highHit))) << 8;
+    return static_cast<size_t>(base - keys) + static_cast<size_t>(_mm_popcnt_u32(bits));
+}
+
+template<bool UPPER, typename Key>
+__attribute__((target("avx2,popcnt"))) inline size_t avx2Bound64(const Key *keys, size_t count, Key key) {
+    const Key *base = narrow<UPPER>(keys, count, key, 8);
+    const long long bias = std::is_unsigned_v<Key> ? INT64_MIN : 0;
+    __m256i lanes = _mm256_setr_epi64x(0, 1, 2, 3);
+    __m256i lowMask = _mm256_cmpgt_epi64(_mm256_set1_epi64x(static_cast<long long>(count)), lanes);
+    __m256i highMask = _mm256_cmpgt_epi64(_mm256_set1_epi64x(static_cast<long long>(count) - 4), lanes);
+    __m256i flip = _mm256_set1_epi64x(bias);
+    __m256i low = _mm256_xor_si256(_mm256_maskload_epi64(reinterpret_cast<const long long *>(base), lowMask), flip);
+    __m256i high = _mm256_xor_si256(_mm256_maskload_epi64(reinterpret_cast<const long long *>(base + 4), highMask), flip);
+    __m256i needle = _mm256_set1_epi64x(static_cast<long long>(key) ^ bias);
+    __m256i lowHit, highHit;
+    if constexpr (UPPER) {
+        lowHit = _mm256_andnot_si256(_mm256_cmpgt_epi64(low, needle), lowMask);
+        highHit = _mm256_andnot_si256(_mm256_cmpgt_epi64(high, needle), highMask);
+    } else {
+        lowHit = _mm256_and_si256(_mm256_cmpgt_epi64(needle, low), lowMask);
+        highHit = _mm256_and_si256(_mm256_cmpgt_epi64(needle, high), highMask);
+    }
+    unsigned bits = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(lowHit))) |
+                    static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(highHit))) << 4;
+    return static_cast<size_t>(base - keys) + static_cast<size_t>(_mm_popcnt_u32(bits));
+}
+
+inline size_t sse4LowerBound(const int32_t *keys, size_t count, int32_t key) {
+    return sse4Bound<false>(keys, count, key);
+}
+
+inline size_t sse4UpperBound(const int32_t *keys, size_t count, int32_t key) {
+    return sse4Bound<true>(keys, count, key);
+}
+
+template<typename Key>
+inline size_t avx2LowerBound(const Key *keys, size_t count, Key key) {
+    if constexpr (sizeof(Key) == 4) {
+        return avx2Bound32<false>(keys, count, key);
+    } else {
+        return avx2Bound64<false>(keys, count, key);
+    }
+}
+
+template<typename Key>
+inline size_t avx2UpperBound(const Key *keys, size_t count, Key key) {
+    if constexpr (sizeof(Key) == 4) {
+        return avx2Bound32<true>(keys, count, key);
+    } else {
+        return avx2Bound64<true>(keys, count, key);
+    }
+}
+
+#endif
+
+}
+
+// Every kernel this CPU can run for Key, from the scalar reference to the fastest
+template<typename Key = int32_t>
+inline std::vector<BasicSearchKernel<Key>> availableSearchKernels() {
+    static_assert(std::is_integral_v<Key> && (sizeof(Key) == 4 || sizeof(Key) == 8));
+    std::vector<BasicSearchKernel<Key>> kernels{
+        {"scalar", search_kernels::scalarLowerBound<Key>, search_kernels::scalarUpperBound<Key>},
+        {"binary", search_kernels::binaryLowerBound<Key>, search_kernels::binaryUpperBound<Key>}};
+#ifdef BPLUS_SQL_HAS_X86_KERNELS
+    __builtin_cpu_init();
+    if constexpr (std::is_same_v<Key, int32_t>) {
+        if (__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("popcnt")) {
+            kernels.push_back({"sse4", search_kernels::sse4LowerBound, search_kernels::sse4UpperBound});
+        }
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        kernels.push_back({"avx2", search_kernels::avx2LowerBound<Key>, search_kernels::avx2UpperBound<Key>});
+    }
+#endif
+    return kernels;
+}
+
+/// @brief Fastest kernel for this CPU, chosen on first use.
+/// Without SIMD support the branch-free binary search wins over the linear scan for full nodes.
+template<typename Key = int32_t>
+inline const BasicSearchKernel<Key> &searchKernel() {
+    static const BasicSearchKernel<Key> kernel = availableSearchKernels<Key>().back();
+    return kernel;
+}
+
+/// @brief In-node search for a tree keyed by KeyTraits.
+/// Any key type gets the branch-free binary search over KeyTraits::less.
+template<typename KeyTraits>
+class KeySearch {
+public:
+    using Key = typename KeyTraits::type;
+
+    size_t lowerBound(const Key *keys, size_t count, const Key &key) const {
+        return search_kernels::binaryBound<false>(keys, count, key, KeyTraits::less);
+    }
+
+    size_t upperBound(const Key *keys, size_t count, const Key &key) const {
+        return search_kernels::binaryBound<true>(keys, count, key, KeyTraits::less);
+    }
+};
+
+// Integer keys in native order use the kernel picked for this CPU
+template<typename Int>
+class KeySearch<IntegerKey<Int>> {
+public:
+    size_t lowerBound(const Int *keys, size_t count, Int key) const {
+        return m_kernel.lowerBound(keys, count, key);
+    }
+
+    size_t upperBound(const Int *keys, size_t count, Int key) const {
+        return m_kernel.upperBound(keys, count, key);
+    }
+
+private:
+    const BasicSearchKernel<Int> &m_kernel = searchKernel<Int>();
+};
+
+}
+
+#endif
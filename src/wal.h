@@ -0,0 +1,412 @@
+#ifndef __WAL_H__
+#define __WAL_H__
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BPLUS_SQL_POSIX_LOG 1
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BPLUS_SQL_HAS_X86_CRC 1
+#include <immintrin.h>
+#endif
+
+namespace bplus_sql {
+
+/// @brief Append-only redo log of one table.
+/// Records are buffered until write() hands them to the OS, or the buffer fills; commit() also waits for
+/// the device, and writers committing at the same time share one fdatasync (group commit).
+/// Besides insert and erase records the log holds page images: dirty pages evicted between checkpoints
+/// are parked here instead of in the table file, so the file only changes at checkpoints.
+/// Every record carries the generation of the checkpoint it follows, and a checksum.
+class WriteAheadLog {
+public:
+    enum class RecordType : uint8_t {
+        INSERT = 1,
+        ERASE = 2,
+        // Page id followed by the page
+        PAGE = 3,
+        // Tree state at a point in time: where its pages are, in the log or the table file
+        CHECKPOINT = 4
+    };
+
+    // Appended bytes held back before they are written out regardless
+    static constexpr size_t BUFFER_BYTES = 1ull << 16;
+    // The file is zero-filled this far ahead of the records, so syncing appended records does not
+    // also have to commit a new file size and block allocation
+    static constexpr uint64_t PREALLOCATE_BYTES = 1ull << 20;
+
+    struct Record {
+        RecordType type;
+        uint32_t generation;
+        // Log position of the record, and of its payload
+        uint64_t start;
+        uint64_t position;
+        // Only valid during the visit
+        std::span<const char> payload;
+    };
+
+    explicit WriteAheadLog(const std::string &fileName) : m_fileName(fileName) {
+#ifdef BPLUS_SQL_POSIX_LOG
+        m_fd = ::open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+#elif defined(_WIN32)
+        m_fd = ::_open(fileName.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#endif
+        if (m_fd < 0) {
+            throw std::runtime_error("Failed to open log: " + fileName);
+        }
+        struct stat st;
+        if (::fstat(m_fd, &st) == 0) {
+            m_allocated = static_cast<uint64_t>(st.st_size);
+        }
+    }
+
+    ~WriteAheadLog() {
+#ifdef BPLUS_SQL_POSIX_LOG
+        ::close(m_fd);
+#elif defined(_WIN32)
+        ::_close(m_fd);
+#endif
+    }
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    // Generation stamped on new records
+    uint32_t generation() const {
+        return m_generation;
+    }
+
+    // Log position after the last appended record
+    uint64_t end() {
+        std::lock_guard lock(m_mutex);
+        return m_appended;
+    }
+
+    // Buffer a record made of `size` bytes at `payload` followed by `extraSize` bytes at `extra`;
+    // returns the log position of its payload
+    uint64_t append(RecordType type, const void *payload, size_t size, const void *extra = nullptr, size_t extraSize = 0) {
+        std::lock_guard lock(m_mutex);
+        Header header{0, static_cast<uint32_t>(size + extraSize), m_generation, static_cast<uint8_t>(type), {}};
+        size_t start = m_buffer.size();
+        m_buffer.resize(start + sizeof(Header) + size + extraSize);
+        char *record = m_buffer.data() + start;
+        std::memcpy(record + sizeof(Header), payload, size);
+        if (extraSize > 0) {
+            std::memcpy(record + sizeof(Header) + size, extra, extraSize);
+        }
+        std::memcpy(record, &header, sizeof(Header));
+        header.checksum = crc32c(record + sizeof(uint32_t), sizeof(Header) - sizeof(uint32_t) + size + extraSize);
+        std::memcpy(record, &header, sizeof(uint32_t));
+        uint64_t position = m_appended + sizeof(Header);
+        m_appended += sizeof(Header) + size + extraSize;
+        if (m_buffer.size() >= BUFFER_BYTES) {
+            writeBuffer();
+        }
+        return position;
+    }
+
+    // Log a page and write it out, so readPage() can fetch it back; returns its log position
+    uint64_t appendPage(size_t pageId, const char *data, size_t pageSize) {
+        uint64_t id = pageId;
+        uint64_t position = append(RecordType::PAGE, &id, sizeof(id), data, pageSize) + sizeof(id);
+        write(position);
+        return position;
+    }
+
+    void readPage(uint64_t position, char *data, size_t pageSize) {
+        if (!readAt(position, data, pageSize)) {
+            throw std::runtime_error("Failed to read a logged page from " + m_fileName);
+        }
+    }
+
+    // Hand the records before `position` to the OS
+    void write(uint64_t position) {
+        std::lock_guard lock(m_mutex);
+        if (m_written < position) {
+            writeBuffer();
+        }
+    }
+
+    /// @brief write(position), then wait until the device holds every record before it.
+    /// The first caller to find no fdatasync running starts one for everything written so far; callers
+    /// arriving meanwhile wait, and are covered by it or by the next one, which again serves them all.
+    void commit(uint64_t position) {
+        write(position);
+        std::unique_lock lock(m_mutex);
+        while (m_durable < position) {
+            if (m_syncing) {
+                m_synced.wait(lock);
+                continue;
+            }
+            m_syncing = true;
+            uint64_t target = m_written;
+            lock.unlock();
+            try {
+                syncFile();
+            } catch (...) {
+                // Hand the sync over to a waiter, which retries it or runs into the same error
+                lock.lock();
+                m_syncing = false;
+                m_synced.notify_all();
+                throw;
+            }
+            lock.lock();
+            m_syncing = false;
+            m_durable = std::max(m_durable, target);
+            m_syncs++;
+            m_synced.notify_all();
+        }
+    }
+
+    // fdatasync calls made by commit()
+    uint64_t syncCount() {
+        std::lock_guard lock(m_mutex);
+        return m_syncs;
+    }
+
+    /// @brief Visit the intact records from the one starting at `from`, until `visit` returns false.
+    /// Returns the end of the last record `visit` accepted. Whatever follows the last intact record is
+    /// a write torn by a crash, see truncate().
+    uint64_t scan(uint64_t from, const std::function<bool(const Record &)> &visit) {
+        std::lock_guard lock(m_mutex);
+        uint64_t position = from;
+        std::vector<char> payload;
+        while (true) {
+            Header header;
+            // Zero-filled space ahead of the records holds no record type
+            if (!readAt(position, &header, sizeof(Header)) || header.type == 0) {
+                break;
+            }
+            payload.resize(header.size);
+            if (!readAt(position + sizeof(Header), payload.data(), header.size)) {
+                break;
+            }
+            uint32_t checksum = crc32c(reinterpret_cast<const char *>(&header) + sizeof(uint32_t), sizeof(Header) - sizeof(uint32_t));
+            if (crc32c(payload.data(), payload.size(), checksum) != header.checksum) {
+                break;
+            }
+            Record record{static_cast<RecordType>(header.type), header.generation, position, position + sizeof(Header), payload};
+            if (!visit(record)) {
+                break;
+            }
+            position += sizeof(Header) + header.size;
+        }
+        return position;
+    }
+
+    // Cut the log off at `position`, as returned by scan(); new records are appended from there
+    void truncate(uint64_t position) {
+        std::lock_guard lock(m_mutex);
+        truncateFile(position);
+        m_appended = m_written = m_durable = m_allocated = position;
+        m_buffer.clear();
+    }
+
+    // Drop every record once a checkpoint made them redundant; later records get `generation`
+    void reset(uint32_t generation, bool toDevice) {
+        std::lock_guard lock(m_mutex);
+        truncateFile(0);
+        if (toDevice) {
+            syncFile();
+        }
+        m_generation = generation;
+        m_appended = m_written = m_durable = m_allocated = 0;
+        m_buffer.clear();
+    }
+
+    // Generation of the records a new or reopened log continues with
+    void setGeneration(uint32_t generation) {
+        std::lock_guard lock(m_mutex);
+        m_generation = generation;
+    }
+
+    // CRC-32C (Castagnoli), continuing from `crc` to checksum data in pieces.
+    // Uses the SSE4.2 crc32 instruction when the CPU has it, as page images are checksummed too.
+    static uint32_t crc32c(const char *data, size_t size, uint32_t crc = 0) {
+#ifdef BPLUS_SQL_HAS_X86_CRC
+        static const bool hardware = [] {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.2") != 0;
+        }();
+        if (hardware) {
+            return hardwareCrc32c(data, size, crc);
+        }
+#endif
+        static const std::array<uint32_t, 256> table = [] {
+            std::array<uint32_t, 256> entries{};
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    value = (value >> 1) ^ (value & 1 ? 0x82F63B78u : 0);
+                }
+                entries[i] = value;
+            }
+            return entries;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+private:
+#ifdef BPLUS_SQL_HAS_X86_CRC
+    __attribute__((target("sse4.2"))) static uint32_t hardwareCrc32c(const char *data, size_t size, uint32_t crc) {
+        crc = ~crc;
+#ifdef __x86_64__
+        uint64_t wide = crc;
+        for (; size >= 8; data += 8, size -= 8) {
+            uint64_t chunk;
+            std::memcpy(&chunk, data, sizeof(chunk));
+            wide = _mm_crc32_u64(wide, chunk);
+        }
+        crc = static_cast<uint32_t>(wide);
+#endif
+        for (; size > 0; ++data, --size) {
+            crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*data));
+        }
+        return ~crc;
+    }
+#endif
+
+    // Called with m_mutex held
+    void writeBuffer() {
+        if (m_buffer.empty()) {
+            return;
+        }
+        if (m_written + m_buffer.size() > m_allocated) {
+            std::vector<char> zeros(BUFFER_BYTES, 0);
+            uint64_t target = (m_written + m_buffer.size() + PREALLOCATE_BYTES - 1) / PREALLOCATE_BYTES * PREALLOCATE_BYTES;
+            for (uint64_t position = std::max(m_allocated, m_written); position < target; position += zeros.size()) {
+                writeAt(position, zeros.data(), std::min<uint64_t>(zeros.size(), target - position));
+            }
+            m_allocated = target;
+        }
+        writeAt(m_written, m_buffer.data(), m_buffer.size());
+        m_written += m_buffer.size();
+        m_buffer.clear();
+    }
+
+    struct Header {
+        // Covers the rest of the header and the payload
+        uint32_t checksum;
+        uint32_t size;
+        uint32_t generation;
+        uint8_t type;
+        uint8_t padding[3];
+    };
+
+    void writeAt(uint64_t position, const char *data, size_t size) {
+#ifdef BPLUS_SQL_POSIX_LOG
+        while (size > 0) {
+            ssize_t written = ::pwrite(m_fd, data, size, static_cast<off_t>(position));
+            if (written <= 0) {
+                throw std::runtime_error("Failed to write log: " + m_fileName);
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+            position += static_cast<uint64_t>(written);
+        }
+#elif defined(_WIN32)
+        std::lock_guard lock(m_seekMutex);
+        if (::_lseeki64(m_fd, static_cast<__int64>(position), SEEK_SET) < 0 || ::_write(m_fd, data, static_cast<unsigned>(size)) != static_cast<int>(size)) {
+            throw std::runtime_error("Failed to write log: " + m_fileName);
+        }
+#endif
+    }
+
+    // False if the file ends before `size` bytes were read
+    bool readAt(uint64_t position, void *data, size_t size) {
+        char *target = static_cast<char *>(data);
+#ifdef BPLUS_SQL_POSIX_LOG
+        while (size > 0) {
+            ssize_t read = ::pread(m_fd, target, size, static_cast<off_t>(position));
+            if (read <= 0) {
+                return false;
+            }
+            target += read;
+            size -= static_cast<size_t>(read);
+            position += static_cast<uint64_t>(read);
+        }
+        return true;
+#elif defined(_WIN32)
+        std::lock_guard lock(m_seekMutex);
+        return ::_lseeki64(m_fd, static_cast<__int64>(position), SEEK_SET) >= 0 && ::_read(m_fd, target, static_cast<unsigned>(size)) == static_cast<int>(size);
+#else
+        return false;
+#endif
+    }
+
+    void truncateFile(uint64_t size) {
+#ifdef BPLUS_SQL_POSIX_LOG
+        bool failed = ::ftruncate(m_fd, static_cast<off_t>(size)) != 0;
+#elif defined(_WIN32)
+        bool failed = ::_chsize_s(m_fd, static_cast<__int64>(size)) != 0;
+#else
+        bool failed = false;
+#endif
+        if (failed) {
+            throw std::runtime_error("Failed to truncate log: " + m_fileName);
+        }
+    }
+
+    void syncFile() {
+#if defined(__APPLE__)
+        bool failed = ::fsync(m_fd) != 0;
+#elif defined(BPLUS_SQL_POSIX_LOG)
+        bool failed = ::fdatasync(m_fd) != 0;
+#elif defined(_WIN32)
+        bool failed = ::_commit(m_fd) != 0;
+#else
+        bool failed = false;
+#endif
+        if (failed) {
+            throw std::runtime_error("Failed to sync log: " + m_fileName);
+        }
+    }
+
+    std::string m_fileName;
+    int m_fd = -1;
+    std::mutex m_mutex;
+#ifdef _WIN32
+    // _lseeki64 and _read/_write share the file position
+    std::mutex m_seekMutex;
+#endif
+    std::condition_variable m_synced;
+    // Records appended but not yet written
+    std::vector<char> m_buffer;
+    uint32_t m_generation = 0;
+    // Log positions: everything before m_written is with the OS, everything before m_durable on the device
+    uint64_t m_appended = 0;
+    uint64_t m_written = 0;
+    uint64_t m_durable = 0;
+    // File size, including the zero-filled space ahead of m_written
+    uint64_t m_allocated = 0;
+    bool m_syncing = false;
+    uint64_t m_syncs = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include "bplus_tree.h"
+#include "test_helpers.h"
+#include <cassert>
+#include <filesystem>
+#include <vector>
+
+using Bytes32 = bplus_sql::FixedBytesKey<32>;
+
+template<typename KeyTraits, typename MakeKey>
+void checkContents(bplus_sql::BasicBPlusTree<KeyTraits> &tree, const std::vector<int> &expected, MakeKey makeKey) {
+	using Key = typename KeyTraits::type;
+	auto it = expected.begin();
+	size_t visited = tree.scan(makeKey(0), makeKey(1 << 30), [&](const Key &key) {
+		assert(it != expected.end());
+		assert(sameKey<KeyTraits>(key, makeKey(*it)));
+		++it;
+		return true;
+	});
+	assert(visited == expected.size());
+}
+
+template<typename KeyTraits, typename MakeKey>
+void checkAscending(const std::filesystem::path &file, bplus_sql::SplitPolicy split, MakeKey makeKey) {
+	const int total = 300000;
+	std::vector<int> keys;
+	for(int i = 0; i < total; ++i) keys.push_back(2 * i);
+
+	std::filesystem::remove(file);
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string());
+		size_t next = 0;
+		tree.bulkLoad([&](typename KeyTraits::type &key) {
+			if(next == keys.size()) return false;
+			key = makeKey(keys[next++]);
+			return true;
+		});
+	}
+	uintmax_t loadedSize = std::filesystem::file_size(file);
+
+	std::filesystem::remove(file);
+	bplus_sql::TreeOptions options;
+	options.split = split;
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string(), options);
+		for(int key : keys) tree.insert(makeKey(key));
+		// Nearly every insert only touches the rightmost leaf instead of descending from the root
+		auto stats = tree.cacheStats();
+		assert(stats.hits + stats.misses < keys.size() + keys.size() / 10);
+		checkContents(tree, keys, makeKey);
+	}
+	// Left leaves are full, so the file is about as small as a bulk loaded one
+	assert(std::filesystem::file_size(file) <= loadedSize + loadedSize / 50);
+
+	{
+		// Fill the gaps from the top down, then drop the upper half so the rightmost leaf moves left
+		// and its old page is released
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string(), options);
+		for(int i = total - 1; i >= 0; --i) tree.insert(makeKey(2 * i + 1));
+		for(int key = total; key < 2 * total; ++key) assert(tree.erase(makeKey(key)));
+		std::vector<int> expected;
+		for(int key = 0; key < total; ++key) expected.push_back(key);
+		checkContents(tree, expected, makeKey);
+
+		// Ascending again starts from the new rightmost leaf
+		for(int key = 2 * total; key < 3 * total; ++key) {
+			tree.insert(makeKey(key));
+			expected.push_back(key);
+		}
+		tree.shrink();
+		for(int key = 3 * total; key < 3 * total + 5000; ++key) {
+			tree.insert(makeKey(key));
+			expected.push_back(key);
+		}
+		checkContents(tree, expected, makeKey);
+	}
+	std::filesystem::remove(file);
+}
+
+int main() {
+	auto file = std::filesystem::path(__FILE__).parent_path().parent_path() / "data" / "_test_for_append_split.bin";
+	auto intKey = [](int i) { return i; };
+	checkAscending<bplus_sql::Int32Key>(file, bplus_sql::SplitPolicy::HALVES, intKey);
+	checkAscending<bplus_sql::Int32Key>(file, bplus_sql::SplitPolicy::B_STAR, intKey);
+	// Wide keys give a deeper tree, so internal nodes are split at the end too
+	checkAscending<Bytes32>(file, bplus_sql::SplitPolicy::HALVES, [](int i) {
+		Bytes32::type key{};
+		for(int byte = 0; byte < 4; ++byte) key[byte] = static_cast<unsigned char>(i >> (24 - 8 * byte));
+		return key;
+	});
+	return 0;
+}
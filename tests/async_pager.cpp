@@ -0,0 +1,152 @@
+#include "bplus_tree.h"
+#include "pager.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <set>
+#include <vector>
+
+void fillPage(char *buffer, size_t pageId, size_t round) {
+	for(size_t offset = 0; offset < bplus_sql::Pager::PAGE_SIZE; offset += sizeof(size_t)) {
+		size_t value = pageId * 1000003 + round * 7919 + offset;
+		std::memcpy(buffer + offset, &value, sizeof(value));
+	}
+}
+
+bool checkPage(const char *buffer, size_t pageId, size_t round) {
+	std::vector<char> expected(bplus_sql::Pager::PAGE_SIZE);
+	fillPage(expected.data(), pageId, round);
+	return std::memcmp(buffer, expected.data(), expected.size()) == 0;
+}
+
+int main(int argc, char *argv[]) {
+	auto dst = std::filesystem::path(__FILE__).parent_path().parent_path() / "data" / "_test_for_async_pager.bin";
+	std::filesystem::remove(dst);
+	const size_t PAGES = 3 * bplus_sql::Pager::RING_ENTRIES + 5;
+	const size_t PAGE_SIZE = bplus_sql::Pager::PAGE_SIZE;
+
+	// Batches larger than the ring, in and out of page-aligned registered buffers, in any page order
+	{
+		bplus_sql::Pager pager(dst.string(), bplus_sql::Pager::Backend::URING);
+		char *frames = static_cast<char *>(::operator new(PAGES * PAGE_SIZE, std::align_val_t(PAGE_SIZE)));
+		// Refused only where there is no io_uring or RLIMIT_MEMLOCK is too low for the frames
+		bool registered = pager.registerBuffers(frames, PAGES * PAGE_SIZE);
+		if(!registered) std::cout << "Buffer registration refused, pages move unregistered" << std::endl;
+		std::vector<bplus_sql::Pager::PageTransfer> transfers;
+		for(size_t i = 0; i < PAGES; ++i) {
+			size_t pageId = (i * 37) % PAGES;
+			fillPage(frames + i * PAGE_SIZE, pageId, 1);
+			transfers.push_back({pageId, frames + i * PAGE_SIZE});
+		}
+		std::vector<int> completions(PAGES);
+		pager.writePages(transfers, [&](size_t i, bool ok) {
+			assert(ok);
+			completions[i]++;
+		});
+		for(int count : completions) assert(count == 1);
+
+		std::memset(frames, 0, PAGES * PAGE_SIZE);
+		std::fill(completions.begin(), completions.end(), 0);
+		pager.readPages(transfers, [&](size_t i, bool ok) {
+			assert(ok);
+			assert(checkPage(transfers[i].buffer, transfers[i].pageId, 1));
+			completions[i]++;
+		});
+		for(int count : completions) assert(count == 1);
+		// Every transfer went through the registered buffers when the kernel took them
+		assert(pager.fixedTransfers() == (registered ? 2 * PAGES : 0));
+
+		// Buffers outside the registered range work too
+		std::vector<char> loose(PAGE_SIZE);
+		fillPage(loose.data(), PAGES, 2);
+		bplus_sql::Pager::PageTransfer page{PAGES, loose.data()};
+		pager.writePages({&page, 1}, [](size_t, bool ok) { assert(ok); });
+		std::memset(loose.data(), 0, PAGE_SIZE);
+		pager.readPages({&page, 1}, [](size_t, bool ok) { assert(ok); });
+		assert(checkPage(loose.data(), PAGES, 2));
+		assert(pager.fixedTransfers() == (registered ? 2 * PAGES : 0));
+
+		// Pages past the end of the file read as zeros
+		page.pageId = 2 * PAGES;
+		pager.readPages({&page, 1}, [](size_t, bool ok) { assert(ok); });
+		assert(std::all_of(loose.begin(), loose.end(), [](char c) { return c == 0; }));
+		pager.sync();
+		::operator delete(frames, std::align_val_t(PAGE_SIZE));
+	}
+
+	// The file is the same whichever backend wrote it
+	{
+		bplus_sql::Pager pager(dst.string());
+		std::vector<char> buffer(PAGE_SIZE);
+		for(size_t pageId = 0; pageId < PAGES; ++pageId) {
+			pager.readPageData(pageId, buffer.data());
+			assert(checkPage(buffer.data(), pageId, 1));
+		}
+	}
+	std::filesystem::remove(dst);
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<int> ukey(1, 200000);
+	std::set<int> cmp;
+
+	// A table built through io_uring, with a cache small enough that searchMany reads many leaves together
+	bplus_sql::TreeOptions options;
+	options.asyncIo = true;
+	options.maxCacheBytes = 256 << 10;
+	{
+		bplus_sql::BPlusTree tree(dst.string(), options);
+		for(int i = 0; i < 50000; ++i) {
+			int v = ukey(rng);
+			tree.insert(v);
+			cmp.insert(v);
+		}
+		for(int v : cmp) assert(tree.search(v));
+	}
+	{
+		bplus_sql::BPlusTree tree(dst.string(), options);
+		std::vector<int> probes(4096);
+		std::unique_ptr<bool[]> found(new bool[probes.size()]);
+		for(int round = 0; round < 20; ++round) {
+			for(int &probe : probes) probe = ukey(rng);
+			size_t expectedHits = 0;
+			for(int probe : probes) expectedHits += cmp.contains(probe);
+			assert(tree.searchMany(probes, std::span<bool>(found.get(), probes.size())) == expectedHits);
+			for(size_t i = 0; i < probes.size(); ++i) assert(found[i] == cmp.contains(probes[i]));
+		}
+		assert(tree.cacheStats().misses > 0);
+		for(int i = 0; i < 20000; ++i) {
+			int v = ukey(rng);
+			tree.erase(v);
+			cmp.erase(v);
+		}
+	}
+
+	// The stream backend reads what io_uring wrote back, and the other way round through a write-ahead log
+	{
+		bplus_sql::BPlusTree tree(dst.string());
+		for(int v = 1; v <= 200000; ++v) assert(tree.search(v) == cmp.contains(v));
+	}
+	options.writeAheadLog = true;
+	options.checkpointPages = 64;
+	{
+		bplus_sql::BPlusTree tree(dst.string(), options);
+		for(int i = 0; i < 20000; ++i) {
+			int v = ukey(rng);
+			tree.insert(v);
+			cmp.insert(v);
+		}
+	}
+	{
+		bplus_sql::BPlusTree tree(dst.string());
+		for(int v = 1; v <= 200000; ++v) assert(tree.search(v) == cmp.contains(v));
+	}
+
+	removeTable(dst);
+	return 0;
+}
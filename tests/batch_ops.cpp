@@ -0,0 +1,121 @@
+#include "bplus_tree.h"
+#include "test_helpers.h"
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+using Bytes32 = bplus_sql::FixedBytesKey<32>;
+
+template<typename KeyTraits, typename MakeKey>
+void checkBatches(const std::filesystem::path &file, MakeKey makeKey) {
+	using Key = typename KeyTraits::type;
+	std::filesystem::remove(file);
+	std::mt19937 rng(99);
+	std::uniform_int_distribution<int> value(0, 400000);
+	std::set<int> expected;
+	auto checkContents = [&](bplus_sql::BasicBPlusTree<KeyTraits> &tree) {
+		auto it = expected.begin();
+		size_t visited = tree.scan(makeKey(0), makeKey(400000), [&](const Key &key) {
+			assert(it != expected.end());
+			assert(sameKey<KeyTraits>(key, makeKey(*it)));
+			++it;
+			return true;
+		});
+		assert(visited == expected.size());
+		for(int i = 0; i < 1000; ++i) {
+			int probe = value(rng);
+			assert(tree.search(makeKey(probe)) == expected.contains(probe));
+		}
+		// Unsorted probes with repeats, answered in the order they were asked
+		std::vector<Key> probes;
+		for(int i = 0; i < 5000; ++i) probes.push_back(i % 7 == 6 ? probes[i / 2] : makeKey(value(rng)));
+		auto found = std::make_unique<bool[]>(probes.size());
+		size_t hits = tree.searchMany(probes, std::span<bool>(found.get(), probes.size()));
+		size_t expectedHits = 0;
+		for(size_t i = 0; i < probes.size(); ++i) {
+			assert(found[i] == tree.search(probes[i]));
+			expectedHits += found[i];
+		}
+		assert(hits == expectedHits);
+	};
+
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string());
+		// One batch much larger than a node splits leaves and the root into many pieces at once
+		std::vector<Key> batch;
+		size_t fresh = 0;
+		for(int i = 0; i < 150000; ++i) {
+			int key = value(rng);
+			fresh += expected.insert(key).second;
+			batch.push_back(makeKey(key));
+		}
+		assert(tree.insertMany(batch) == fresh);
+		checkContents(tree);
+
+		// Batches of 10k with duplicates inside the batch and keys already present, mixed with single ops
+		for(int round = 0; round < 30; ++round) {
+			batch.clear();
+			std::vector<int> plain;
+			for(int i = 0; i < 10000; ++i) plain.push_back(value(rng));
+			for(int i = 0; i < 100; ++i) plain.push_back(plain[i]);
+			size_t changed = 0;
+			if(round % 3 == 2) {
+				for(int key : plain) changed += expected.erase(key);
+				for(int key : plain) batch.push_back(makeKey(key));
+				assert(tree.eraseMany(batch) == changed);
+			} else {
+				for(int key : plain) changed += expected.insert(key).second;
+				for(int key : plain) batch.push_back(makeKey(key));
+				assert(tree.insertMany(batch) == changed);
+			}
+			int single = value(rng);
+			tree.insert(makeKey(single));
+			expected.insert(single);
+			checkContents(tree);
+		}
+	}
+
+	// Erase almost everything in one batch, then the rest: the tree shrinks back to a single leaf
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string());
+		checkContents(tree);
+		std::vector<Key> batch;
+		std::vector<int> remaining;
+		for(int key : expected) {
+			if(key % 97 == 0) {
+				remaining.push_back(key);
+			} else {
+				batch.push_back(makeKey(key));
+			}
+		}
+		assert(tree.eraseMany(batch) == batch.size());
+		expected = std::set<int>(remaining.begin(), remaining.end());
+		checkContents(tree);
+		batch.clear();
+		for(int key : remaining) batch.push_back(makeKey(key));
+		assert(tree.eraseMany(batch) == batch.size());
+		expected.clear();
+		checkContents(tree);
+		assert(tree.insertMany(std::vector<Key>{}) == 0);
+		assert(tree.insertMany(batch) == batch.size());
+		expected = std::set<int>(remaining.begin(), remaining.end());
+		checkContents(tree);
+	}
+	std::filesystem::remove(file);
+}
+
+int main() {
+	auto file = std::filesystem::path(__FILE__).parent_path().parent_path() / "data" / "_test_for_batch_ops.bin";
+	checkBatches<bplus_sql::Int32Key>(file, [](int i) { return i; });
+	// Wide keys give a deeper tree, so internal nodes split into several pieces too
+	checkBatches<Bytes32>(file, [](int i) {
+		Bytes32::type key{};
+		for(int byte = 0; byte < 4; ++byte) key[byte] = static_cast<unsigned char>(i >> (24 - 8 * byte));
+		return key;
+	});
+	return 0;
+}
@@ -0,0 +1,198 @@
+#include "buffer_pool.h"
+#include "pager.h"
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <new>
+#include <random>
+
+// Count every heap allocation so the steady state can be checked for zero allocations
+static size_t g_allocations = 0;
+
+void *operator new(size_t size) {
+	g_allocations++;
+	if(void *p = std::malloc(size == 0 ? 1 : size)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	std::free(p);
+}
+
+using bplus_sql::BufferPool;
+
+// Same replacement loop as NodeManager::pinPage, without reading from disk
+uint32_t fetch(BufferPool &pool, uint32_t tenant, size_t pageId) {
+	std::unique_lock<std::mutex> lock(pool.mutex(tenant, pageId));
+	uint32_t frame = pool.lookup(tenant, pageId);
+	if(frame == BufferPool::NO_FRAME) {
+		frame = pool.acquireFrame(tenant, pageId, lock);
+		pool.install(frame, tenant, pageId);
+		*reinterpret_cast<size_t *>(pool.data(frame)) = pageId;
+	}
+	return frame;
+}
+
+int main() {
+	auto dir = std::filesystem::path(__FILE__).parent_path().parent_path() / "data";
+	auto fileA = dir / "_test_for_buffer_pool_a.bin", fileB = dir / "_test_for_buffer_pool_b.bin";
+	std::filesystem::remove(fileA);
+	std::filesystem::remove(fileB);
+	{
+		bplus_sql::Pager pagerA(fileA.string()), pagerB(fileB.string());
+
+		BufferPool pool(64);
+		assert(pool.capacity() == 64);
+		assert(reinterpret_cast<uintptr_t>(pool.data(0)) % bplus_sql::Pager::PAGE_SIZE == 0);
+		uint32_t a = pool.registerTenant(&pagerA);
+
+		// Strict LRU order: touching page 0 keeps it while page 1 becomes the victim
+		for(size_t pageId = 0; pageId < 64; ++pageId) fetch(pool, a, pageId);
+		assert(pool.size() == 64);
+		fetch(pool, a, 0);
+		assert(pool.pageId(pool.victim(a, 64)) == 1);
+
+		// Pinned frames are never chosen
+		uint32_t pinned = pool.lookup(a, 1);
+		pool.pin(pinned);
+		assert(pool.pageId(pool.victim(a, 64)) == 2);
+		pool.unpin(pinned);
+
+		// Random workload over more pages than frames, with no heap allocations once warmed up
+		std::mt19937 rng(42);
+		std::uniform_int_distribution<size_t> upage(0, 255);
+		size_t before = g_allocations;
+		for(int i = 0; i < 200000; ++i) {
+			size_t pageId = upage(rng);
+			uint32_t frame = fetch(pool, a, pageId);
+			assert(pool.pageId(frame) == pageId);
+			assert(*reinterpret_cast<size_t *>(pool.data(frame)) == pageId);
+		}
+		assert(g_allocations == before);
+		assert(pool.size() == 64);
+
+		// Every resident page is reachable through the page table
+		size_t resident = 0;
+		uint32_t frames[64];
+		pool.forEachFrame(a, [&](uint32_t frame) {
+			assert(resident < 64);
+			frames[resident++] = frame;
+		});
+		assert(resident == 64);
+		for(uint32_t frame : frames) assert(pool.lookup(a, pool.pageId(frame)) == frame);
+		pool.unregisterTenant(a);
+		assert(pool.size() == 0);
+
+		// Shared budget: A keeps its reserved minimum, B never grows past its maximum
+		a = pool.registerTenant(&pagerA, 32);
+		uint32_t b = pool.registerTenant(&pagerB, 0, 20);
+		for(size_t pageId = 0; pageId < 64; ++pageId) {
+			pool.markDirty(fetch(pool, a, pageId));
+		}
+		for(int i = 0; i < 10000; ++i) {
+			fetch(pool, b, upage(rng));
+			assert(pool.tenantSize(b) <= 20);
+		}
+		assert(pool.tenantSize(a) >= 32);
+		assert(pool.tenantSize(a) + pool.tenantSize(b) == 64);
+
+		// A's dirty pages that were evicted by B went to A's file
+		size_t evictedPage = 0;
+		while(pool.lookup(a, evictedPage) != BufferPool::NO_FRAME) evictedPage++;
+		char page[bplus_sql::Pager::PAGE_SIZE];
+		pagerA.readPageData(evictedPage, page);
+		assert(*reinterpret_cast<size_t *>(page) == evictedPage);
+
+		// A minimum the budget cannot cover is rejected
+		bool rejected = false;
+		try {
+			pool.registerTenant(&pagerB, 40);
+		} catch(const std::invalid_argument &) {
+			rejected = true;
+		}
+		assert(rejected);
+		pool.unregisterTenant(a);
+		pool.unregisterTenant(b);
+
+		// A table scanning through the pool replaces its own pages, not the ones another table keeps hitting,
+		// even when each of them is hit again only after more scanned pages than the pool holds
+		a = pool.registerTenant(&pagerA);
+		b = pool.registerTenant(&pagerB);
+		for(int round = 0; round < 2; ++round) {
+			for(size_t pageId = 0; pageId < 16; ++pageId) fetch(pool, b, pageId);
+		}
+		uint64_t hotMisses = pool.stats(b).misses;
+		for(size_t pageId = 0; pageId < 2000; ++pageId) {
+			fetch(pool, a, 1000 + pageId);
+			if(pageId % 10 == 0) fetch(pool, b, pageId / 10 % 16);
+		}
+		assert(pool.stats(b).misses == hotMisses && pool.tenantSize(b) == 16);
+		// Once the other table is idle its pages age out like any others
+		for(size_t pageId = 0; pageId < 200; ++pageId) fetch(pool, a, 5000 + pageId);
+		assert(pool.tenantSize(b) == 0 && pool.tenantSize(a) == 64);
+		pool.unregisterTenant(a);
+		pool.unregisterTenant(b);
+
+		// A sharded pool spreads the pages over shards with their own frames, and counts per shard
+		BufferPool sharded(256, bplus_sql::Pager::PAGE_SIZE, 4);
+		assert(sharded.shards() == 4);
+		a = sharded.registerTenant(&pagerA);
+		std::uniform_int_distribution<size_t> uwide(0, 1023);
+		before = g_allocations;
+		for(int i = 0; i < 200000; ++i) {
+			size_t pageId = uwide(rng);
+			uint32_t frame = fetch(sharded, a, pageId);
+			assert(frame < 256 && sharded.pageId(frame) == pageId);
+			assert(*reinterpret_cast<size_t *>(sharded.data(frame)) == pageId);
+		}
+		assert(g_allocations == before);
+		assert(sharded.size() == 256 && sharded.tenantSize(a) == 256);
+		auto shardStats = sharded.shardStats(a);
+		assert(shardStats.size() == 4);
+		uint64_t hits = 0, misses = 0;
+		for(const auto &stats : shardStats) {
+			assert(stats.hits > 0 && stats.misses > 0);
+			hits += stats.hits;
+			misses += stats.misses;
+		}
+		assert(hits + misses == 200000);
+		assert(sharded.stats(a).hits == hits && sharded.stats(a).misses == misses);
+
+		// The minimum is split over the shards, the maximum holds for the pool as a whole
+		b = sharded.registerTenant(&pagerB, 64, 128);
+		for(int i = 0; i < 10000; ++i) {
+			fetch(sharded, b, uwide(rng));
+			assert(sharded.tenantSize(b) <= 128);
+		}
+		for(int i = 0; i < 10000; ++i) fetch(sharded, a, uwide(rng));
+		assert(sharded.tenantSize(b) >= 64);
+		sharded.unregisterTenant(a);
+		sharded.unregisterTenant(b);
+		assert(sharded.size() == 0);
+
+		// Even with far more shards than the maximum, dirty pages included; a smaller maximum is raised to the floor
+		BufferPool wide(64 * 64, bplus_sql::Pager::PAGE_SIZE, 64);
+		assert(wide.shards() == 64);
+		a = wide.registerTenant(&pagerA, 0, 1);
+		b = wide.registerTenant(&pagerB, 0, BufferPool::MIN_TENANT_FRAMES);
+		for(int i = 0; i < 10000; ++i) {
+			fetch(wide, a, uwide(rng));
+			wide.markDirty(fetch(wide, b, uwide(rng)));
+			assert(wide.tenantSize(a) <= BufferPool::MIN_TENANT_FRAMES);
+			assert(wide.tenantSize(b) <= BufferPool::MIN_TENANT_FRAMES);
+		}
+		assert(wide.tenantSize(a) == BufferPool::MIN_TENANT_FRAMES && wide.tenantSize(b) == BufferPool::MIN_TENANT_FRAMES);
+		assert(wide.stats(b).writebacks > 0);
+		wide.unregisterTenant(a);
+		wide.unregisterTenant(b);
+	}
+	std::filesystem::remove(fileA);
+	std::filesystem::remove(fileB);
+	return 0;
+}
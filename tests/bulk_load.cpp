@@ -0,0 +1,125 @@
+#include "bplus_node.h"
+#include "bplus_tree.h"
+#include "pager.h"
+#include <cassert>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+// Keys 0, 3, 6, ... so that every gap can take an insert later
+void checkLoaded(bplus_sql::BPlusTree &tree, int count) {
+	for(int i = 0; i < count; ++i) {
+		assert(tree.search(3 * i));
+		assert(!tree.search(3 * i + 1));
+	}
+	int expected = 0;
+	tree.scan(-1, 3 * count, [&](int key) {
+		assert(key == 3 * expected);
+		expected++;
+		return true;
+	});
+	assert(expected == count);
+}
+
+// Every node but the root holds at least the minimum erases rely on; read straight from the file
+void checkOccupancy(const std::filesystem::path &file) {
+	bplus_sql::Pager pager(file.string());
+	// The metadata page starts with the root page id
+	size_t rootPageId = 0;
+	pager.readMetadata(rootPageId);
+	const bplus_sql::NodeLayout<int> layout(bplus_sql::Pager::PAGE_SIZE);
+	std::vector<char> page(bplus_sql::Pager::PAGE_SIZE);
+	auto visit = [&](auto &&self, size_t pageId, bool isRoot) -> void {
+		pager.readPageData(pageId, page.data());
+		const auto *node = reinterpret_cast<const bplus_sql::BPlusNode *>(page.data());
+		assert(isRoot || node->keyCount >= layout.minKeys(node));
+		if(node->isLeaf) return;
+		std::vector<size_t> children(layout.children(node), layout.children(node) + node->keyCount + 1);
+		for(size_t child : children) self(self, child, false);
+	};
+	visit(visit, rootPageId, true);
+}
+
+int main() {
+	auto file = std::filesystem::path(__FILE__).parent_path().parent_path() / "data" / "_test_for_bulk_load.bin";
+	// A 4K leaf holds 1020 int keys: cover empty, single-leaf, just-split and multi-level tables
+	const int counts[] = {0, 1, 1020, 1021, 1530, 2041, 100000, 400000};
+	for(double fillFactor : {1.0, 0.7, 0.5}) {
+		for(int count : counts) {
+			std::filesystem::remove(file);
+			{
+				bplus_sql::BPlusTree tree(file.string());
+				int next = 0;
+				size_t loaded = tree.bulkLoad([&](int &key) {
+					if(next == count) return false;
+					key = 3 * next++;
+					return true;
+				}, fillFactor);
+				assert(loaded == static_cast<size_t>(count));
+				checkLoaded(tree, count);
+			}
+			// Packed pages: one leaf per 1020 * fillFactor keys plus about one internal page per 340 leaves
+			size_t leaves = count / static_cast<int>(1020 * fillFactor) + 1;
+			assert(std::filesystem::file_size(file) <= (leaves + leaves / 100 + 3) * 4096);
+			checkOccupancy(file);
+			{
+				bplus_sql::BPlusTree tree(file.string());
+				checkLoaded(tree, count);
+				// The result is an ordinary tree: inserts and erases keep working
+				for(int i = 0; i < count; i += 7) assert(tree.insert(3 * i + 1));
+				for(int i = 0; i < count; i += 7) assert(tree.erase(3 * i + 1));
+				for(int i = 0; i < count; i += 2) assert(tree.erase(3 * i));
+				for(int i = 0; i < count; ++i) assert(tree.search(3 * i) == (i % 2 == 1));
+			}
+		}
+	}
+
+	// Iterator ranges work for every key type
+	std::filesystem::remove(file);
+	{
+		std::vector<uint64_t> keys;
+		for(uint64_t i = 0; i < 50000; ++i) keys.push_back(i << 40);
+		bplus_sql::BasicBPlusTree<bplus_sql::UInt64Key> tree(file.string());
+		assert(tree.bulkLoad(keys.begin(), keys.end(), 0.9) == keys.size());
+		for(uint64_t key : keys) assert(tree.search(key));
+		assert(!tree.search(1));
+	}
+
+	// Unordered input keeps the keys before it, a loaded table cannot be loaded again
+	std::filesystem::remove(file);
+	{
+		bplus_sql::BPlusTree tree(file.string());
+		std::vector<int> keys{1, 2, 3, 5, 4, 6};
+		bool rejected = false;
+		try {
+			tree.bulkLoad(keys.begin(), keys.end());
+		} catch(const std::invalid_argument &) {
+			rejected = true;
+		}
+		assert(rejected);
+		assert(tree.search(5) && !tree.search(4) && !tree.search(6));
+
+		rejected = false;
+		try {
+			tree.bulkLoad(keys.begin(), keys.begin());
+		} catch(const std::logic_error &) {
+			rejected = true;
+		}
+		assert(rejected);
+	}
+	std::filesystem::remove(file);
+	{
+		bplus_sql::BPlusTree tree(file.string());
+		bool rejected = false;
+		try {
+			std::vector<int> keys{1};
+			tree.bulkLoad(keys.begin(), keys.end(), 0.2);
+		} catch(const std::invalid_argument &) {
+			rejected = true;
+		}
+		assert(rejected);
+	}
+	std::filesystem::remove(file);
+	return 0;
+}
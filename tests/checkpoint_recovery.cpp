@@ -0,0 +1,178 @@
+#include "bplus_tree.h"
+#include "test_helpers.h"
+#include "wal.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#define CHECKPOINT_TEST_FORK 1
+#endif
+
+// Random inserts and erases seeded by `seed`; `expected` receives the resulting contents
+void modify(bplus_sql::BPlusTree *tree, std::set<int> &expected, unsigned seed, int count) {
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> ukey(0, 1 << 22);
+	for(int i = 0; i < count; ++i) {
+		int key = ukey(rng);
+		if(i % 5 == 0) {
+			if(tree) tree->erase(key);
+			expected.erase(key);
+		} else {
+			if(tree) tree->insert(key);
+			expected.insert(key);
+		}
+	}
+}
+
+size_t countCheckpoints(const std::filesystem::path &file) {
+	size_t checkpoints = 0;
+	bplus_sql::WriteAheadLog log(file.string() + ".wal");
+	log.scan(0, [&](const bplus_sql::WriteAheadLog::Record &record) {
+		checkpoints += record.type == bplus_sql::WriteAheadLog::RecordType::CHECKPOINT;
+		return true;
+	});
+	return checkpoints;
+}
+
+#ifdef CHECKPOINT_TEST_FORK
+// Run `work` in a child process, which has to kill itself with SIGKILL while its tables are open
+template<typename Work>
+void inKilledChild(Work work) {
+	pid_t child = fork();
+	assert(child >= 0);
+	if(child == 0) {
+		work();
+		_exit(0);
+	}
+	int status = 0;
+	waitpid(child, &status, 0);
+	assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+}
+
+// Checkpoints triggered by modified pages leave only a short tail of the log to replay
+void checkDirtyPageTrigger(const std::filesystem::path &file) {
+	const int count = 200000;
+	removeTable(file);
+	bplus_sql::TreeOptions options;
+	options.writeAheadLog = true;
+	options.maxCacheBytes = 256 << 10;
+	options.checkpointPages = 256;
+	options.checkpointSeconds = 0;
+	inKilledChild([&] {
+		bplus_sql::BPlusTree tree(file.string(), options);
+		std::set<int> expected;
+		modify(&tree, expected, 11, count);
+		tree.sync();
+		raise(SIGKILL);
+	});
+	std::set<int> expected;
+	modify(nullptr, expected, 11, count);
+	assert(countCheckpoints(file) > 10);
+
+	auto start = std::chrono::steady_clock::now();
+	bplus_sql::BPlusTree tree(file.string(), options);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	// Replaying every logged modification would visit a page per level for each of them
+	auto stats = tree.cacheStats();
+	assert(stats.hits + stats.misses < count / 10);
+	std::printf("recovered %d logged modifications in %.3f s, %llu page accesses\n", count, seconds,
+		static_cast<unsigned long long>(stats.hits + stats.misses));
+	checkContents(tree, expected);
+}
+
+// A checkpoint is also taken once enough time has passed, however little was modified
+void checkTimeTrigger(const std::filesystem::path &file) {
+	removeTable(file);
+	bplus_sql::TreeOptions options;
+	options.writeAheadLog = true;
+	options.checkpointPages = 0;
+	options.checkpointSeconds = 1;
+	inKilledChild([&] {
+		bplus_sql::BPlusTree tree(file.string(), options);
+		for(int key = 0; key < 100; ++key) tree.insert(key);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+		for(int key = 100; key < 200; ++key) tree.insert(key);
+		tree.sync();
+		raise(SIGKILL);
+	});
+	assert(countCheckpoints(file) == 1);
+	std::set<int> expected;
+	for(int key = 0; key < 200; ++key) expected.insert(key);
+	{
+		bplus_sql::BPlusTree tree(file.string(), options);
+		checkContents(tree, expected);
+	}
+
+	// Also when the table is no longer modified, which commits what it logged; with nothing logged since, once
+	removeTable(file);
+	inKilledChild([&] {
+		bplus_sql::BPlusTree tree(file.string(), options);
+		for(int key = 0; key < 100; ++key) tree.insert(key);
+		std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+		raise(SIGKILL);
+	});
+	assert(countCheckpoints(file) == 1);
+	expected.clear();
+	for(int key = 0; key < 100; ++key) expected.insert(key);
+	bplus_sql::BPlusTree tree(file.string(), options);
+	checkContents(tree, expected);
+}
+
+// The tables of a directory are recovered side by side, their logs left empty
+void checkParallelRecovery(const std::vector<std::filesystem::path> &files) {
+	std::vector<std::string> names;
+	for(const auto &file : files) {
+		removeTable(file);
+		names.push_back(file.string());
+	}
+	bplus_sql::TreeOptions options;
+	options.writeAheadLog = true;
+	options.maxCacheBytes = 256 << 10;
+	inKilledChild([&] {
+		std::vector<std::unique_ptr<bplus_sql::BPlusTree>> trees;
+		for(size_t i = 0; i < files.size(); ++i) {
+			trees.push_back(std::make_unique<bplus_sql::BPlusTree>(names[i], options));
+			std::set<int> expected;
+			modify(trees.back().get(), expected, static_cast<unsigned>(i), 50000);
+			trees.back()->sync();
+		}
+		raise(SIGKILL);
+	});
+	assert(bplus_sql::BPlusTree::recover(names, files.size()) == files.size());
+	for(size_t i = 0; i < files.size(); ++i) {
+		assert(std::filesystem::file_size(names[i] + ".wal") == 0);
+		std::set<int> expected;
+		modify(nullptr, expected, static_cast<unsigned>(i), 50000);
+		bplus_sql::BPlusTree tree(names[i]);
+		checkContents(tree, expected);
+	}
+	// Nothing is left to recover
+	assert(bplus_sql::BPlusTree::recover(names) == 0);
+}
+#endif
+
+int main() {
+#ifdef CHECKPOINT_TEST_FORK
+	auto data = std::filesystem::path(__FILE__).parent_path().parent_path() / "data";
+	std::vector<std::filesystem::path> files;
+	for(int i = 0; i < 4; ++i) {
+		files.push_back(data / ("_test_for_checkpoint_recovery_" + std::to_string(i) + ".bin"));
+	}
+	checkDirtyPageTrigger(files[0]);
+	checkTimeTrigger(files[0]);
+	checkParallelRecovery(files);
+	for(const auto &file : files) removeTable(file);
+#endif
+	return 0;
+}
@@ -0,0 +1,219 @@
+#include "bplus_tree.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int KEY_RANGE = 100000;
+const int APPENDED_BASE = 1 << 20;
+
+// Workers share the leaves but not the keys: worker `id` owns the even keys k with k / 2 % workers == id,
+// mixes lookups, inserts and erases of them and checks every lookup against its own std::set.
+// Meanwhile one thread appends new maxima and another keeps scanning the table, which must always
+// show the odd keys, loaded up front and never touched again, in ascending order.
+void checkMixed(const std::filesystem::path &file, const bplus_sql::TreeOptions &options, int workers, int ops) {
+	removeTable(file);
+	std::set<int> expected;
+	{
+		bplus_sql::BPlusTree tree(file.string(), options);
+		std::vector<int> fixed;
+		for(int key = 1; key < KEY_RANGE; key += 2) fixed.push_back(key);
+		tree.insertMany(fixed);
+		expected.insert(fixed.begin(), fixed.end());
+
+		std::vector<std::set<int>> owned(workers);
+		std::atomic<int> running = workers + 1;
+		std::vector<std::thread> threads;
+		for(int id = 0; id < workers; ++id) {
+			threads.emplace_back([&, id] {
+				std::mt19937 rng(id);
+				std::uniform_int_distribution<int> ukey(0, KEY_RANGE / 2 / workers - 1), uop(0, 2);
+				std::set<int> &mine = owned[id];
+				for(int i = 0; i < ops; ++i) {
+					int key = 2 * (ukey(rng) * workers + id);
+					assert(tree.search(key) == mine.contains(key));
+					// Mostly inserts in the first half, mostly erases in the second, so leaves split and merge
+					bool inserting = (uop(rng) == 0) == (i >= ops / 2);
+					if(inserting) {
+						tree.insert(key);
+						mine.insert(key);
+					} else {
+						assert(tree.erase(key) == mine.contains(key));
+						mine.erase(key);
+					}
+				}
+				running--;
+			});
+		}
+		threads.emplace_back([&] {
+			for(int i = 0; i < ops; ++i) {
+				tree.insert(APPENDED_BASE + i);
+			}
+			running--;
+		});
+		size_t scans = 0;
+		while(running > 0) {
+			int previous = std::numeric_limits<int>::min();
+			size_t fixedSeen = 0;
+			tree.scan(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), [&](const int &key) {
+				assert(key > previous);
+				previous = key;
+				fixedSeen += key % 2 != 0 && key < KEY_RANGE;
+				return true;
+			});
+			assert(fixedSeen == fixed.size());
+			scans++;
+		}
+		for(auto &thread : threads) thread.join();
+		std::printf("%d workers, %d operations each, %zu full scans alongside\n", workers, ops, scans);
+
+		for(const auto &mine : owned) expected.insert(mine.begin(), mine.end());
+		for(int i = 0; i < ops; ++i) expected.insert(APPENDED_BASE + i);
+		checkContents(tree, expected);
+	}
+	bplus_sql::BPlusTree tree(file.string(), options);
+	checkContents(tree, expected);
+}
+
+// Readers look up the odd keys, which never change, while a writer keeps inserting and erasing the even
+// ones around them, splitting and merging their leaves. Lookups latch nothing, so none may miss a key a
+// split or merge was moving at the time, and none waits for the writer.
+void checkReadMostly(const std::filesystem::path &file, const bplus_sql::TreeOptions &options, int readers, int lookups) {
+	removeTable(file);
+	bplus_sql::BPlusTree tree(file.string(), options);
+	std::vector<int> fixed;
+	for(int key = 1; key < KEY_RANGE; key += 2) fixed.push_back(key);
+	tree.insertMany(fixed);
+
+	std::atomic<bool> stop = false;
+	size_t writes = 0;
+	std::thread writer([&] {
+		std::mt19937 rng(42);
+		std::uniform_int_distribution<int> ukey(0, KEY_RANGE / 2 - 1);
+		// Whole runs of neighbouring keys at a time, so that leaves fill up and empty out
+		while(!stop) {
+			int first = 2 * ukey(rng);
+			for(int key = first; key < first + 4000 && key < KEY_RANGE; key += 2, ++writes) tree.insert(key);
+			for(int key = first; key < first + 4000 && key < KEY_RANGE; key += 2, ++writes) tree.erase(key);
+		}
+	});
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for(int id = 0; id < readers; ++id) {
+		threads.emplace_back([&, id] {
+			std::mt19937 rng(id);
+			std::uniform_int_distribution<int> ukey(0, KEY_RANGE / 2 - 1);
+			std::vector<int> batch(32);
+			bool found[32];
+			for(int i = 0; i < lookups; ++i) {
+				assert(tree.search(2 * ukey(rng) + 1));
+				if(i % 64 == 0) {
+					for(int &key : batch) key = 2 * ukey(rng) + 1;
+					assert(tree.searchMany(batch, found) == batch.size());
+				}
+			}
+		});
+	}
+	for(auto &thread : threads) thread.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	stop = true;
+	writer.join();
+	std::printf("%d readers: %.2f M lookups/s alongside %zu writes\n", readers, readers * static_cast<double>(lookups) / seconds / 1e6, writes);
+
+	std::set<int> expected(fixed.begin(), fixed.end());
+	checkContents(tree, expected);
+}
+
+// Lookups take no latches, so their throughput grows with the threads as long as there are cores to run them
+void benchLookups(const std::filesystem::path &file) {
+	removeTable(file);
+	const int count = 1000000;
+	const int lookups = 500000;
+	bplus_sql::BPlusTree tree(file.string());
+	int next = 0;
+	tree.bulkLoad([&](int &key) {
+		if(next == count) {
+			return false;
+		}
+		key = 2 * next++;
+		return true;
+	});
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	double single = 0;
+	for(unsigned threads = 1;; threads = std::min(2 * threads, cores)) {
+		std::atomic<size_t> found = 0;
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for(unsigned id = 0; id < threads; ++id) {
+			workers.emplace_back([&, id] {
+				std::mt19937 rng(id);
+				std::uniform_int_distribution<int> ukey(0, 2 * count - 1);
+				size_t hits = 0;
+				for(int i = 0; i < lookups; ++i) {
+					int key = ukey(rng);
+					bool hit = tree.search(key);
+					assert(hit == (key % 2 == 0));
+					hits += hit;
+				}
+				found += hits;
+			});
+		}
+		for(auto &worker : workers) worker.join();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double rate = threads * static_cast<double>(lookups) / seconds;
+		if(threads == 1) single = rate;
+		assert(found > 0);
+		std::printf("%u lookup threads: %.2f M lookups/s, %.2fx one thread\n", threads, rate / 1e6, rate / single);
+		if(threads == cores) break;
+	}
+}
+
+int main() {
+	auto file = std::filesystem::path(__FILE__).parent_path().parent_path() / "data" / "_test_for_concurrent_pressure.bin";
+	int workers = static_cast<int>(std::clamp(std::thread::hardware_concurrency(), 4u, 16u));
+
+	bplus_sql::TreeOptions options;
+	checkMixed(file, options, workers, 40000);
+
+	// Small nodes cache, so pages are read in and evicted while other threads wait on their latches
+	options.maxCacheBytes = 512 << 10;
+	options.split = bplus_sql::SplitPolicy::B_STAR;
+	checkMixed(file, options, workers, 40000);
+
+	// Group commits, and checkpoints that need the tree to themselves
+	bplus_sql::TreeOptions logged;
+	logged.writeAheadLog = true;
+	logged.durability = bplus_sql::Durability::EVERY_N_OPS;
+	logged.syncInterval = 500;
+	logged.checkpointPages = 64;
+	checkMixed(file, logged, workers, 20000);
+
+	// Misses of different threads read side by side, and writebacks go to the kernel in batches
+	bplus_sql::TreeOptions async;
+	async.asyncIo = true;
+	async.maxCacheBytes = 512 << 10;
+	checkMixed(file, async, workers, 20000);
+
+#if defined(__unix__) || defined(__APPLE__)
+	bplus_sql::TreeOptions mapped;
+	mapped.useMmap = true;
+	checkMixed(file, mapped, workers, 40000);
+#endif
+
+	checkReadMostly(file, bplus_sql::TreeOptions{}, 2 * workers, 100000);
+	checkReadMostly(file, options, 2 * workers, 50000);
+
+	benchLookups(file);
+	removeTable(file);
+	return 0;
+}
@@ -0,0 +1,94 @@
+#include "bplus_tree.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using Bytes32 = bplus_sql::FixedBytesKey<32>;
+
+// Pages read by a lookup in a freshly opened table, i.e. the height of the tree
+template<typename KeyTraits>
+uint64_t coldLookupReads(const std::filesystem::path &file, const typename KeyTraits::type &key) {
+	bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string());
+	tree.search(key);
+	return tree.cacheStats().misses;
+}
+
+template<typename KeyTraits, typename MakeKey>
+void checkShrink(const std::filesystem::path &file, MakeKey makeKey) {
+	using Key = typename KeyTraits::type;
+	const int total = 200000;
+	std::vector<int> order(total);
+	std::iota(order.begin(), order.end(), 0);
+	std::shuffle(order.begin(), order.end(), std::mt19937(11));
+
+	std::filesystem::remove(file);
+	size_t fullSize;
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string());
+		for(int i : order) tree.insert(makeKey(i));
+		tree.sync();
+		fullSize = std::filesystem::file_size(file);
+
+		// Keep every 50th key
+		for(int i : order) {
+			if(i % 50 != 0) assert(tree.erase(makeKey(i)));
+		}
+		for(int i = 0; i < total; ++i) assert(tree.search(makeKey(i)) == (i % 50 == 0));
+		int expected = 0;
+		tree.scan(makeKey(0), makeKey(total), [&](const Key &key) {
+			assert(sameKey<KeyTraits>(key, makeKey(expected)));
+			expected += 50;
+			return true;
+		});
+		assert(expected == total);
+
+		// Merged pages are reused, so as many new keys fit without growing the file much
+		for(int i : order) {
+			if(i % 50 != 0) tree.insert(makeKey(total + i));
+		}
+		tree.sync();
+		assert(std::filesystem::file_size(file) < fullSize + fullSize / 4);
+		for(int i : order) {
+			if(i % 50 != 0) assert(tree.erase(makeKey(total + i)));
+		}
+	}
+	uint64_t shrunkReads = coldLookupReads<KeyTraits>(file, makeKey(total / 2));
+
+	// A table built from just the remaining keys is no shallower
+	std::filesystem::remove(file);
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string());
+		for(int i : order) {
+			if(i % 50 == 0) tree.insert(makeKey(i));
+		}
+	}
+	assert(shrunkReads <= coldLookupReads<KeyTraits>(file, makeKey(total / 2)));
+
+	// Erasing everything collapses the tree to a single leaf
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string());
+		for(int i = 0; i < total; i += 50) assert(tree.erase(makeKey(i)));
+		assert(!tree.search(makeKey(0)));
+		assert(tree.scan(makeKey(0), makeKey(total), [](const Key &) { return true; }) == 0);
+		assert(tree.insert(makeKey(7)));
+	}
+	assert(coldLookupReads<KeyTraits>(file, makeKey(7)) == 1);
+	std::filesystem::remove(file);
+}
+
+int main() {
+	auto file = std::filesystem::path(__FILE__).parent_path().parent_path() / "data" / "_test_for_erase_rebalance.bin";
+	checkShrink<bplus_sql::Int32Key>(file, [](int i) { return i; });
+	// Wide keys give a deeper tree, so internal nodes are merged and redistributed too
+	checkShrink<Bytes32>(file, [](int i) {
+		Bytes32::type key{};
+		for(int byte = 0; byte < 4; ++byte) key[byte] = static_cast<unsigned char>(i >> (24 - 8 * byte));
+		return key;
+	});
+	return 0;
+}
@@ -0,0 +1,90 @@
+#include "bplus_tree.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <cassert>
+#include <filesystem>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using Bytes32 = bplus_sql::FixedBytesKey<32>;
+
+template<typename KeyTraits, typename MakeKey>
+void checkFreePages(const std::filesystem::path &file, bool useMmap, int total, MakeKey makeKey) {
+	using Key = typename KeyTraits::type;
+	bplus_sql::TreeOptions options;
+	options.useMmap = useMmap;
+	std::vector<int> order(total);
+	std::iota(order.begin(), order.end(), 0);
+	std::shuffle(order.begin(), order.end(), std::mt19937(5));
+	auto kept = [](int i) { return i % 20 == 0; };
+	auto checkKeys = [&](bplus_sql::BasicBPlusTree<KeyTraits> &tree) {
+		for(int i = 0; i < total; ++i) assert(tree.search(makeKey(i)) == kept(i));
+		int expected = 0;
+		tree.scan(makeKey(0), makeKey(total), [&](const Key &key) {
+			assert(sameKey<KeyTraits>(key, makeKey(expected)));
+			expected += 20;
+			return true;
+		});
+		assert(expected == total);
+	};
+
+	std::filesystem::remove(file);
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string(), options);
+		for(int i : order) tree.insert(makeKey(i));
+		for(int i : order) {
+			if(!kept(i)) tree.erase(makeKey(i));
+		}
+	}
+	size_t churnedSize = std::filesystem::file_size(file);
+
+	// The free list survives reopening: the same number of new keys fits into the released pages
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string(), options);
+		for(int i : order) {
+			if(!kept(i)) tree.insert(makeKey(total + i));
+		}
+		tree.sync();
+		assert(std::filesystem::file_size(file) < churnedSize + churnedSize / 4);
+		for(int i : order) {
+			if(!kept(i)) tree.erase(makeKey(total + i));
+		}
+		checkKeys(tree);
+
+		// Every released page is cut off the end of the file, then there is nothing left to give back
+		tree.sync();
+		size_t sizeBefore = std::filesystem::file_size(file);
+		size_t released = tree.shrink();
+		assert(released > 0);
+		assert(std::filesystem::file_size(file) == sizeBefore - released * 4096);
+		assert(tree.shrink() == 0);
+		checkKeys(tree);
+		tree.insert(makeKey(total + 1));
+		tree.erase(makeKey(total + 1));
+	}
+
+	// A table of one key in twenty is about a twentieth of the size after shrinking
+	size_t shrunkSize = std::filesystem::file_size(file);
+	assert(shrunkSize < churnedSize / 8);
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string(), options);
+		checkKeys(tree);
+	}
+	assert(std::filesystem::file_size(file) == shrunkSize);
+	std::filesystem::remove(file);
+}
+
+int main() {
+	auto file = std::filesystem::path(__FILE__).parent_path().parent_path() / "data" / "_test_for_free_pages.bin";
+	for(bool useMmap : {false, true}) {
+		checkFreePages<bplus_sql::Int32Key>(file, useMmap, 300000, [](int i) { return i; });
+	}
+	// Wide keys give a deeper tree, so moved pages are found through several levels
+	checkFreePages<Bytes32>(file, false, 300000, [](int i) {
+		Bytes32::type key{};
+		for(int byte = 0; byte < 4; ++byte) key[byte] = static_cast<unsigned char>(i >> (24 - 8 * byte));
+		return key;
+	});
+	return 0;
+}
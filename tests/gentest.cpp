@@ -26,6 +26,22 @@ int main() {
         } else {
             std::cout << "QUERY FROM " << DB_NAME << " KEY " << k << '\n';
         }
+        if (i % 1000 == 999) {
+            std::cout << "QUERY FROM " << DB_NAME << " RANGE " << k << ' ' << k + k % 500 << '\n';
+        }
+        if (i % 1000 == 499) {
+            std::cout << "QUERY FROM " << DB_NAME << " KEYS " << k;
+            for (int j = 1; j < 200; ++j) {
+                std::cout << ',' << keydist(rng);
+            }
+            std::cout << '\n';
+        }
+        if (i % 10000 == 9999) {
+            std::cout << "SYNC TABLE " << DB_NAME << '\n';
+        }
+        if (i % 25000 == 24999) {
+            std::cout << "SHRINK TABLE " << DB_NAME << '\n';
+        }
     }
 
     std::cout << "DESTROY TABLE " << DB_NAME << '\n';
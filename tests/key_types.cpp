@@ -0,0 +1,74 @@
+#include "bplus_tree.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using Bytes16 = bplus_sql::FixedBytesKey<16>;
+
+// Keys are spread over the whole range so the sign and high bits matter
+template<typename KeyTraits, typename MakeKey>
+void checkTree(const std::filesystem::path &file, MakeKey makeKey) {
+	using Key = typename KeyTraits::type;
+	std::filesystem::remove(file);
+	std::vector<Key> keys;
+	for(uint64_t i = 0; i < 60000; ++i) keys.push_back(makeKey(i));
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(7));
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string());
+		for(const Key &key : keys) assert(tree.insert(key));
+		for(size_t i = 0; i < keys.size(); i += 3) assert(tree.erase(keys[i]));
+	}
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string());
+		for(size_t i = 0; i < keys.size(); ++i) assert(tree.search(keys[i]) == (i % 3 != 0));
+		assert(!tree.search(makeKey(60000)));
+	}
+}
+
+int main() {
+	auto file = std::filesystem::path(__FILE__).parent_path().parent_path() / "data" / "_test_for_key_types.bin";
+
+	checkTree<bplus_sql::Int64Key>(file, [](uint64_t i) { return static_cast<int64_t>(i * 0x9E3779B97F4A7C15ull); });
+	checkTree<bplus_sql::UInt64Key>(file, [](uint64_t i) { return i * 0x9E3779B97F4A7C15ull; });
+	checkTree<Bytes16>(file, [](uint64_t i) {
+		Bytes16::type key{};
+		uint64_t mixed = i * 0x9E3779B97F4A7C15ull;
+		std::memcpy(key.data(), &mixed, sizeof(mixed));
+		std::memcpy(key.data() + 8, &i, sizeof(i));
+		return key;
+	});
+
+	// Normalized bytes compare like the keys themselves
+	const int64_t ordered[] = {INT64_MIN, -256, -1, 0, 1, 255, 256, INT64_MAX};
+	for(size_t i = 0; i + 1 < std::size(ordered); ++i) {
+		unsigned char a[8], b[8];
+		bplus_sql::Int64Key::normalize(ordered[i], a);
+		bplus_sql::Int64Key::normalize(ordered[i + 1], b);
+		assert(std::memcmp(a, b, 8) < 0);
+	}
+
+	// A table remembers the width of its keys
+	std::filesystem::remove(file);
+	{
+		bplus_sql::BPlusTree tree(file.string());
+		assert(tree.insert(1));
+	}
+	bool rejected = false;
+	try {
+		bplus_sql::BasicBPlusTree<bplus_sql::Int64Key> tree(file.string());
+	} catch(const std::runtime_error &) {
+		rejected = true;
+	}
+	assert(rejected);
+	{
+		bplus_sql::BPlusTree tree(file.string());
+		assert(tree.search(1));
+	}
+	std::filesystem::remove(file);
+	return 0;
+}
@@ -0,0 +1,68 @@
+#include "bplus_tree.h"
+#include "pager.h"
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <set>
+
+int main(int argc, char *argv[]) {
+	auto dst = std::filesystem::path(__FILE__).parent_path().parent_path() / "data" / "_test_for_mmap.bin";
+	std::filesystem::remove(dst);
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<int> ukey(1, 200000);
+	std::set<int> cmp;
+
+	// Build the table through the mapping
+	{
+		bplus_sql::TreeOptions options;
+		options.useMmap = true;
+		bplus_sql::BPlusTree tree(dst.string(), options);
+		for(int i = 0; i < 50000; ++i) {
+			int v = ukey(rng);
+			tree.insert(v);
+			cmp.insert(v);
+		}
+		for(int v : cmp) assert(tree.search(v));
+	}
+	// The file grows an extent at a time while mapped, and is cut back to its last page on close
+	size_t builtSize = std::filesystem::file_size(dst);
+	assert(builtSize % bplus_sql::Pager::PAGE_SIZE == 0 && builtSize < bplus_sql::Pager::MMAP_EXTENT);
+
+	// The on-disk layout is shared, so the stream backend reads the same file
+	{
+		bplus_sql::BPlusTree tree(dst.string());
+		for(int v : cmp) assert(tree.search(v));
+		for(int i = 0; i < 20000; ++i) {
+			int v = ukey(rng);
+			tree.erase(v);
+			cmp.erase(v);
+		}
+	}
+
+	{
+		bplus_sql::TreeOptions options;
+		options.useMmap = true;
+		bplus_sql::BPlusTree tree(dst.string(), options);
+		for(int v = 1; v <= 200000; ++v) assert(tree.search(v) == cmp.contains(v));
+	}
+
+	// Page addresses handed out by the pager stay valid while the mapping grows
+	bool mapped = false;
+	if(bplus_sql::Pager pager(dst.string(), bplus_sql::Pager::Backend::MMAP); pager.isMapped()) {
+		mapped = true;
+		char *first = pager.pageData(0);
+		char saved[16];
+		std::memcpy(saved, first, sizeof(saved));
+		pager.pageData(bplus_sql::Pager::MMAP_EXTENT / bplus_sql::Pager::PAGE_SIZE * 2);
+		assert(std::memcmp(first, saved, sizeof(saved)) == 0);
+		assert(pager.getFileSize() > bplus_sql::Pager::MMAP_EXTENT * 2);
+		assert(std::filesystem::file_size(dst) % bplus_sql::Pager::MMAP_EXTENT == 0);
+		pager.sync();
+	}
+	assert(!mapped || std::filesystem::file_size(dst) == bplus_sql::Pager::MMAP_EXTENT * 2 + 2 * bplus_sql::Pager::PAGE_SIZE);
+
+	std::filesystem::remove(dst);
+	return 0;
+}
@@ -0,0 +1,58 @@
+#include "bplus_tree.h"
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+int main() {
+	auto file = std::filesystem::path(__FILE__).parent_path().parent_path() / "data" / "_test_for_page_size.bin";
+	const size_t pageSizes[] = {4096, 16384, 65536};
+	for(bool useMmap : {false, true}) {
+		for(size_t pageSize : pageSizes) {
+			std::filesystem::remove(file);
+			bplus_sql::TreeOptions options;
+			options.useMmap = useMmap;
+			options.pageSize = pageSize;
+			// A shared pool of default-sized frames only serves 4K tables, the others fall back to a private pool
+			options.bufferPool = bplus_sql::makeSharedBufferPool(1 << 20);
+			{
+				bplus_sql::BPlusTree tree(file.string(), options);
+				for(int key = 0; key < 200000; ++key) assert(tree.insert(key * 13 % 200000));
+			}
+			// Header page plus the node pages, all of the table's page size
+			size_t fileSize = std::filesystem::file_size(file);
+			assert(fileSize % pageSize == 0);
+			// Bigger pages mean fewer of them: a 4K leaf holds about 1000 keys
+			assert(fileSize / pageSize < 2 * 200000 / ((pageSize - 16) / sizeof(int)) + 8);
+
+			// Reopening ignores the requested size and uses the one recorded in the file
+			options.pageSize = pageSize == 4096 ? 65536 : 4096;
+			{
+				bplus_sql::BPlusTree tree(file.string(), options);
+				for(int key = 0; key < 200000; ++key) assert(tree.search(key));
+				assert(!tree.search(200000));
+				for(int key = 0; key < 200000; key += 2) assert(tree.erase(key));
+				assert(tree.insert(200000));
+			}
+			{
+				bplus_sql::BPlusTree tree(file.string());
+				for(int key = 0; key < 200000; ++key) assert(tree.search(key) == (key % 2 == 1));
+				assert(tree.search(200000));
+			}
+			assert(std::filesystem::file_size(file) % pageSize == 0);
+		}
+	}
+	std::filesystem::remove(file);
+
+	bool rejected = false;
+	try {
+		bplus_sql::TreeOptions options;
+		options.pageSize = 12345;
+		bplus_sql::BPlusTree tree(file.string(), options);
+	} catch(const std::invalid_argument &) {
+		rejected = true;
+	}
+	assert(rejected);
+	std::filesystem::remove(file);
+	return 0;
+}
@@ -11,6 +11,16 @@ void check(const std::string &str, const bplus_sql::CmdParser::Command &expected
 				auto parsed_cmd = std::get<bplus_sql::CmdParser::CreateCommand>(parsed.cmd);
 				auto expected = std::get<bplus_sql::CmdParser::CreateCommand>(expected_cmd.cmd);
 				assert(parsed_cmd.tableName == expected.tableName);
+				assert(parsed_cmd.options.durability == expected.options.durability);
+				assert(parsed_cmd.options.syncInterval == expected.options.syncInterval);
+				assert(parsed_cmd.options.minCacheBytes == expected.options.minCacheBytes);
+				assert(parsed_cmd.options.maxCacheBytes == expected.options.maxCacheBytes);
+				assert(parsed_cmd.options.replacement == expected.options.replacement);
+				assert(parsed_cmd.options.pageSize == expected.options.pageSize);
+				assert(parsed_cmd.options.split == expected.options.split);
+				assert(parsed_cmd.options.writeAheadLog == expected.options.writeAheadLog);
+				assert(parsed_cmd.options.checkpointSeconds == expected.options.checkpointSeconds);
+				assert(parsed_cmd.options.checkpointPages == expected.options.checkpointPages);
 				break;
 			}
 			case bplus_sql::CmdParser::INSERT: {
@@ -40,6 +50,47 @@ void check(const std::string &str, const bplus_sql::CmdParser::Command &expected
 				assert(parsed_cmd.tableName == expected.tableName);
 				break;
 			}
+			case bplus_sql::CmdParser::SYNC: {
+				auto parsed_cmd = std::get<bplus_sql::CmdParser::SyncCommand>(parsed.cmd);
+				auto expected = std::get<bplus_sql::CmdParser::SyncCommand>(expected_cmd.cmd);
+				assert(parsed_cmd.tableName == expected.tableName);
+				break;
+			}
+			case bplus_sql::CmdParser::STATS: {
+				auto parsed_cmd = std::get<bplus_sql::CmdParser::StatsCommand>(parsed.cmd);
+				auto expected = std::get<bplus_sql::CmdParser::StatsCommand>(expected_cmd.cmd);
+				assert(parsed_cmd.tableName == expected.tableName);
+				break;
+			}
+			case bplus_sql::CmdParser::SHRINK: {
+				auto parsed_cmd = std::get<bplus_sql::CmdParser::ShrinkCommand>(parsed.cmd);
+				auto expected = std::get<bplus_sql::CmdParser::ShrinkCommand>(expected_cmd.cmd);
+				assert(parsed_cmd.tableName == expected.tableName);
+				break;
+			}
+			case bplus_sql::CmdParser::LOAD: {
+				auto parsed_cmd = std::get<bplus_sql::CmdParser::LoadCommand>(parsed.cmd);
+				auto expected = std::get<bplus_sql::CmdParser::LoadCommand>(expected_cmd.cmd);
+				assert(parsed_cmd.tableName == expected.tableName);
+				assert(parsed_cmd.fileName == expected.fileName);
+				assert(parsed_cmd.fillFactor == expected.fillFactor);
+				break;
+			}
+			case bplus_sql::CmdParser::KEYS: {
+				auto parsed_cmd = std::get<bplus_sql::CmdParser::KeysCommand>(parsed.cmd);
+				auto expected = std::get<bplus_sql::CmdParser::KeysCommand>(expected_cmd.cmd);
+				assert(parsed_cmd.tableName == expected.tableName);
+				assert(parsed_cmd.keys == expected.keys);
+				break;
+			}
+			case bplus_sql::CmdParser::RANGE: {
+				auto parsed_cmd = std::get<bplus_sql::CmdParser::RangeCommand>(parsed.cmd);
+				auto expected = std::get<bplus_sql::CmdParser::RangeCommand>(expected_cmd.cmd);
+				assert(parsed_cmd.tableName == expected.tableName);
+				assert(parsed_cmd.low == expected.low);
+				assert(parsed_cmd.high == expected.high);
+				break;
+			}
 		}
 	} catch(...) {
 		assert(false);
@@ -103,5 +154,94 @@ int main() {
 		bplus_sql::CmdParser::DestroyCommand("users")
 		});
 
+	check("SYNC TABLE users", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::SYNC,
+		bplus_sql::CmdParser::SyncCommand("users")
+		});
+	check("create table logs durability none", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::CREATE,
+		bplus_sql::CmdParser::CreateCommand{"logs", {.durability = bplus_sql::Durability::NONE}}
+		});
+	check("CREATE TABLE orders DURABILITY EVERY 64", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::CREATE,
+		bplus_sql::CmdParser::CreateCommand{"orders", {.durability = bplus_sql::Durability::EVERY_N_OPS, .syncInterval = 64}}
+		});
+	check("CREATE TABLE hot MIN_CACHE 4M MAX_CACHE 1G", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::CREATE,
+		bplus_sql::CmdParser::CreateCommand{"hot", {.minCacheBytes = 4ull << 20, .maxCacheBytes = 1ull << 30}}
+		});
+	check("CREATE TABLE scans POLICY 2Q", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::CREATE,
+		bplus_sql::CmdParser::CreateCommand{"scans", {.replacement = bplus_sql::ReplacementPolicy::TWO_QUEUE}}
+		});
+	check("create table idx policy clock max_cache 1M", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::CREATE,
+		bplus_sql::CmdParser::CreateCommand{"idx", {.maxCacheBytes = 1ull << 20, .replacement = bplus_sql::ReplacementPolicy::CLOCK}}
+		});
+	check("CREATE TABLE hist POLICY LRU2", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::CREATE,
+		bplus_sql::CmdParser::CreateCommand{"hist", {.replacement = bplus_sql::ReplacementPolicy::LRU_2}}
+		});
+	check("CREATE TABLE events PAGE_SIZE 64K", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::CREATE,
+		bplus_sql::CmdParser::CreateCommand{"events", {.pageSize = 64ull << 10}}
+		});
+	check("CREATE TABLE events SPLIT BSTAR", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::CREATE,
+		bplus_sql::CmdParser::CreateCommand{"events", {.split = bplus_sql::SplitPolicy::B_STAR}}
+		});
+	check("create table events split halves", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::CREATE,
+		bplus_sql::CmdParser::CreateCommand{"events", {.split = bplus_sql::SplitPolicy::HALVES}}
+		});
+	check("CREATE TABLE ledger WAL DURABILITY EVERY_OP", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::CREATE,
+		bplus_sql::CmdParser::CreateCommand{"ledger", {.durability = bplus_sql::Durability::EVERY_OP, .writeAheadLog = true}}
+		});
+	check("create table ledger wal checkpoint_seconds 5 checkpoint_pages 0", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::CREATE,
+		bplus_sql::CmdParser::CreateCommand{"ledger", {.writeAheadLog = true, .checkpointSeconds = 5, .checkpointPages = 0}}
+		});
+	check("STATS TABLE users", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::STATS,
+		bplus_sql::CmdParser::StatsCommand("users")
+		});
+	check("QUERY FROM users RANGE 10 20", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::RANGE,
+		bplus_sql::CmdParser::RangeCommand{"users", 10, 20}
+		});
+	check("query from logs range -5 5", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::RANGE,
+		bplus_sql::CmdParser::RangeCommand{"logs", -5, 5}
+		});
+	check("QUERY FROM users KEYS 3,1,4,1,-5", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::KEYS,
+		bplus_sql::CmdParser::KeysCommand{"users", {3, 1, 4, 1, -5}}
+		});
+	check("query from logs keys 7, 8 ,9", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::KEYS,
+		bplus_sql::CmdParser::KeysCommand{"logs", {7, 8, 9}}
+		});
+	check("shrink table logs", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::SHRINK,
+		bplus_sql::CmdParser::ShrinkCommand("logs")
+		});
+	check("LOAD INTO users FROM 'keys.txt'", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::LOAD,
+		bplus_sql::CmdParser::LoadCommand{"users", "keys.txt"}
+		});
+	check("load into logs from /tmp/sorted.txt fill 0.75", bplus_sql::CmdParser::Command{
+		bplus_sql::CmdParser::LOAD,
+		bplus_sql::CmdParser::LoadCommand{"logs", "/tmp/sorted.txt", 0.75}
+		});
+
+	assert(bplus_sql::CmdParser::parseBytes("4096") == 4096);
+	assert(bplus_sql::CmdParser::parseBytes("64k") == 64ull << 10);
+	assert(bplus_sql::CmdParser::parseBytes("2G") == 2ull << 30);
+	assert(bplus_sql::CmdParser::parseBytes("lots") == 0);
+	// Values that overflow once scaled are rejected instead of wrapping around to a small size
+	assert(bplus_sql::CmdParser::parseBytes("17179869184G") == 0);
+	assert(bplus_sql::CmdParser::parseBytes("99999999999999999999") == 0);
+
 	return 0;
 }
\ No newline at end of file
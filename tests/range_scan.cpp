@@ -0,0 +1,59 @@
+#include "bplus_tree.h"
+#include <cassert>
+#include <filesystem>
+#include <set>
+#include <vector>
+
+int main() {
+	auto file = std::filesystem::path(__FILE__).parent_path().parent_path() / "data" / "_test_for_range_scan.bin";
+	std::filesystem::remove(file);
+	std::set<int> expected;
+	{
+		bplus_sql::BPlusTree tree(file.string());
+		for(int key = 0; key < 100000; ++key) {
+			int value = key * 7919 % 100000 - 50000;
+			tree.insert(value);
+			expected.insert(value);
+		}
+		// Empty a run of whole leaves so the scan has to walk through them
+		for(int key = -20000; key < 10000; ++key) {
+			if(key % 5 != 0) {
+				tree.erase(key);
+				expected.erase(key);
+			}
+		}
+	}
+
+	{
+		bplus_sql::BPlusTree tree(file.string());
+		const std::pair<int, int> ranges[] = {{-50000, 49999}, {-60000, 60000}, {-12345, 12345}, {7, 7}, {8, 8}, {100, 99}, {50000, 60000}, {-70000, -50001}, {-19999, 9999}};
+		for(auto [low, high] : ranges) {
+			std::vector<int> keys;
+			size_t visited = tree.scan(low, high, [&](int key) {
+				keys.push_back(key);
+				return true;
+			});
+			std::vector<int> reference(expected.lower_bound(low), low <= high ? expected.upper_bound(high) : expected.lower_bound(low));
+			assert(keys == reference);
+			assert(visited == keys.size());
+	}
+
+	// Returning false stops the scan after that key
+	std::vector<int> firstTen;
+	size_t visited = tree.scan(-50000, 49999, [&](int key) {
+		firstTen.push_back(key);
+		return firstTen.size() < 10;
+	});
+	assert(visited == 10);
+	assert(firstTen == std::vector<int>(expected.begin(), std::next(expected.begin(), 10)));
+
+	}
+	std::filesystem::remove(file);
+
+	{
+		bplus_sql::BPlusTree empty(file.string());
+		assert(empty.scan(-100, 100, [](int) { return true; }) == 0);
+	}
+	std::filesystem::remove(file);
+	return 0;
+}
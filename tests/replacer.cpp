@@ -0,0 +1,188 @@
+#include "buffer_pool.h"
+#include "bplus_tree.h"
+#include "pager.h"
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <random>
+
+// Count every heap allocation so the steady state can be checked for zero allocations
+static size_t g_allocations = 0;
+
+void *operator new(size_t size) {
+	g_allocations++;
+	if(void *p = std::malloc(size == 0 ? 1 : size)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	std::free(p);
+}
+
+using bplus_sql::BufferPool;
+using bplus_sql::ReplacementPolicy;
+
+// Same replacement loop as NodeManager::pinPage, without reading from disk
+uint32_t fetch(BufferPool &pool, uint32_t tenant, size_t pageId) {
+	std::unique_lock<std::mutex> lock(pool.mutex(tenant, pageId));
+	uint32_t frame = pool.lookup(tenant, pageId);
+	if(frame == BufferPool::NO_FRAME) {
+		frame = pool.acquireFrame(tenant, pageId, lock);
+		pool.install(frame, tenant, pageId);
+		*reinterpret_cast<size_t *>(pool.data(frame)) = pageId;
+	}
+	return frame;
+}
+
+// Misses on a 16-page hot set after one pass over 500 cold pages, with 64 frames
+uint64_t hotMissesAfterScan(bplus_sql::Pager &pager, ReplacementPolicy policy) {
+	BufferPool pool(64);
+	uint32_t t = pool.registerTenant(&pager, 0, BufferPool::UNLIMITED, policy);
+	assert(pool.policy(t) == policy);
+	auto touchHot = [&] {
+		for(size_t pageId = 0; pageId < 16; ++pageId) fetch(pool, t, pageId);
+	};
+	// Warm up: the hot set is used, pushed out once by other pages and then used twice more
+	touchHot();
+	for(size_t pageId = 1000; pageId < 1064; ++pageId) fetch(pool, t, pageId);
+	touchHot();
+	touchHot();
+
+	for(size_t pageId = 2000; pageId < 2500; ++pageId) fetch(pool, t, pageId);
+	uint64_t missesBefore = pool.stats(t).misses;
+	touchHot();
+	uint64_t misses = pool.stats(t).misses - missesBefore;
+
+	const bplus_sql::CacheStats &stats = pool.stats(t);
+	assert(stats.hits + stats.misses == 16 * 4 + 64 + 500);
+	assert(stats.evictions == stats.misses - 64);
+	assert(stats.writebacks == 0);
+	pool.unregisterTenant(t);
+	return misses;
+}
+
+int main() {
+	auto dir = std::filesystem::path(__FILE__).parent_path().parent_path() / "data";
+	auto file = dir / "_test_for_replacer.bin";
+	std::filesystem::remove(file);
+	const ReplacementPolicy policies[] = {ReplacementPolicy::LRU, ReplacementPolicy::CLOCK, ReplacementPolicy::TWO_QUEUE, ReplacementPolicy::LRU_2};
+	{
+		bplus_sql::Pager pager(file.string());
+
+		// A sequential scan flushes the hot set out of LRU, the scan resistant policies keep it
+		assert(hotMissesAfterScan(pager, ReplacementPolicy::LRU) == 16);
+		assert(hotMissesAfterScan(pager, ReplacementPolicy::TWO_QUEUE) == 0);
+		assert(hotMissesAfterScan(pager, ReplacementPolicy::LRU_2) == 0);
+		std::cout << "CLOCK hot set misses after scan: " << hotMissesAfterScan(pager, ReplacementPolicy::CLOCK) << std::endl;
+
+		for(ReplacementPolicy policy : policies) {
+			BufferPool pool(64);
+			uint32_t t = pool.registerTenant(&pager, 0, BufferPool::UNLIMITED, policy);
+
+			// Pinned frames are never chosen, even when every other frame is cold
+			for(size_t pageId = 0; pageId < 64; ++pageId) fetch(pool, t, pageId);
+			uint32_t pinned[63];
+			for(size_t pageId = 0; pageId < 63; ++pageId) {
+				pinned[pageId] = pool.lookup(t, pageId);
+				pool.pin(pinned[pageId]);
+			}
+			assert(pool.pageId(pool.victim(t, 64)) == 63);
+			for(uint32_t frame : pinned) pool.unpin(frame);
+
+			// Random workload with a skewed hot set: every page stays reachable, nothing allocates
+			std::mt19937 rng(42);
+			std::uniform_int_distribution<size_t> cold(0, 511), hot(0, 31), coin(0, 3);
+			size_t before = g_allocations;
+			for(int i = 0; i < 100000; ++i) {
+				size_t pageId = coin(rng) == 0 ? cold(rng) : hot(rng);
+				uint32_t frame = fetch(pool, t, pageId);
+				assert(pool.pageId(frame) == pageId);
+				assert(*reinterpret_cast<size_t *>(pool.data(frame)) == pageId);
+			}
+			assert(g_allocations == before);
+			assert(pool.size() == 64);
+			pool.unregisterTenant(t);
+			assert(pool.size() == 0);
+		}
+
+		// LRU-2 picks the same victim as a scan over every evictable frame: pages touched once first, then
+		// the oldest second to last access
+		{
+			std::vector<bplus_sql::ReplacementState> states(64);
+			bplus_sql::Lru2Replacer lru2(states, 64);
+			for(uint32_t frame = 0; frame < 64; ++frame) lru2.inserted(frame, frame);
+			std::mt19937 rng(7);
+			for(size_t i = 0; i < 20000; ++i) {
+				uint32_t frame = rng() % 64;
+				switch(rng() % 3) {
+				case 0:
+					lru2.accessed(frame);
+					break;
+				case 1:
+					lru2.setEvictable(frame, !states[frame].evictable);
+					break;
+				default:
+					uint32_t expected = bplus_sql::Replacer::NO_FRAME;
+					for(uint32_t candidate = 0; candidate < 64; ++candidate) {
+						const bplus_sql::ReplacementState &state = states[candidate];
+						if(!state.evictable) continue;
+						if(expected == bplus_sql::Replacer::NO_FRAME) {
+							expected = candidate;
+							continue;
+						}
+						const bplus_sql::ReplacementState &best = states[expected];
+						bool once = state.previousAccess == 0, bestOnce = best.previousAccess == 0;
+						uint64_t time = once ? state.lastAccess : state.previousAccess;
+						uint64_t bestTime = bestOnce ? best.lastAccess : best.previousAccess;
+						if((once && !bestOnce) || (once == bestOnce && time < bestTime)) expected = candidate;
+					}
+					assert(lru2.victim() == expected);
+					if(expected != bplus_sql::Replacer::NO_FRAME) {
+						lru2.removed(expected);
+						lru2.inserted(expected, 64 + i);
+					}
+				}
+			}
+		}
+
+		// Tables sharing a pool may use different policies
+		BufferPool pool(64);
+		uint32_t a = pool.registerTenant(&pager, 0, BufferPool::UNLIMITED, ReplacementPolicy::CLOCK);
+		uint32_t b = pool.registerTenant(&pager, 16, BufferPool::UNLIMITED, ReplacementPolicy::TWO_QUEUE);
+		for(size_t pageId = 0; pageId < 1000; ++pageId) {
+			fetch(pool, a, pageId);
+			fetch(pool, b, pageId % 40);
+			assert(pool.tenantSize(b) >= std::min<size_t>(16, pageId + 1));
+		}
+		assert(pool.tenantSize(a) + pool.tenantSize(b) == 64);
+		pool.unregisterTenant(a);
+		pool.unregisterTenant(b);
+	}
+	std::filesystem::remove(file);
+
+	// Every policy behind a whole tree, with a pool much smaller than the tree
+	for(ReplacementPolicy policy : policies) {
+		{
+			bplus_sql::TreeOptions options;
+			options.bufferPool = bplus_sql::makeSharedBufferPool(32 * bplus_sql::Pager::PAGE_SIZE);
+			options.replacement = policy;
+			bplus_sql::BPlusTree tree(file.string(), options);
+			for(int key = 0; key < 50000; ++key) assert(tree.insert(key * 7 % 50000));
+			for(int key = 0; key < 50000; key += 3) assert(tree.search(key));
+			assert(!tree.search(50000));
+			bplus_sql::CacheStats stats = tree.cacheStats();
+			assert(stats.hits > 0 && stats.misses > 0 && stats.evictions > 0);
+			assert(stats.writebacks <= stats.evictions);
+		}
+		std::filesystem::remove(file);
+	}
+	return 0;
+}
@@ -71,6 +71,23 @@ if (Test-Path data/test.bin) {
 }
 
 RunTest "parse_commands"
+RunTest "mmap_pager"
+RunTest "buffer_pool"
+RunTest "replacer"
+RunTest "search_kernels"
+RunTest "page_size"
+RunTest "key_types"
+RunTest "range_scan"
+RunTest "erase_rebalance"
+RunTest "free_pages"
+RunTest "bulk_load"
+RunTest "batch_ops"
+RunTest "split_policy"
+RunTest "append_split"
+RunTest "write_ahead_log"
+RunTest "checkpoint_recovery"
+RunTest "concurrent_pressure"
+RunTest "async_pager"
 
 Write-Output "Running test main"
 $gentest = Find-Executable "gentest"
@@ -109,6 +109,23 @@ run_test "always_insert"
 run_test "test_existing_tree"
 [ -f data/test.bin ] && rm -f data/test.bin
 run_test "parse_commands"
+run_test "mmap_pager"
+run_test "buffer_pool"
+run_test "replacer"
+run_test "search_kernels"
+run_test "page_size"
+run_test "key_types"
+run_test "range_scan"
+run_test "erase_rebalance"
+run_test "free_pages"
+run_test "bulk_load"
+run_test "batch_ops"
+run_test "split_policy"
+run_test "append_split"
+run_test "write_ahead_log"
+run_test "checkpoint_recovery"
+run_test "concurrent_pressure"
+run_test "async_pager"
 
 echo "Running test rb_tree"
 rb_tree_exe=$(find_exe rb_tree)
@@ -0,0 +1,59 @@
+#include "search_kernels.h"
+#include "bplus_node.h"
+#include "pager.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Nanoseconds per in-node search for every kernel at several node fill levels.
+// A benchmark, not a test (search_kernels checks the kernels); it still fails if the kernels disagree.
+int main() {
+	constexpr size_t NODES = 1024;
+	constexpr size_t LOOKUPS = 1 << 20;
+	const bplus_sql::NodeLayout<int32_t> layout(bplus_sql::Pager::PAGE_SIZE);
+	const size_t fills[] = {1, 8, 16, 64, 128, static_cast<size_t>(layout.maxInternalKeys), 512, static_cast<size_t>(layout.maxLeafKeys)};
+	auto kernels = bplus_sql::availableSearchKernels();
+	std::mt19937 rng(42);
+
+	std::printf("%-6s", "fill");
+	for(const auto &kernel : kernels) std::printf("%10s", kernel.name);
+	std::printf("   (ns per search, selected: %s)\n", bplus_sql::searchKernel().name);
+	for(size_t fill : fills) {
+		// Many nodes so the benchmark does not just hit one cached line
+		std::vector<int32_t> keys(NODES * fill);
+		for(size_t node = 0; node < NODES; ++node) {
+			for(size_t i = 0; i < fill; ++i) keys[node * fill + i] = static_cast<int32_t>(i * 4);
+		}
+		std::vector<uint32_t> nodes(LOOKUPS);
+		std::vector<int32_t> probes(LOOKUPS);
+		std::uniform_int_distribution<size_t> unode(0, NODES - 1);
+		std::uniform_int_distribution<int32_t> ukey(-1, static_cast<int32_t>(fill * 4));
+		for(size_t i = 0; i < LOOKUPS; ++i) {
+			nodes[i] = static_cast<uint32_t>(unode(rng));
+			probes[i] = ukey(rng);
+		}
+		std::printf("%-6zu", fill);
+		size_t expected = 0;
+		for(size_t k = 0; k < kernels.size(); ++k) {
+			const auto &kernel = kernels[k];
+			size_t checksum = 0;
+			auto start = std::chrono::steady_clock::now();
+			for(size_t i = 0; i < LOOKUPS; ++i) {
+				const int32_t *node = keys.data() + nodes[i] * fill;
+				checksum += kernel.lowerBound(node, fill, probes[i]) + kernel.upperBound(node, fill, probes[i]);
+			}
+			std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			std::printf("%10.2f", elapsed.count() / (2.0 * LOOKUPS));
+			if(k == 0) {
+				expected = checksum;
+			} else if(checksum != expected) {
+				std::printf("\n%s found other positions than %s\n", kernel.name, kernels[0].name);
+				return 1;
+			}
+		}
+		std::printf("   (checksum %zu)\n", expected);
+	}
+	return 0;
+}
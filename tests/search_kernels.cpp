@@ -0,0 +1,45 @@
+#include "search_kernels.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+template<typename Key>
+void checkKernels(unsigned seed) {
+	auto kernels = bplus_sql::availableSearchKernels<Key>();
+	assert(kernels.size() >= 2);
+	std::mt19937_64 rng(seed);
+	constexpr Key lowest = std::numeric_limits<Key>::min();
+	constexpr Key highest = std::numeric_limits<Key>::max();
+	// Narrow ranges around zero (or the middle of an unsigned range) produce duplicates
+	constexpr Key middle = std::is_signed_v<Key> ? Key(0) : highest / 2;
+	Key keys[129];
+	for(size_t count = 0; count <= 129; ++count) {
+		for(int round = 0; round < 200; ++round) {
+			// The extremes check the signed (or unsigned) comparisons
+			std::uniform_int_distribution<Key> value(round % 2 ? Key(middle - 50) : lowest, round % 2 ? Key(middle + 50) : highest);
+			for(size_t i = 0; i < count; ++i) keys[i] = value(rng);
+			std::sort(keys, keys + count);
+			Key probes[] = {value(rng), value(rng), lowest, highest, count ? keys[0] : Key(0), count ? keys[count - 1] : Key(0), count ? keys[count / 2] : Key(0)};
+			for(Key key : probes) {
+				size_t lower = std::lower_bound(keys, keys + count, key) - keys;
+				size_t upper = std::upper_bound(keys, keys + count, key) - keys;
+				for(const auto &kernel : kernels) {
+					assert(kernel.lowerBound(keys, count, key) == lower);
+					assert(kernel.upperBound(keys, count, key) == upper);
+				}
+				assert(bplus_sql::searchKernel<Key>().lowerBound(keys, count, key) == lower);
+				assert(bplus_sql::searchKernel<Key>().upperBound(keys, count, key) == upper);
+			}
+		}
+	}
+}
+
+int main() {
+	checkKernels<int32_t>(20240607);
+	checkKernels<uint32_t>(20240608);
+	checkKernels<int64_t>(20240609);
+	checkKernels<uint64_t>(20240610);
+	return 0;
+}
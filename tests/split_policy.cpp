@@ -0,0 +1,76 @@
+#include "bplus_tree.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <cassert>
+#include <filesystem>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using Bytes32 = bplus_sql::FixedBytesKey<32>;
+
+// Build a table from `order` with the given split policy and return its file size
+template<typename KeyTraits, typename MakeKey>
+uintmax_t buildTable(const std::filesystem::path &file, const std::vector<int> &order, bplus_sql::SplitPolicy split, MakeKey makeKey) {
+	using Key = typename KeyTraits::type;
+	std::filesystem::remove(file);
+	bplus_sql::TreeOptions options;
+	options.split = split;
+	bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string(), options);
+	for(int i : order) tree.insert(makeKey(i));
+
+	int expected = 0;
+	size_t visited = tree.scan(makeKey(0), makeKey(static_cast<int>(order.size())), [&](const Key &key) {
+		assert(sameKey<KeyTraits>(key, makeKey(expected)));
+		expected++;
+		return true;
+	});
+	assert(visited == order.size());
+	for(int i = 0; i < static_cast<int>(order.size()); i += 97) assert(tree.search(makeKey(i)));
+	assert(!tree.search(makeKey(static_cast<int>(order.size()))));
+	tree.sync();
+	return std::filesystem::file_size(file);
+}
+
+template<typename KeyTraits, typename MakeKey>
+void checkPolicies(const std::filesystem::path &file, MakeKey makeKey) {
+	using Key = typename KeyTraits::type;
+	const int total = 200000;
+	std::vector<int> order(total);
+	std::iota(order.begin(), order.end(), 0);
+
+	// Ascending keys always fill the last leaf, which has no right sibling to share with
+	buildTable<KeyTraits>(file, order, bplus_sql::SplitPolicy::B_STAR, makeKey);
+
+	std::shuffle(order.begin(), order.end(), std::mt19937(5));
+	uintmax_t halvesSize = buildTable<KeyTraits>(file, order, bplus_sql::SplitPolicy::HALVES, makeKey);
+	uintmax_t bStarSize = buildTable<KeyTraits>(file, order, bplus_sql::SplitPolicy::B_STAR, makeKey);
+	// Random inserts leave halved pages about 70% full and shared pages over 80%
+	assert(bStarSize * 100 < halvesSize * 90);
+
+	// The table does not remember the policy: erases rebalance it and later inserts split in halves
+	{
+		bplus_sql::BasicBPlusTree<KeyTraits> tree(file.string());
+		for(int i : order) {
+			if(i % 3 != 0) assert(tree.erase(makeKey(i)));
+		}
+		for(int i : order) {
+			if(i % 3 == 1) tree.insert(makeKey(i));
+		}
+		for(int i = 0; i < total; ++i) assert(tree.search(makeKey(i)) == (i % 3 != 2));
+		assert(tree.scan(makeKey(0), makeKey(total), [](const Key &) { return true; }) == static_cast<size_t>(total - total / 3));
+	}
+	std::filesystem::remove(file);
+}
+
+int main() {
+	auto file = std::filesystem::path(__FILE__).parent_path().parent_path() / "data" / "_test_for_split_policy.bin";
+	checkPolicies<bplus_sql::Int32Key>(file, [](int i) { return i; });
+	// Wide keys give a deeper tree, so internal nodes share and split three ways too
+	checkPolicies<Bytes32>(file, [](int i) {
+		Bytes32::type key{};
+		for(int byte = 0; byte < 4; ++byte) key[byte] = static_cast<unsigned char>(i >> (24 - 8 * byte));
+		return key;
+	});
+	return 0;
+}
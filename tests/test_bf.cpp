@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -37,6 +38,9 @@ int main(int argc, char* argv[]) {
             case CmdParser::INVALID:
             case CmdParser::CREATE:
             case CmdParser::DESTROY:
+            case CmdParser::SYNC:
+            case CmdParser::STATS:
+            case CmdParser::SHRINK:
                 break;
             case CmdParser::INSERT: {
                 auto ins = std::get<CmdParser::InsertCommand>(cmd.cmd);
@@ -64,6 +68,37 @@ int main(int argc, char* argv[]) {
                 }
                 break;
             }
+            case CmdParser::KEYS: {
+                auto q = std::get<CmdParser::KeysCommand>(cmd.cmd);
+                for (int key : q.keys) {
+                    std::cout << (key >= 0 && key < (int)has_key.size() ? has_key[key] : 0) << '\n';
+                }
+                break;
+            }
+            case CmdParser::LOAD: {
+                auto load = std::get<CmdParser::LoadCommand>(cmd.cmd);
+                std::ifstream keys(load.fileName);
+                int key;
+                while (keys >> key) {
+                    if (key >= 0) {
+                        if (key >= (int)has_key.size()) has_key.resize(key + 5);
+                        has_key[key] = 1;
+                    }
+                }
+                break;
+            }
+            case CmdParser::RANGE: {
+                auto r = std::get<CmdParser::RangeCommand>(cmd.cmd);
+                bool first = true;
+                for (int key = std::max(r.low, 0); key <= r.high && key < (int)has_key.size(); ++key) {
+                    if (has_key[key]) {
+                        std::cout << (first ? "" : " ") << key;
+                        first = false;
+                    }
+                }
+                std::cout << '\n';
+                break;
+            }
         }
     }
 
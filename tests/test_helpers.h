@@ -0,0 +1,35 @@
+#ifndef __TEST_HELPERS_H__
+#define __TEST_HELPERS_H__
+
+#include "bplus_tree.h"
+#include <cassert>
+#include <filesystem>
+#include <limits>
+#include <set>
+
+// Checks shared by the test executables
+
+// Equal under the key type's order, which is all keys offer
+template<typename KeyTraits>
+bool sameKey(const typename KeyTraits::type &a, const typename KeyTraits::type &b) {
+	return !KeyTraits::less(a, b) && !KeyTraits::less(b, a);
+}
+
+// The table holds exactly `expected`, and a scan visits it in ascending order
+inline void checkContents(bplus_sql::BPlusTree &tree, const std::set<int> &expected) {
+	auto it = expected.begin();
+	size_t visited = tree.scan(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), [&](const int &key) {
+		assert(it != expected.end() && key == *it);
+		++it;
+		return true;
+	});
+	assert(visited == expected.size());
+}
+
+// Delete a table together with its write-ahead log
+inline void removeTable(const std::filesystem::path &file) {
+	std::filesystem::remove(file);
+	std::filesystem::remove(file.string() + ".wal");
+}
+
+#endif
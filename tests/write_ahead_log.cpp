@@ -0,0 +1,212 @@
+#include "bplus_tree.h"
+#include "test_helpers.h"
+#include "wal.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#define WAL_TEST_FORK 1
+#endif
+
+// Modifications a killed writer made; `expected` receives the resulting contents
+void modify(bplus_sql::BPlusTree *tree, std::set<int> &expected) {
+	std::mt19937 rng(7);
+	std::uniform_int_distribution<int> ukey(0, 1 << 20);
+	for(int i = 0; i < 40000; ++i) {
+		int key = ukey(rng);
+		if(tree) tree->insert(key);
+		expected.insert(key);
+	}
+	std::vector<int> erased(expected.begin(), expected.end());
+	erased.resize(erased.size() / 3);
+	if(tree) tree->eraseMany(erased);
+	for(int key : erased) expected.erase(key);
+	// The checkpoint of shrink() puts everything so far into the table file
+	if(tree) tree->shrink();
+
+	std::vector<int> batch;
+	for(int i = 0; i < 5000; ++i) batch.push_back(ukey(rng));
+	if(tree) tree->insertMany(batch);
+	expected.insert(batch.begin(), batch.end());
+	for(int i = 0; i < 20000; ++i) {
+		int key = ukey(rng);
+		if(i % 4 == 0) {
+			if(tree) tree->erase(key);
+			expected.erase(key);
+		} else {
+			if(tree) tree->insert(key);
+			expected.insert(key);
+		}
+	}
+}
+
+#ifdef WAL_TEST_FORK
+// Run `work` in a child process, which has to kill itself with SIGKILL while its table is open
+template<typename Work>
+void inKilledChild(Work work) {
+	pid_t child = fork();
+	assert(child >= 0);
+	if(child == 0) {
+		work();
+		_exit(0);
+	}
+	int status = 0;
+	waitpid(child, &status, 0);
+	assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+}
+#endif
+
+void checkRecovery(const std::filesystem::path &file) {
+#ifdef WAL_TEST_FORK
+	auto log = std::filesystem::path(file.string() + ".wal");
+	removeTable(file);
+	bplus_sql::TreeOptions options;
+	options.writeAheadLog = true;
+	// A small cache makes dirty pages spill into the log long before the table is closed
+	options.maxCacheBytes = 256 << 10;
+
+	inKilledChild([&] {
+		bplus_sql::BPlusTree tree(file.string(), options);
+		std::set<int> expected;
+		modify(&tree, expected);
+		// Acknowledges everything so far with one log sync, without writing pages to the table file
+		tree.sync();
+		raise(SIGKILL);
+	});
+	std::set<int> expected;
+	modify(nullptr, expected);
+	assert(std::filesystem::file_size(log) > 0);
+
+	// A write torn by the crash is cut off
+	{
+		std::ofstream torn(log, std::ios::binary | std::ios::app);
+		torn << "partial record";
+	}
+	{
+		bplus_sql::BPlusTree tree(file.string(), options);
+		checkContents(tree, expected);
+		for(int key = 0; key < 1000; ++key) {
+			tree.insert(-key - 1);
+			expected.insert(-key - 1);
+		}
+	}
+	// Closing checkpoints and empties the log
+	assert(std::filesystem::file_size(log) == 0);
+
+	// Every modification is acknowledged when it returns
+	inKilledChild([&] {
+		bplus_sql::TreeOptions everyOp = options;
+		everyOp.durability = bplus_sql::Durability::EVERY_OP;
+		bplus_sql::BPlusTree tree(file.string(), everyOp);
+		for(int key = 1 << 21; key < (1 << 21) + 3000; ++key) tree.insert(key);
+		tree.erase(-1);
+		raise(SIGKILL);
+	});
+	for(int key = 1 << 21; key < (1 << 21) + 3000; ++key) expected.insert(key);
+	expected.erase(-1);
+	// Opened without the options, the table keeps its log and runs as it was last set up
+	inKilledChild([&] {
+		bplus_sql::BPlusTree tree(file.string());
+		checkContents(tree, expected);
+		for(int key = 1 << 22; key < (1 << 22) + 100; ++key) tree.insert(key);
+		raise(SIGKILL);
+	});
+	for(int key = 1 << 22; key < (1 << 22) + 100; ++key) expected.insert(key);
+	{
+		bplus_sql::BPlusTree tree(file.string());
+		checkContents(tree, expected);
+	}
+	assert(std::filesystem::exists(log) && std::filesystem::file_size(log) == 0);
+
+	// Only dropping the log removes it
+	bplus_sql::TreeOptions drop;
+	drop.dropWriteAheadLog = true;
+	{
+		bplus_sql::BPlusTree tree(file.string(), drop);
+		checkContents(tree, expected);
+	}
+	assert(!std::filesystem::exists(log));
+	{
+		bplus_sql::BPlusTree tree(file.string());
+		checkContents(tree, expected);
+	}
+	assert(!std::filesystem::exists(log));
+
+	// A bulk load is checkpointed as a whole
+	std::filesystem::remove(file);
+	inKilledChild([&] {
+		bplus_sql::TreeOptions everyOp = options;
+		everyOp.durability = bplus_sql::Durability::EVERY_OP;
+		bplus_sql::BPlusTree tree(file.string(), everyOp);
+		int next = 0;
+		tree.bulkLoad([&](int &key) {
+			if(next == 100000) return false;
+			key = next++;
+			return true;
+		});
+		tree.insert(100000);
+		raise(SIGKILL);
+	});
+	{
+		bplus_sql::BPlusTree tree(file.string(), options);
+		std::set<int> loaded;
+		for(int key = 0; key <= 100000; ++key) loaded.insert(key);
+		checkContents(tree, loaded);
+	}
+	removeTable(file);
+#endif
+}
+
+// Writers committing at the same time share log syncs and every record survives
+void checkGroupCommit(const std::filesystem::path &file) {
+	std::filesystem::remove(file);
+	const int writers = 8;
+	const int commits = 200;
+	uint64_t syncs = 0;
+	{
+		bplus_sql::WriteAheadLog log(file.string());
+		std::vector<std::thread> threads;
+		for(int writer = 0; writer < writers; ++writer) {
+			threads.emplace_back([&, writer] {
+				for(int i = 0; i < commits; ++i) {
+					int value = writer * commits + i;
+					log.append(bplus_sql::WriteAheadLog::RecordType::INSERT, &value, sizeof(value));
+					log.commit(log.end());
+				}
+			});
+		}
+		for(auto &thread : threads) thread.join();
+		syncs = log.syncCount();
+		assert(syncs >= 1 && syncs <= static_cast<uint64_t>(writers * commits));
+	}
+	std::vector<bool> seen(writers * commits, false);
+	bplus_sql::WriteAheadLog log(file.string());
+	log.scan(0, [&](const bplus_sql::WriteAheadLog::Record &record) {
+		int value;
+		assert(record.payload.size() == sizeof(value));
+		std::memcpy(&value, record.payload.data(), sizeof(value));
+		assert(!seen[value]);
+		seen[value] = true;
+		return true;
+	});
+	for(bool value : seen) assert(value);
+	std::printf("%d commits, %llu log syncs\n", writers * commits, static_cast<unsigned long long>(syncs));
+	std::filesystem::remove(file);
+}
+
+int main() {
+	auto data = std::filesystem::path(__FILE__).parent_path().parent_path() / "data";
+	checkRecovery(data / "_test_for_write_ahead_log.bin");
+	checkGroupCommit(data / "_test_for_write_ahead_log.bin.wal");
+	return 0;
+}